@@ -12,12 +12,33 @@
 
 
 #include "vs-xml/tree-builder.hpp"
+#include <limits>
+#include <memory>
 #include <vs-xml/commons.hpp>
 #include <vs-xml/archive.hpp>
 #include <vs-xml/document-builder.hpp>
+#include <vs-xml/executor.hpp>
 
 namespace VS_XML_NS{
 
+namespace details{
+    ///Documents built with their own symbols table, as extracted from a builder.
+    struct archive_part_t{
+        std::vector<binary_header_t::section_t> sections;
+        std::vector<uint8_t> buffer;
+        std::vector<uint8_t> symbols;
+    };
+
+    /**
+     * @brief Concatenate the documents of several parts, merging their symbols into a single table and remapping all references to it.
+     * @param compress if true, symbols are deduplicated across parts, else tables are just appended.
+     * @param executor if not null, parts are scanned and remapped in parallel.
+     * @return false if any part is malformed.
+     */
+    bool merge_archive_parts(std::span<archive_part_t> parts, bool compress, Executor* executor,
+        std::vector<binary_header_t::section_t>& sections, std::vector<uint8_t>& buffer, std::vector<uint8_t>& symbols);
+}
+
 template<builder_config_t cfg = {}>
 struct ArchiveBuilder{
     private:
@@ -54,10 +75,98 @@ struct ArchiveBuilder{
         return details::BuilderBase::error_t::OK;
     }
 
-    [[nodiscard]] inline std::expected<stored::Archive,error_t> close(){
+    ///Finalize the archive, failing with TOO_LARGE if it has more documents than it can index. Documents are also indexed by name, and the index is saved along with it by `save_binary`.
+    [[nodiscard]] inline std::expected<stored::Archive,details::BuilderBase::error_t> close(){
+        if(fragments.size()>std::numeric_limits<uint16_t>::max())return std::unexpected(details::BuilderBase::error_t::TOO_LARGE);
         auto [buffer,symbols] = *builder.extract();    
         return stored::Archive(cfg,std::move(fragments),std::move(buffer),std::move(symbols));
     }
 };
 
+/**
+ * @brief Archive builder splitting documents across independent parts, so that they can be built concurrently.
+ * @details Each part has its own builder and symbols table, and must only be used by one thread at a time.
+ *          When closing, tables are merged into a single one and the references in all nodes are remapped, then documents are concatenated
+ *          in order of part, and in order of insertion within each part.
+ *          Splitting a sorted list of inputs into contiguous ranges, one for each part, preserves their order in the final archive.
+ */
+template<builder_config_t cfg = {}>
+struct ParallelArchiveBuilder{
+    static_assert(cfg.symbols==builder_config_t::OWNED || cfg.symbols==builder_config_t::COMPRESS_LABELS || cfg.symbols==builder_config_t::COMPRESS_ALL,
+        "Only builders owning their symbols can be merged");
+
+    private:
+        struct part_t{
+            DocumentBuilder<cfg> builder;
+            std::vector<binary_header_t::section_t> fragments;
+        };
+        std::vector<std::unique_ptr<part_t>> parts_i;
+
+        inline details::BuilderBase::error_t commit(part_t& p, std::string_view docname){
+            if(auto t = p.builder.close_frame(docname); t.has_value())p.fragments.emplace_back(*t);
+            else{
+                p.builder.discard_frame();
+                return t.error();
+            }
+            return details::BuilderBase::error_t::OK;
+        }
+
+    public:
+
+    ///Construct a builder with `parts` independent parts.
+    inline explicit ParallelArchiveBuilder(size_t parts){
+        parts_i.reserve(parts);
+        for(size_t i=0;i<parts;i++)parts_i.push_back(std::make_unique<part_t>());
+    }
+
+    [[nodiscard]] inline size_t parts() const{return parts_i.size();}
+
+    inline void reserve(size_t part, typename ArchiveBuilder<cfg>::reserve_t sizes){
+        parts_i[part]->fragments.reserve(sizes.fragments);
+        parts_i[part]->builder.reserve(sizes);
+    }
+
+    ///Add a document to a part. Concurrent calls are safe as long as they target different parts. Malformed documents are dropped.
+    [[nodiscard]] inline details::BuilderBase::error_t document(size_t part, std::string_view docname, const std::function<void(DocumentBuilder<cfg>&)>& items){
+        auto& p = *parts_i[part];
+        items(p.builder);
+        return commit(p,docname);
+    }
+
+    ///Like `document`, but the document is dropped (returning SKIP) if `items` returns false, like when parsing fails.
+    [[nodiscard]] inline details::BuilderBase::error_t try_document(size_t part, std::string_view docname, const std::function<bool(DocumentBuilder<cfg>&)>& items){
+        auto& p = *parts_i[part];
+        if(!items(p.builder)){
+            p.builder.discard_frame();
+            return details::BuilderBase::error_t::SKIP;
+        }
+        return commit(p,docname);
+    }
+
+    /**
+     * @brief Merge all parts into an archive. The builder is left empty.
+     * @details It fails with TOO_LARGE, leaving the builder untouched, if there are more documents than an archive can index.
+     * @param executor if provided, used to remap parts in parallel.
+     */
+    [[nodiscard]] inline std::expected<stored::Archive,details::BuilderBase::error_t> close(Executor* executor = nullptr){
+        size_t total = 0;
+        for(auto& p : parts_i)total+=p->fragments.size();
+        if(total>std::numeric_limits<uint16_t>::max())return std::unexpected(details::BuilderBase::error_t::TOO_LARGE);
+
+        std::vector<details::archive_part_t> extracted;
+        extracted.reserve(parts_i.size());
+        for(auto& p : parts_i){
+            auto [buffer,symbols] = *p->builder.extract();
+            extracted.push_back({std::move(p->fragments),std::move(buffer),std::move(symbols)});
+        }
+        parts_i.clear();
+
+        std::vector<binary_header_t::section_t> sections;
+        std::vector<uint8_t> buffer, symbols;
+        if(!details::merge_archive_parts(extracted,cfg.symbols!=builder_config_t::OWNED,executor,sections,buffer,symbols))
+            return std::unexpected(details::BuilderBase::error_t::MISFORMED);
+        return stored::Archive(cfg,std::move(sections),std::move(buffer),std::move(symbols));
+    }
+};
+
 }
\ No newline at end of file
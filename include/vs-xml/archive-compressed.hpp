@@ -0,0 +1,134 @@
+#pragma once
+
+/**
+ * @file archive-compressed.hpp
+ * @author karurochari
+ * @brief Binaries compressed in independent blocks, and archives whose documents are decompressed on demand.
+ * @date 2025-07-03
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#include <expected>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <vs-xml/archive.hpp>
+#include <vs-xml/commons.hpp>
+#include <vs-xml/fwd/unordered_map.hpp>
+
+namespace VS_XML_NS{
+
+struct Executor;
+
+/**
+ * @brief Header of a compressed binary.
+ * @details It is followed by `blocks+1` offsets (uint64 each, relative to the beginning of the compressed binary) delimiting each block, and then by the blocks.
+ *          Block `i` holds bytes from `i*block_size` of the original binary, and is stored as is if its size is the same as the original one.
+ */
+struct compressed_header_t{
+    uint8_t     magic[4] = {'$','X','M','Z'};
+    uint8_t     codec = 0;          //0 for lz, the only one supported
+    uint8_t     res0 = 0;
+    uint16_t    res1 = 0;
+    uint32_t    block_size = 0;
+    uint32_t    res2 = 0;
+    uint64_t    length = 0;         //Of the original binary
+    uint64_t    blocks = 0;
+};
+static_assert(sizeof(compressed_header_t)==32,"compressed_header_t is expected to be 32 bytes");
+
+/**
+ * @brief Compress a binary (tree or archive) in blocks of `block_size` bytes, each one decodable on its own.
+ * @param executor if provided, blocks are compressed in parallel.
+ */
+bool compress_binary(std::span<const uint8_t> binary, std::ostream& out, uint32_t block_size = 64<<10, Executor* executor = nullptr);
+
+///Restore the original binary from a compressed one, with blocks decoded in parallel if an executor is provided.
+[[nodiscard]] std::expected<std::vector<uint8_t>, TreeRaw::from_binary_error_t> decompress_binary(std::span<const uint8_t> region, Executor* executor = nullptr);
+
+/**
+ * @brief Read-only archive over a compressed binary, decompressing documents only when they are accessed.
+ * @details Header, symbols and name index are decompressed when loading, documents are decompressed by `get` into buffers owned by the returned pointer.
+ *          Decoded blocks are kept in a cache shared by all documents, so neighbouring documents in the same block are only decoded once.
+ *          It is safe to use from multiple threads. Documents refer to the symbols of the archive, which must outlive them.
+ */
+struct CompressedArchive{
+    using from_binary_error_t = ArchiveRaw::from_binary_error_t;
+
+    struct stats_t{
+        size_t hits = 0;
+        size_t misses = 0;
+    };
+
+    /**
+     * @brief Load an archive compressed with `compress_binary`, keeping up to `cache_blocks` decoded blocks in memory.
+     * @param verify if true, each document is checked with TreeRaw::verify when decompressed, and not returned if invalid.
+     */
+    [[nodiscard]] static std::expected<CompressedArchive, from_binary_error_t> from_binary(std::span<const uint8_t> region, size_t cache_blocks = 32, bool verify = false);
+
+    ///The number of items present in this archive
+    [[nodiscard]] inline size_t items() const{return catalog.items();}
+
+    ///Position of the first document with a given name, if any.
+    [[nodiscard]] inline std::optional<size_t> find(std::string_view name) const{return catalog.find(name);}
+
+    ///Decompress the document in position idx, or nullptr if not available.
+    [[nodiscard]] std::shared_ptr<const DocumentRaw> get(size_t idx) const;
+
+    ///Decompress the document with a given name, or nullptr if not available.
+    [[nodiscard]] inline std::shared_ptr<const DocumentRaw> get(std::string_view name) const{
+        if(auto idx = find(name); idx.has_value())return get(*idx);
+        return {};
+    }
+
+    /**
+     * @brief Copy a range of the original binary, decompressing the blocks it spans.
+     * @return false if out of bounds or if any block is corrupted.
+     */
+    bool read(uint64_t offset, std::span<uint8_t> out) const;
+
+    ///Size of the original binary.
+    [[nodiscard]] inline uint64_t size() const{return header.length;}
+
+    [[nodiscard]] inline std::span<const uint8_t> symbols() const{return symbols_i;}
+
+    [[nodiscard]] stats_t stats() const;
+
+    private:
+        struct cache_t{
+            std::mutex lock;
+            size_t capacity;
+            std::list<std::pair<uint64_t,std::shared_ptr<const std::vector<uint8_t>>>> lru;
+            VS_XML_NS::unordered_map<uint64_t,decltype(lru)::iterator> entries;
+            stats_t counters;
+        };
+
+        std::span<const uint8_t>    region;
+        compressed_header_t         header;
+        std::span<const uint64_t>   offsets;
+        std::vector<uint8_t>        head;           //Original binary up to the beginning of the data
+        std::span<const uint8_t>    symbols_i;
+        std::vector<uint32_t>       names;
+        size_t                      start_data = 0;
+        ArchiveRaw                  catalog;        //Sections and names only, its data is not available
+        builder_config_t            configs;
+        bool                        verify = false;
+        std::unique_ptr<cache_t>    cache;
+
+        CompressedArchive(const ArchiveRaw& catalog):catalog(catalog){}
+
+        std::shared_ptr<const std::vector<uint8_t>> block(uint64_t idx) const;
+};
+
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+/**
+ * @file archive-segments.hpp
+ * @author karurochari
+ * @brief Append-only archives, made of a sequence of independent archive segments each closed by a small footer.
+ * @date 2025-07-01
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#include <expected>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <vs-xml/archive.hpp>
+#include <vs-xml/commons.hpp>
+
+namespace VS_XML_NS{
+
+/**
+ * @brief Read-only view over a segmented archive.
+ * @details A segmented archive is a sequence of segments, each one being the binary of a regular archive (with its own symbols),
+ *          padded to 16 bytes and followed by a `footer_t`. Footers only refer to their own segment, so segments are appended
+ *          without reading or rewriting anything already written, and the file stays valid after each append.
+ *          Any prefix of the file ending with a footer is a complete snapshot: readers which mapped the file before an append
+ *          keep using their old size, and see new documents by loading the region again.
+ *          Positions of documents are global, in the order they were appended. Each segment is limited to 65535 documents, the archive is not.
+ */
+struct SegmentedArchive{
+    struct footer_t{
+        uint8_t  magic[4] = {'$','X','S','G'};
+        uint16_t padding = 0;       //Bytes between the end of the segment and the footer.
+        uint16_t docs = 0;          //Documents in the segment, as in its header.
+        uint64_t length = 0;        //Of the segment, excluding padding.
+    };
+    static_assert(sizeof(footer_t)==16,"footer_t is expected to be 16 bytes");
+
+    using from_binary_error_t = ArchiveRaw::from_binary_error_t;
+
+    /**
+     * @brief Write an archive as a new segment at the end of a stream, which must be empty or end with a segment.
+     * @details The segment is serialized in memory and written with a single call, so streams opened in append mode never hold partial segments
+     *          unless the write itself fails.
+     */
+    static bool append(std::ostream& out, const ArchiveRaw& archive, std::span<const binary_extension_t> extensions = {});
+
+    /**
+     * @brief Like the stream variant, writing to a file descriptor opened with `O_APPEND`.
+     * @details Only available on POSIX systems. Concurrent appenders must be serialized by the caller.
+     */
+    static bool append(int fd, const ArchiveRaw& archive, std::span<const binary_extension_t> extensions = {});
+
+    /**
+     * @brief Load all segments in a memory region, like a file mapped in memory. The region must start with the first segment.
+     * @details Only the footers and headers are visited, unless verification is requested. An empty region is an empty archive.
+     * @param verify applied to each segment, see ArchiveRaw::from_binary.
+     */
+    [[nodiscard]] static std::expected<SegmentedArchive, from_binary_error_t> from_binary(std::span<const uint8_t> region, ArchiveRaw::verify_t verify = ArchiveRaw::verify_t::NONE, Executor* executor = nullptr);
+
+    ///Number of documents across all segments.
+    [[nodiscard]] inline size_t items() const{return starts.size()==0?0:starts.back();}
+
+    [[nodiscard]] inline size_t segments() const{return parts.size();}
+
+    ///The archive of a segment.
+    [[nodiscard]] inline const ArchiveRaw& segment(size_t idx) const{return parts[idx];}
+
+    ///Bytes of the region which were loaded.
+    [[nodiscard]] inline size_t size_bytes() const{return length;}
+
+    ///Segment holding the document in position `idx`, and its position in there.
+    [[nodiscard]] std::optional<std::pair<size_t,size_t>> locate(size_t idx) const;
+
+    ///Get the raw document in position idx if available.
+    [[nodiscard]] std::optional<const DocumentRaw> get(size_t idx) const;
+
+    ///Position of the first document with a given name, if any. Segments are visited in order, each using its own name index.
+    [[nodiscard]] std::optional<size_t> find(std::string_view name) const;
+
+    ///Get the raw document with a given name if it exists.
+    [[nodiscard]] std::optional<const DocumentRaw> get(std::string_view name) const;
+
+    private:
+        std::vector<ArchiveRaw> parts;
+        std::vector<size_t>     starts;     //Documents up to the end of each segment.
+        size_t                  length = 0;
+
+        SegmentedArchive() = default;
+};
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+/**
+ * @file archive-shared.hpp
+ * @author karurochari
+ * @brief Archives published in shared memory, so that many processes on the same host use a single copy of them.
+ * @date 2025-07-07
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#include <expected>
+#include <span>
+#include <string_view>
+
+#include <vs-xml/archive.hpp>
+#include <vs-xml/commons.hpp>
+#include <vs-xml/mapped.hpp>
+
+namespace VS_XML_NS{
+
+struct Executor;
+
+/**
+ * @brief Write the binary of an archive into a new named shared memory object (see `shm_open`).
+ * @details Binaries only hold relative offsets, so readers attach to them as they are, without any relocation or copy.
+ *          The archive is serialized twice, first to measure it and then straight into the shared memory, so nothing else is allocated.
+ *          The object has no permissions while being written and gets `mode` once complete, so readers never attach to partial content.
+ *          Names which already exist are not replaced: publish new versions under new names, and unpublish the old ones once readers moved on.
+ *          Only available on POSIX systems.
+ * @param name of the object, a leading '/' is added if missing.
+ */
+[[nodiscard]] std::expected<void, mapped_error_t> publish_archive(std::string_view name, const ArchiveRaw& archive, std::span<const binary_extension_t> extensions = {}, unsigned mode = 0444);
+
+///Like `publish_archive`, for an existing binary (like a file mapped in memory) which is checked to be a valid archive first.
+[[nodiscard]] std::expected<void, mapped_error_t> publish_binary(std::string_view name, std::span<const uint8_t> binary, unsigned mode = 0444);
+
+///Remove the name of a shared memory object. Processes already attached keep using it, and its memory is freed once all of them are gone.
+bool unpublish_archive(std::string_view name);
+
+/**
+ * @brief Attach read-only to an archive published by `publish_archive`, mapping its pages without copying them.
+ * @param access,verify,executor see MappedArchive::open.
+ */
+[[nodiscard]] std::expected<MappedArchive, mapped_error_t> attach_archive(std::string_view name, access_t access = access_t::RANDOM, ArchiveRaw::verify_t verify = ArchiveRaw::verify_t::NONE, Executor* executor = nullptr);
+
+/**
+ * @brief Write the binary of an archive into an anonymous memory file (see `memfd_create`), sealed against further changes.
+ * @details The descriptor is passed to other processes by inheriting it (it is created with close-on-exec, which must be cleared for `exec`)
+ *          or over a unix socket, and attached with `attach_archive(fd)`. Once all descriptors and mappings are gone, its memory is freed.
+ *          Only available on Linux.
+ * @return the file descriptor, owned by the caller.
+ */
+[[nodiscard]] std::expected<int, mapped_error_t> publish_archive_fd(const ArchiveRaw& archive, std::span<const binary_extension_t> extensions = {});
+
+///Attach read-only to an archive in a file descriptor, like one from `publish_archive_fd`. The descriptor is not closed.
+[[nodiscard]] std::expected<MappedArchive, mapped_error_t> attach_archive(int fd, access_t access = access_t::RANDOM, ArchiveRaw::verify_t verify = ArchiveRaw::verify_t::NONE, Executor* executor = nullptr);
+
+}
@@ -10,8 +10,12 @@
  * 
  */
 
+#include <atomic>
 #include <cstdint>
+#include <memory>
+#include <optional>
 #include <string_view>
+#include <vector>
 #include <vs-xml/commons.hpp>
 #include <vs-xml/document.hpp>
 
@@ -28,19 +32,52 @@ struct ArchiveRaw{
         std::span<uint8_t> buffer;
         std::span<uint8_t> symbols;
         builder_config_t configs;
+        std::span<const uint32_t> names;    //Positions in `index` sorted by name, empty if not available.
+        std::shared_ptr<std::atomic<uint8_t>[]> checked;   //State of each document when verified lazily, see verify_t.
+
+        enum : uint8_t {UNCHECKED, VALID, INVALID};
+
+        //Verify the document in position idx on first access, if requested when loading.
+        inline bool trusted(size_t idx) const{
+            if(!checked)return true;
+            auto state = checked[idx].load(std::memory_order_acquire);
+            if(state==UNCHECKED){
+                auto v = index[idx];
+                state = DocumentRaw(configs,std::span{buffer.data()+v.base,v.length},std::span{symbols.begin(),symbols.end()}).verify().has_value()?VALID:INVALID;
+                checked[idx].store(state,std::memory_order_release);
+            }
+            return state==VALID;
+        }
 
     public:
 
     using from_binary_error_t = TreeRaw::from_binary_error_t;
 
-    ///Save a binary representation for this raw archive to an output stream.
-    bool save_binary(std::ostream& out)const;
+    ///How documents are checked when loading an archive, see TreeRaw::verify.
+    enum struct verify_t{
+        NONE,   ///Content is trusted.
+        EAGER,  ///All documents are checked by from_binary, which fails if any is not valid.
+        LAZY,   ///Each document is checked the first time it is accessed, and `get` does not return it if not valid.
+    };
 
-    ///Load this raw archive with data from a memory region, and return it unless failure.
-    [[nodiscard]] static std::expected<ArchiveRaw, ArchiveRaw::from_binary_error_t> from_binary(std::span<uint8_t> region);
+    ///Save a binary representation for this raw archive to an output stream, with optional side sections and checksums of each document attached (see verify_checksums).
+    bool save_binary(std::ostream& out, std::span<const binary_extension_t> extensions = {}, bool checksums = false)const;
+
+    /**
+     * @brief Load this raw archive with data from a memory region, and return it unless failure.
+     * @param verify how the content of documents is checked, sections are always checked to be within the region.
+     * @param executor if provided, documents are verified in parallel with EAGER.
+     */
+    [[nodiscard]] static std::expected<ArchiveRaw, ArchiveRaw::from_binary_error_t> from_binary(std::span<uint8_t> region, verify_t verify = verify_t::NONE, Executor* executor = nullptr);
 
     ///Load this raw archive with data from a memory region, and return it unless failure.
-    [[nodiscard]] static std::expected<const ArchiveRaw, ArchiveRaw::from_binary_error_t> from_binary(std::span<const uint8_t> region);
+    [[nodiscard]] static std::expected<const ArchiveRaw, ArchiveRaw::from_binary_error_t> from_binary(std::span<const uint8_t> region, verify_t verify = verify_t::NONE, Executor* executor = nullptr);
+
+    /**
+     * @brief Positions of the sections sorted by name (ties by position), as stored in the `ARCHIVE_NAMES` extension.
+     * @param symbols the symbol table names are relative to.
+     */
+    [[nodiscard]] static std::vector<uint32_t> sort_names(std::span<const binary_header_t::section_t> index, const uint8_t* symbols);
 
     ///Resolve a string view referred to the current symbol table to an absolute string view.
     [[nodiscard]] inline std::string_view rsv(sv s) const{
@@ -50,7 +87,7 @@ struct ArchiveRaw{
     ///Get the raw document in position idx if available
     [[nodiscard]] inline std::optional<DocumentRaw> get(size_t idx){
         //xml_assert(documents.size()>idx, "Out of bounds document selected");
-        if(idx>index.size())return {};
+        if(idx>=index.size() || !trusted(idx))return {};
         auto v = index[idx];
         return DocumentRaw(configs,std::span{buffer.data()+v.base,v.length},std::span{symbols.begin(),symbols.end()});
     }
@@ -58,41 +95,56 @@ struct ArchiveRaw{
     ///Get a constant raw document in position idx if available
     [[nodiscard]] inline std::optional<const DocumentRaw> get(size_t idx) const{
         //xml_assert(documents.size()>idx, "Out of bounds document selected");
-        if(idx>index.size())return {};
+        if(idx>=index.size() || !trusted(idx))return {};
         auto v = index[idx];
         return DocumentRaw(configs,std::span{buffer.data()+v.base,v.length},std::span{symbols.begin(),symbols.end()});
     }
 
-    ///Get the raw document with a given name if it exists
-    [[nodiscard]] inline std::optional<DocumentRaw> get(std::string_view name){
-        //TODO introduce support for an ordered index?
-        for(auto& doc: index){
-            if(rsv({doc.name.base, doc.name.length})==name){
-                return DocumentRaw(configs,std::span{buffer.data()+doc.base,doc.length},std::span{symbols.begin(),symbols.end()});
+    /**
+     * @brief Position of the first document with a given name, if any.
+     * @details Bisection over the sorted names when available, linear scan otherwise. It never allocates.
+     */
+    [[nodiscard]] inline std::optional<size_t> find(std::string_view name) const{
+        auto label = [&](size_t i){return rsv({index[i].name.base, index[i].name.length});};
+        if(names.size()==0){
+            for(size_t i=0;i<index.size();i++){
+                if(label(i)==name)return i;
             }
+            return {};
+        }
+        size_t lo = 0, hi = names.size();
+        while(lo<hi){
+            size_t mid = lo+(hi-lo)/2;
+            if(names[mid]>=index.size())return {};
+            if(label(names[mid])<name)lo=mid+1;
+            else hi=mid;
         }
+        if(lo<names.size() && names[lo]<index.size() && label(names[lo])==name)return names[lo];
+        return {};
+    }
+
+    ///Get the raw document with a given name if it exists
+    [[nodiscard]] inline std::optional<DocumentRaw> get(std::string_view name){
+        if(auto idx = find(name); idx.has_value())return get(*idx);
         return {};
     }
 
     ///Get the const raw document with a given name if it exists
     inline std::optional<const DocumentRaw> get(std::string_view name) const{
-        for(auto& doc: index){
-            if(rsv({doc.name.base, doc.name.length})==name){
-                return DocumentRaw(configs,std::span{buffer.data()+doc.base,doc.length},symbols);
-            }
-        }
+        if(auto idx = find(name); idx.has_value())return get(*idx);
         return {};
     }
 
-    inline ArchiveRaw(const builder_config_t& cfg, std::span<binary_header_t::section_t> docs, std::span<uint8_t> buff, std::span<uint8_t> syms = {(uint8_t*)nullptr, std::span<uint8_t>::extent}):
-        index(docs),buffer(buff),symbols(syms),configs(cfg)
+    inline ArchiveRaw(const builder_config_t& cfg, std::span<binary_header_t::section_t> docs, std::span<uint8_t> buff, std::span<uint8_t> syms = {(uint8_t*)nullptr, std::span<uint8_t>::extent}, std::span<const uint32_t> sorted = {}):
+        index(docs),buffer(buff),symbols(syms),configs(cfg),names(sorted)
     {}
 
-    inline ArchiveRaw(const builder_config_t& cfg, std::span<const binary_header_t::section_t> docs, std::span<const uint8_t> buff, std::span<const uint8_t> syms = {(const uint8_t*)nullptr, std::span<uint8_t>::extent}):
+    inline ArchiveRaw(const builder_config_t& cfg, std::span<const binary_header_t::section_t> docs, std::span<const uint8_t> buff, std::span<const uint8_t> syms = {(const uint8_t*)nullptr, std::span<uint8_t>::extent}, std::span<const uint32_t> sorted = {}):
         index((binary_header_t::section_t*)docs.data(),docs.size()),
         buffer((uint8_t*)buff.data(),buff.size()),
         symbols((uint8_t*)syms.data(),syms.size()),
-        configs(cfg)
+        configs(cfg),
+        names(sorted)
     {}
 
     ///The number of items present in this archive
@@ -135,15 +187,15 @@ struct Archive : ArchiveRaw{
     }
 
     ///Load this archive with data from a memory region, and return it unless failure.
-    [[nodiscard]] static inline std::expected<Archive, ArchiveRaw::from_binary_error_t> from_binary(std::span<uint8_t> region){
-        auto tmp = ArchiveRaw::from_binary(region);
+    [[nodiscard]] static inline std::expected<Archive, ArchiveRaw::from_binary_error_t> from_binary(std::span<uint8_t> region, verify_t verify = verify_t::NONE, Executor* executor = nullptr){
+        auto tmp = ArchiveRaw::from_binary(region,verify,executor);
         if(tmp.has_value())return Archive(std::move(*tmp));
         else return tmp;
     }
     
     ///Load this const archive with const data from a memory region, and return it unless failure.
-    [[nodiscard]] static inline std::expected<const Archive, ArchiveRaw::from_binary_error_t> from_binary(std::span<const uint8_t> region){
-        auto tmp = ArchiveRaw::from_binary(region);
+    [[nodiscard]] static inline std::expected<const Archive, ArchiveRaw::from_binary_error_t> from_binary(std::span<const uint8_t> region, verify_t verify = verify_t::NONE, Executor* executor = nullptr){
+        auto tmp = ArchiveRaw::from_binary(region,verify,executor);
         if(tmp.has_value())return Archive(std::move(*tmp));
         else return tmp;
     }
@@ -165,12 +217,13 @@ struct StorageFor<ArchiveRaw>{
     std::vector<binary_header_t::section_t> index_i;
     std::vector<uint8_t> buffer_i;
     std::vector<uint8_t> symbols_i;
+    std::vector<uint32_t> names_i;
 
-    StorageFor(const builder_config_t& cfg, std::vector<binary_header_t::section_t>&& index, std::vector<uint8_t>&& buf, std::vector<uint8_t>&& sym):index_i(index),buffer_i(buf),symbols_i(sym){}
-    StorageFor(const builder_config_t& cfg, std::vector<binary_header_t::section_t>&& index, std::vector<uint8_t>&& buf, const void* label_offset=nullptr):index_i(index),buffer_i(buf){}
+    StorageFor(const builder_config_t& cfg, std::vector<binary_header_t::section_t>&& index, std::vector<uint8_t>&& buf, std::vector<uint8_t>&& sym):index_i(index),buffer_i(buf),symbols_i(sym),names_i(ArchiveRaw::sort_names(index_i,symbols_i.data())){}
+    StorageFor(const builder_config_t& cfg, std::vector<binary_header_t::section_t>&& index, std::vector<uint8_t>&& buf, const void* label_offset=nullptr):index_i(index),buffer_i(buf),names_i(ArchiveRaw::sort_names(index_i,(const uint8_t*)label_offset)){}
 
-    static ArchiveRaw bind(const StorageFor& storage, const builder_config_t& cfg, std::vector<binary_header_t::section_t>&& idx, std::vector<uint8_t>&& buff, std::vector<uint8_t>&& sym)  {return ArchiveRaw(cfg,storage.index_i,storage.buffer_i,storage.symbols_i);}
-    static ArchiveRaw bind(const StorageFor& storage, const builder_config_t& cfg, std::vector<binary_header_t::section_t>&& idx, std::vector<uint8_t>&& buff, const void* label_offset=nullptr)  {return ArchiveRaw(cfg,storage.index_i,storage.buffer_i, {(uint8_t*)label_offset,std::span<uint8_t>::extent});}
+    static ArchiveRaw bind(const StorageFor& storage, const builder_config_t& cfg, std::vector<binary_header_t::section_t>&& idx, std::vector<uint8_t>&& buff, std::vector<uint8_t>&& sym)  {return ArchiveRaw(cfg,storage.index_i,storage.buffer_i,storage.symbols_i,storage.names_i);}
+    static ArchiveRaw bind(const StorageFor& storage, const builder_config_t& cfg, std::vector<binary_header_t::section_t>&& idx, std::vector<uint8_t>&& buff, const void* label_offset=nullptr)  {return ArchiveRaw(cfg,storage.index_i,storage.buffer_i, {(uint8_t*)label_offset,std::span<uint8_t>::extent},storage.names_i);}
 
 };
 
@@ -179,12 +232,13 @@ struct StorageFor<Archive>{
     std::vector<binary_header_t::section_t> index_i;
     std::vector<uint8_t> buffer_i;
     std::vector<uint8_t> symbols_i;
+    std::vector<uint32_t> names_i;
 
-    StorageFor(const builder_config_t& cfg, std::vector<binary_header_t::section_t>&& index, std::vector<uint8_t>&& buf, std::vector<uint8_t>&& sym):index_i(index),buffer_i(buf),symbols_i(sym){}
-    StorageFor(const builder_config_t& cfg, std::vector<binary_header_t::section_t>&& index, std::vector<uint8_t>&& buf, const void* label_offset=nullptr):index_i(index),buffer_i(buf){}
+    StorageFor(const builder_config_t& cfg, std::vector<binary_header_t::section_t>&& index, std::vector<uint8_t>&& buf, std::vector<uint8_t>&& sym):index_i(index),buffer_i(buf),symbols_i(sym),names_i(ArchiveRaw::sort_names(index_i,symbols_i.data())){}
+    StorageFor(const builder_config_t& cfg, std::vector<binary_header_t::section_t>&& index, std::vector<uint8_t>&& buf, const void* label_offset=nullptr):index_i(index),buffer_i(buf),names_i(ArchiveRaw::sort_names(index_i,(const uint8_t*)label_offset)){}
 
-    static ArchiveRaw bind(const StorageFor& storage, const builder_config_t& cfg, std::vector<binary_header_t::section_t>&& idx, std::vector<uint8_t>&& buff, std::vector<uint8_t>&& sym)  {return Archive(ArchiveRaw(cfg,storage.index_i,storage.buffer_i,storage.symbols_i));}
-    static ArchiveRaw bind(const StorageFor& storage, const builder_config_t& cfg, std::vector<binary_header_t::section_t>&& idx, std::vector<uint8_t>&& buff, const void* label_offset=nullptr)  {return Archive(ArchiveRaw(cfg,storage.index_i,storage.buffer_i, {(uint8_t*)label_offset,std::span<uint8_t>::extent}));}
+    static ArchiveRaw bind(const StorageFor& storage, const builder_config_t& cfg, std::vector<binary_header_t::section_t>&& idx, std::vector<uint8_t>&& buff, std::vector<uint8_t>&& sym)  {return Archive(ArchiveRaw(cfg,storage.index_i,storage.buffer_i,storage.symbols_i,storage.names_i));}
+    static ArchiveRaw bind(const StorageFor& storage, const builder_config_t& cfg, std::vector<binary_header_t::section_t>&& idx, std::vector<uint8_t>&& buff, const void* label_offset=nullptr)  {return Archive(ArchiveRaw(cfg,storage.index_i,storage.buffer_i, {(uint8_t*)label_offset,std::span<uint8_t>::extent},storage.names_i));}
 
 };
 
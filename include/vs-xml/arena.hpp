@@ -0,0 +1,98 @@
+#pragma once
+
+/**
+ * @file arena.hpp
+ * @author karurochari
+ * @brief Growable buffer over a large reservation of address space, whose memory is only committed when used.
+ * @date 2025-07-06
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#include <span>
+#include <vector>
+
+#include <vs-xml/commons.hpp>
+
+namespace VS_XML_NS{
+
+/**
+ * @brief Byte buffer which never moves once created, used as storage for builders of very large trees.
+ * @details A range of address space is reserved upfront without backing memory, and made accessible in steps as the buffer grows.
+ *          Physical pages are only allocated by the kernel when first written, so growing costs page faults instead of reallocations and copies,
+ *          and pointers to the content stay valid until the arena is destroyed.
+ *          The interface mirrors the subset of `std::vector<uint8_t>` used by builders, including bytes being zero when first exposed by `resize`.
+ *          Only available on POSIX systems: elsewhere it falls back to a vector, which is reallocated as usual.
+ */
+struct SparseArena{
+    ///Address space reserved by default, it does not consume memory.
+    static constexpr size_t default_reserve = sizeof(void*)>=8?(size_t(1)<<36):(size_t(1)<<28);
+
+    ///An empty arena, without any reservation.
+    SparseArena() = default;
+
+    /**
+     * @brief Reserve `reserve` bytes of address space.
+     * @details It throws std::bad_alloc if the address space is not available.
+     */
+    explicit SparseArena(size_t reserve);
+
+    SparseArena(SparseArena&& other) noexcept;
+    SparseArena& operator=(SparseArena&& other) noexcept;
+    ///A copy with the same reservation.
+    SparseArena(const SparseArena& other);
+    SparseArena& operator=(const SparseArena& other);
+    ~SparseArena();
+
+    [[nodiscard]] inline uint8_t* data(){return ptr;}
+    [[nodiscard]] inline const uint8_t* data() const{return ptr;}
+    [[nodiscard]] inline size_t size() const{return length;}
+    [[nodiscard]] inline uint8_t* begin(){return ptr;}
+    [[nodiscard]] inline uint8_t* end(){return ptr+length;}
+    [[nodiscard]] inline std::span<uint8_t> bytes(){return {ptr,length};}
+    [[nodiscard]] inline std::span<const uint8_t> bytes() const{return {ptr,length};}
+
+    ///Bytes of address space reserved, the largest size this arena can reach.
+    [[nodiscard]] inline size_t capacity() const{return reserved;}
+
+    ///Bytes made accessible so far. Only those which were written use physical memory.
+    [[nodiscard]] inline size_t committed() const{return accessible;}
+
+    /**
+     * @brief Change the size of the buffer, committing more of the reservation if needed.
+     * @details It throws std::bad_alloc when growing beyond the reservation, like vectors do when running out of memory.
+     */
+    inline void resize(size_t size){
+        if(size>accessible)commit(size);
+        if(size>length && length<dirty)clean(size);
+        length = size;
+        if(length>dirty)dirty = length;
+    }
+
+    inline void clear(){length = 0;}
+
+    /**
+     * @brief Return to the system all pages past the current size, like under memory pressure or after discarding large parts of the content.
+     * @details They are committed again, and zero, if the arena grows back.
+     */
+    void release();
+
+    private:
+        uint8_t*                ptr = nullptr;
+        size_t                  length = 0;
+        size_t                  accessible = 0;
+        size_t                  reserved = 0;
+        size_t                  dirty = 0;      //Bytes up to here might have been written, and must be cleared when exposed again.
+#if !__has_include(<sys/mman.h>)
+        std::vector<uint8_t>    fallback;
+#endif
+
+        void commit(size_t size);
+        void clean(size_t size);
+};
+
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+/**
+ * @file attr-index.hpp
+ * @author karurochari
+ * @brief Hash index of attribute values, for equality lookups like `//item[@id='X']`.
+ * @date 2025-06-26
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#include <expected>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <vs-xml/commons.hpp>
+#include <vs-xml/postings.hpp>
+#include <vs-xml/tree.hpp>
+
+namespace VS_XML_NS{
+
+/**
+ * @brief Index from the values of selected attributes to the sorted list of elements carrying them.
+ * @details Values are grouped by attribute label (namespace and name), and sorted by the hash of their unescaped text within each label.
+ *          Collisions are resolved by comparing the text itself, which is referenced from the symbols of the tree.
+ *          Stored next to its tree as an ATTR_INDEX extension, see extension_kind_t.
+ */
+struct AttrIndex{
+    struct header_t{
+        uint8_t  magic[4] = {'$','X','A','I'};
+        uint8_t  width = 4;             //Size in bytes of each entry in the posting lists, either 4 or 8.
+        uint8_t  res[3] = {};
+        uint32_t labels = 0;
+        uint32_t flags = 0;             //See flags_t.
+        uint64_t values = 0;
+        uint64_t postings = 0;
+    };
+    static_assert(sizeof(header_t)==32, "header_t is expected to be 32 bytes");
+
+    enum flags_t : uint32_t{
+        COMPLETE = 1<<0,                ///In the header, all attributes of the tree are indexed.
+        ALL_NS   = 1<<1,                ///In a label, its name was selected for any namespace.
+    };
+
+    ///Entry of the label table. Labels are sorted by name first, and then by namespace.
+    struct label_t{
+        int64_t  ns_base;               //Relative to the symbols of the tree.
+        int64_t  name_base;             //Relative to the symbols of the tree.
+        uint32_t ns_length;
+        uint32_t name_length;
+        uint64_t first;                 //Position of the first value for this label.
+        uint64_t count;                 //Number of distinct values for this label.
+        uint32_t flags;                 //See flags_t.
+        uint32_t res = 0;
+    };
+    static_assert(sizeof(label_t)==48, "label_t is expected to be 48 bytes");
+
+    ///Entry of the value table. Values of each label are sorted by hash.
+    struct value_t{
+        uint64_t hash;                  //See `hash()`.
+        int64_t  base;                  //Relative to the symbols of the tree, as stored there (escaped for raw strings).
+        uint32_t length;
+        uint32_t res = 0;
+        uint64_t first;                 //Position of the first posting for this value.
+        uint64_t count;                 //Number of postings for this value.
+    };
+    static_assert(sizeof(value_t)==40, "value_t is expected to be 40 bytes");
+
+    ///Attribute label to be indexed. If the namespace is not specified, attributes with that name are indexed for any namespace.
+    struct selector_t{
+        std::optional<std::string_view> ns;
+        std::string_view name;
+    };
+
+    enum struct from_binary_error_t{
+        OK,
+        Missing,
+        HeaderTooSmall,
+        MagicMismatch,
+        TruncatedSpan,
+        OutOfBounds,
+    };
+
+    /**
+     * @brief Build the index for a tree with a single visit.
+     *
+     * @param tree the tree to index.
+     * @param selected attribute labels to index. If empty, all attributes are indexed.
+     */
+    [[nodiscard]] static AttrIndex build(const TreeRaw& tree, std::span<const selector_t> selected = {});
+
+    /**
+     * @brief Load the index attached to a binary as extension, for the document in position `doc`.
+     * @details Data is not copied, so `region` must outlive the index.
+     */
+    [[nodiscard]] static std::expected<AttrIndex,from_binary_error_t> from_binary(std::span<const uint8_t> region, uint32_t doc = 0);
+
+    ///Stable 64bit hash (FNV-1a) of an unescaped value.
+    [[nodiscard]] static constexpr inline uint64_t hash(std::string_view value){return fnv1a(value);}
+
+    ///The binary representation of this index.
+    [[nodiscard]] inline std::span<const uint8_t> bytes() const{return data;}
+
+    ///Side section to pass to `save_binary` for this index to be stored along with its tree.
+    [[nodiscard]] inline binary_extension_t extension(uint32_t doc = 0) const{return {extension_kind_t::ATTR_INDEX,doc,data};}
+
+    [[nodiscard]] inline const header_t& header() const{return *(const header_t*)data.data();}
+
+    ///All indexed labels, sorted by name and then by namespace.
+    [[nodiscard]] inline std::span<const label_t> labels() const{
+        return {(const label_t*)(data.data()+sizeof(header_t)),header().labels};
+    }
+
+    ///All values, grouped by label.
+    [[nodiscard]] inline std::span<const value_t> values() const{
+        return {(const value_t*)(data.data()+sizeof(header_t)+sizeof(label_t)*header().labels),header().values};
+    }
+
+    ///All posting lists, back to back.
+    [[nodiscard]] inline postings_t postings() const{
+        return {data.data()+sizeof(header_t)+sizeof(label_t)*header().labels+sizeof(value_t)*header().values,header().width};
+    }
+
+    ///Positions in `labels()` of all the indexed labels with a given name, for any namespace.
+    [[nodiscard]] std::pair<size_t,size_t> find(const TreeRaw& tree, std::string_view name) const;
+
+    ///Position in `labels()` of the indexed label with a given namespace and name, if present.
+    [[nodiscard]] std::optional<size_t> find(const TreeRaw& tree, std::string_view ns, std::string_view name) const;
+
+    /**
+     * @brief True if all attributes named `name` (for any namespace when `ns` is not specified) of the tree are indexed.
+     * @details Only then the absence of a value from the index proves that no element carries it.
+     */
+    [[nodiscard]] bool covers(const TreeRaw& tree, std::optional<std::string_view> ns, std::string_view name) const;
+
+    ///Position in `values()` of a value for the label in position `label`, if present.
+    [[nodiscard]] std::optional<size_t> find_value(const TreeRaw& tree, size_t label, std::string_view value) const;
+
+    /**
+     * @brief Visit in document order all elements in [first,last) carrying any of the selected values.
+     *
+     * @param tree the tree this index was built for.
+     * @param selected positions in `values()`, like those returned by `find_value`.
+     * @param first first node of the range, usually the first child of some element.
+     * @param last end of the range, usually the end of that element.
+     * @param fn called for each element, return false to stop.
+     * @return false if stopped by `fn`, true otherwise.
+     */
+    template<typename Fn>
+    bool visit(const TreeRaw& tree, std::span<const uint32_t> selected, const unknown_t* first, const unknown_t* last, Fn&& fn) const{
+        auto v = values();
+        return postings().visit(tree,selected.size(),[&](size_t j){return std::pair<size_t,size_t>{v[selected[j]].first,v[selected[j]].count};},first,last,std::forward<Fn>(fn));
+    }
+
+    /**
+     * @brief Visit in document order all the elements below `node` with an attribute `name` (and namespace if specified) equal to `value`.
+     * @details Only attributes indexed are considered, see `covers`.
+     */
+    template<typename Fn>
+    bool descendants(const TreeRaw& tree, const unknown_t* node, std::string_view name, std::optional<std::string_view> ns, std::string_view value, Fn&& fn) const{
+        if(node->type()!=type_t::ELEMENT)return true;
+        std::vector<uint32_t> selected;
+        auto add = [&](size_t label){
+            if(auto v = find_value(tree,label,value); v.has_value())selected.push_back(*v);
+        };
+        if(ns.has_value()){
+            if(auto l = find(tree,*ns,name); l.has_value())add(*l);
+        }
+        else{
+            auto [a,b] = find(tree,name);
+            for(;a<b;a++)add(a);
+        }
+        if(selected.size()==0)return true;
+        auto [first,last] = *node->children_range();
+        return visit(tree,selected,first,last,std::forward<Fn>(fn));
+    }
+
+    AttrIndex(AttrIndex&&) = default;
+    AttrIndex& operator=(AttrIndex&&) = default;
+    AttrIndex(const AttrIndex&) = delete;
+    AttrIndex& operator=(const AttrIndex&) = delete;
+
+    private:
+        std::vector<uint8_t>        owned;      //Empty when `data` points into a binary.
+        std::span<const uint8_t>    data;
+
+        inline AttrIndex(std::vector<uint8_t>&& src):owned(std::move(src)),data(owned){}
+        inline AttrIndex(std::span<const uint8_t> src):data(src){}
+};
+
+}
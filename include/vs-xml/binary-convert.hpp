@@ -0,0 +1,87 @@
+#pragma once
+
+/**
+ * @file binary-convert.hpp
+ * @author karurochari
+ * @brief Conversion of binaries between memory layouts and endianess, without parsing XML again.
+ * @date 2025-07-02
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#include <expected>
+#include <ostream>
+#include <span>
+#include <string_view>
+
+#include <vs-xml/commons.hpp>
+
+namespace VS_XML_NS{
+
+///Layout of the nodes in a binary, as selected by VS_XML_LAYOUT when building it, and its byte order.
+struct binary_layout_t{
+    uint8_t                         layout = VS_XML_LAYOUT;
+    binary_header_t::endianess_t    endianess = std::endian::native==std::endian::little?binary_header_t::endianess_t::LITTLE:binary_header_t::endianess_t::BIG;
+
+    ///The one used by this build, which `from_binary` expects.
+    static constexpr binary_layout_t native(){return {};}
+
+    bool operator==(const binary_layout_t&) const = default;
+};
+
+struct convert_error_t{
+    enum Code {
+        OK = 0,
+        HeaderTooSmall,         // "Header of the binary not matching minimum size."
+        MagicMismatch,          // "Header of the binary not matching the format."
+        MajorVersionMismatch,   // "The binary was generated in a different major revision of the format."
+        MinorVersionTooHigh,    // "The binary was generated in a minor revision released after this build."
+        UnknownLayout,          // "The binary does not use any known layout."
+        TruncatedSpan,          // "Truncated span for the binary."
+        TreeOutOfBounds,        // "A tree of the binary is out of bounds."
+        Overflow,               // "A value does not fit the target layout."
+        NotSeekable,            // "The output must support seeking to convert large subtrees."
+        WriteFailed,            // "Error while writing the output."
+    } code;
+
+    std::string_view msg() const {
+        switch (code) {
+            case OK:                    return "OK";
+            case HeaderTooSmall:        return "Header of the binary not matching minimum size.";
+            case MagicMismatch:         return "Header of the binary not matching the format.";
+            case MajorVersionMismatch:  return "The binary was generated in a different major revision of the format.";
+            case MinorVersionTooHigh:   return "The binary was generated in a minor revision released after this build.";
+            case UnknownLayout:         return "The binary does not use any known layout.";
+            case TruncatedSpan:         return "Truncated span for the binary.";
+            case TreeOutOfBounds:       return "A tree of the binary is out of bounds.";
+            case Overflow:              return "A value does not fit the target layout.";
+            case NotSeekable:           return "The output must support seeking to convert large subtrees.";
+            case WriteFailed:           return "Error while writing the output.";
+            default:                    return "Unknown error.";
+        }
+    }
+};
+
+/**
+ * @brief Layout and byte order of a binary (tree or archive), regardless of the ones used by this build.
+ */
+[[nodiscard]] std::expected<binary_layout_t, convert_error_t> binary_layout(std::span<const uint8_t> region);
+
+/**
+ * @brief Rewrite a binary (tree or archive) for a different layout and/or byte order.
+ * @details Nodes are converted one at a time in pre-order, and written through a fixed size window.
+ *          Memory usage only depends on the depth of the trees, not on the size of the binary, so `region` is best a file mapped in memory.
+ *          Sizes of subtrees are only known once they are complete: those larger than the window are patched by seeking back on `out`,
+ *          which fails with NotSeekable if `out` does not support it (like pipes).
+ *          Parent and sibling links are rebuilt from the structure of the trees, and sections are written one after the other in the order of the header.
+ *          Extensions referring to nodes (indices, statistics, topology) depend on the layout and are dropped, `ARCHIVE_NAMES` is kept.
+ *          Narrowing to layout 1 fails with Overflow if any count or offset does not fit its smaller types, like strings longer than 65535 bytes.
+ * @return the number of bytes written.
+ */
+[[nodiscard]] std::expected<size_t, convert_error_t> convert_binary(std::span<const uint8_t> region, std::ostream& out, binary_layout_t target = binary_layout_t::native());
+
+}
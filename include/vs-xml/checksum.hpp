@@ -0,0 +1,68 @@
+#pragma once
+
+/**
+ * @file checksum.hpp
+ * @author karurochari
+ * @brief Checksums of the sections of a binary, to detect corruption of stored files without loading them.
+ * @date 2025-07-04
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#include <expected>
+#include <span>
+#include <string_view>
+
+#include <vs-xml/commons.hpp>
+
+namespace VS_XML_NS{
+
+struct Executor;
+
+/**
+ * @brief CRC32C (Castagnoli) of `data`, continuing from the checksum of the data preceding it (0 for none).
+ * @details Hardware instructions are used when available (SSE 4.2 on x86-64, detected at runtime, or the CRC extension on ARM).
+ */
+[[nodiscard]] uint32_t crc32c(std::span<const uint8_t> data, uint32_t crc = 0);
+
+struct checksum_error_t{
+    enum Code {
+        OK = 0,
+        Missing,        // "The binary has no checksums."
+        Malformed,      // "Header or checksums of the binary are malformed."
+        Header,         // "Checksum of the header not matching."
+        Symbols,        // "Checksum of the symbols not matching."
+        Document,       // "Checksum of a document not matching."
+    } code;
+    size_t doc = 0;     // first document not matching, for Document
+
+    std::string_view msg() const {
+        switch (code) {
+            case OK:        return "OK";
+            case Missing:   return "The binary has no checksums.";
+            case Malformed: return "Header or checksums of the binary are malformed.";
+            case Header:    return "Checksum of the header not matching.";
+            case Symbols:   return "Checksum of the symbols not matching.";
+            case Document:  return "Checksum of a document not matching.";
+            default:        return "Unknown error.";
+        }
+    }
+};
+
+/**
+ * @brief Check all checksums saved with a binary (tree or archive), as written by `save_binary` when requested.
+ * @details The payload of the `CHECKSUMS` extension is an array of CRC32C values (uint32 each): one for the header including its sections table,
+ *          one for the symbols, and one for each document. Extensions themselves are not covered.
+ *          Nothing is decoded: only the header is read to locate the sections.
+ * @param executor if provided, documents are checked in parallel.
+ */
+[[nodiscard]] std::expected<void, checksum_error_t> verify_checksums(std::span<const uint8_t> region, Executor* executor = nullptr);
+
+///Check the checksum of a single document, like before accessing it.
+[[nodiscard]] std::expected<void, checksum_error_t> verify_checksum(std::span<const uint8_t> region, size_t doc);
+
+}
@@ -18,6 +18,7 @@
 
 #include <endian.h>
 #include <expected>
+#include <optional>
 
 
 #include <span>
@@ -54,7 +55,7 @@
 namespace VS_XML_NS{
 
 constexpr static inline int format_major = 0; ///Current binary format major revision. Major revisions are breaking.
-constexpr static inline int format_minor = 0; ///Current binary format minor revision. Minor revisions are not breaking, but older does not support recent.
+constexpr static inline int format_minor = 1; ///Current binary format minor revision. Minor revisions are not breaking, but older does not support recent.
 
 #if VS_XML_LAYOUT == 0
 typedef std::ptrdiff_t delta_ptr_t ;
@@ -133,7 +134,7 @@ struct __attribute__ ((packed)) binary_header_t{
     uint32_t res1: 32-24;
 
     uint16_t docs_count = 1;
-    uint8_t res[2];
+    uint16_t extensions_count = 0;  //Entries of the extensions table (since 0.1), see extension_t.
 
     uint64_t length_of_symbols; //(excluding padding)
 
@@ -147,6 +148,19 @@ struct __attribute__ ((packed)) binary_header_t{
         xml_count_t     length;    //Relative to base
     } sections [];
 
+    /**
+     * @brief Entry of the extensions table, used to attach optional side sections (like indices) to a binary.
+     * @details The table is stored at the very end of the binary, payloads come before it, right after the data and aligned to 16 bytes.
+     *          Readers are free to ignore any extension.
+     */
+    struct __attribute__ ((packed)) extension_t{
+        uint16_t    kind;           //See extension_kind_t
+        uint16_t    flags;          //Specific for each kind
+        uint32_t    doc;            //Position of the document this extension refers to
+        uint64_t    base;           //Relative to the beginning of the binary
+        uint64_t    length;
+    };
+
     constexpr inline section_t region(size_t n) const{
         xml_assert(n<docs_count, "Exceeded maximum documents recorded in binary");
         return sections[n];
@@ -162,7 +176,62 @@ struct __attribute__ ((packed)) binary_header_t{
     }
 };
 static_assert(offsetof(binary_header_t,sections)%sizeof(uint64_t)==0,"Misaligned section_t in header");
+static_assert(sizeof(binary_header_t::extension_t)==24,"extension_t is expected to be 24 bytes");
+
+/**
+ * @brief Kinds of side sections which can be attached to a binary.
+ * @details Indices (from NAME_INDEX to TOPOLOGY) refer to the nodes of the document they are attached to by offset, so they are meaningless for any other tree.
+ *          Their `from_binary` checks them against that document and reads them in place, without copies.
+ */
+enum struct extension_kind_t : uint16_t{
+    NONE,
+    NAME_INDEX,         ///Posting lists of element names, see NameIndex.
+    ATTR_INDEX,         ///Posting lists of attribute values, see AttrIndex.
+    SUBTREE_STATS,      ///Summaries of large subtrees, see SubtreeStats.
+    TOPOLOGY,           ///Pre-order positions, subtree ends and depths, see Topology.
+    ARCHIVE_NAMES,      ///Positions of the documents of an archive sorted by name (uint32 each), see ArchiveRaw::find.
+    CHECKSUMS,          ///CRC32C of header, symbols and each document (uint32 each), see verify_checksums.
+};
+
+///Side section to be written by `save_binary`.
+struct binary_extension_t{
+    extension_kind_t            kind;
+    uint32_t                    doc = 0;
+    std::span<const uint8_t>    payload;
+    uint16_t                    flags = 0;
+};
 
+/**
+ * @brief Extensions table of a binary, or an empty span if not present or out of bounds.
+ * @details The header in `region` is assumed to have been validated already (like by `from_binary`).
+ */
+inline std::span<const binary_header_t::extension_t> binary_extensions(std::span<const uint8_t> region){
+    const binary_header_t& header = *(const binary_header_t*)region.data();
+    size_t length = sizeof(binary_header_t::extension_t)*header.extensions_count;
+    if(region.size_bytes()<header.start_data()+length)return {};
+    return {(const binary_header_t::extension_t*)(region.data()+region.size_bytes()-length),header.extensions_count};
+}
+
+/**
+ * @brief Payload of the first extension of a given kind for the document in position `doc`, if present.
+ */
+inline std::optional<std::span<const uint8_t>> binary_extension(std::span<const uint8_t> region, extension_kind_t kind, uint32_t doc = 0){
+    for(auto& entry : binary_extensions(region)){
+        if(entry.kind!=(uint16_t)kind || entry.doc!=doc)continue;
+        if(entry.base>region.size_bytes() || entry.length>region.size_bytes()-entry.base)return {};
+        return region.subspan(entry.base,entry.length);
+    }
+    return {};
+}
+
+///Stable 64bit hash (FNV-1a), the same across processes and standard libraries. Used for keys which are stored or shared.
+constexpr inline uint64_t fnv1a(std::string_view s, uint64_t h = 0xcbf29ce484222325ull){
+    for(auto c: s){
+        h^=(uint8_t)c;
+        h*=0x100000001b3ull;
+    }
+    return h;
+}
 
 struct element_t;
 struct attr_t;
@@ -41,12 +41,7 @@ struct DocumentBuilder : TreeBuilder<cfg>{
     [[nodiscard]] inline std::expected<stored::Document,details::BuilderBase::error_t> close(){
         this->end();
         details::BuilderBase::close();
-        if constexpr (
-            cfg.symbols==builder_config_t::symbols_t::COMPRESS_ALL ||
-            cfg.symbols==builder_config_t::symbols_t::COMPRESS_LABELS ||
-            cfg.symbols==builder_config_t::symbols_t::OWNED 
-        )return stored::Document(configs,std::exchange(this->buffer,{}),std::exchange(this->symbols.symbols,{}));
-        else return stored::Document(configs,std::exchange(this->buffer,{}),this->symbols.symbols.data());
+        return this->template take<stored::Document>();
     }
 
     [[nodiscard]] std::expected<binary_header_t::section_t,details::BuilderBase::error_t> close_frame(std::string_view name=""){
@@ -56,6 +51,11 @@ struct DocumentBuilder : TreeBuilder<cfg>{
         return tmp;
     }
     
+    inline void discard_frame(){
+        TreeBuilder<configs>::discard_frame();
+        this->begin("ROOT");
+    }
+
     [[nodiscard]] std::optional<std::pair<std::vector<uint8_t>,std::vector<uint8_t>>> extract(){
         this->end();
         details::BuilderBase::close();
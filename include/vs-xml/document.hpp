@@ -110,26 +110,40 @@ template<>
 struct StorageFor<DocumentRaw>{
     std::vector<uint8_t> buffer_i;
     std::vector<uint8_t> symbols_i;
+    SparseArena arena_i;    //Used instead of buffer_i by trees built in a sparse arena.
 
-    StorageFor(const builder_config_t& cfg, std::vector<uint8_t>&& buf, std::vector<uint8_t>&& sym):buffer_i(buf),symbols_i(sym){}
-    StorageFor(const builder_config_t& cfg, std::vector<uint8_t>&& buf, const void* label_offset=nullptr):buffer_i(buf){}
+    StorageFor(const builder_config_t& cfg, std::vector<uint8_t>&& buf, std::vector<uint8_t>&& sym):buffer_i(std::move(buf)),symbols_i(std::move(sym)){}
+    StorageFor(const builder_config_t& cfg, std::vector<uint8_t>&& buf, const void* label_offset=nullptr):buffer_i(std::move(buf)){}
 
     static TreeRaw bind(const StorageFor& storage, const builder_config_t& cfg, std::vector<uint8_t>&& src, std::vector<uint8_t>&& sym)  {return DocumentRaw(cfg,storage.buffer_i,storage.symbols_i);}
     static TreeRaw bind(const StorageFor& storage, const builder_config_t& cfg, std::vector<uint8_t>&& src, const void* label_offset=nullptr)  {return DocumentRaw(cfg,storage.buffer_i, {(uint8_t*)label_offset,std::span<uint8_t>::extent});}
 
+    StorageFor(const builder_config_t& cfg, SparseArena&& buf, std::vector<uint8_t>&& sym):symbols_i(std::move(sym)),arena_i(std::move(buf)){}
+    StorageFor(const builder_config_t& cfg, SparseArena&& buf, const void* label_offset=nullptr):arena_i(std::move(buf)){}
+
+    static TreeRaw bind(const StorageFor& storage, const builder_config_t& cfg, SparseArena&& src, std::vector<uint8_t>&& sym)  {return DocumentRaw(cfg,storage.arena_i.bytes(),storage.symbols_i);}
+    static TreeRaw bind(const StorageFor& storage, const builder_config_t& cfg, SparseArena&& src, const void* label_offset=nullptr)  {return DocumentRaw(cfg,storage.arena_i.bytes(), {(uint8_t*)label_offset,std::span<uint8_t>::extent});}
+
 };
 
 template<>
 struct StorageFor<Document>{
     std::vector<uint8_t> buffer_i;
     std::vector<uint8_t> symbols_i;
+    SparseArena arena_i;    //Used instead of buffer_i by trees built in a sparse arena.
 
-    StorageFor(const builder_config_t& cfg, std::vector<uint8_t>&& buf, std::vector<uint8_t>&& sym):buffer_i(buf),symbols_i(sym){}
-    StorageFor(const builder_config_t& cfg, std::vector<uint8_t>&& buf, const void* label_offset=nullptr):buffer_i(buf){}
+    StorageFor(const builder_config_t& cfg, std::vector<uint8_t>&& buf, std::vector<uint8_t>&& sym):buffer_i(std::move(buf)),symbols_i(std::move(sym)){}
+    StorageFor(const builder_config_t& cfg, std::vector<uint8_t>&& buf, const void* label_offset=nullptr):buffer_i(std::move(buf)){}
 
     static Tree bind(const StorageFor& storage, const builder_config_t& cfg, std::vector<uint8_t>&& src, std::vector<uint8_t>&& sym)  {return Document(DocumentRaw(cfg,storage.buffer_i,storage.symbols_i));}
     static Tree bind(const StorageFor& storage, const builder_config_t& cfg, std::vector<uint8_t>&& src, const void* label_offset=nullptr)  {return Document(DocumentRaw(cfg,storage.buffer_i, {(uint8_t*)label_offset,std::span<uint8_t>::extent}));}
 
+    StorageFor(const builder_config_t& cfg, SparseArena&& buf, std::vector<uint8_t>&& sym):symbols_i(std::move(sym)),arena_i(std::move(buf)){}
+    StorageFor(const builder_config_t& cfg, SparseArena&& buf, const void* label_offset=nullptr):arena_i(std::move(buf)){}
+
+    static Tree bind(const StorageFor& storage, const builder_config_t& cfg, SparseArena&& src, std::vector<uint8_t>&& sym)  {return Document(DocumentRaw(cfg,storage.arena_i.bytes(),storage.symbols_i));}
+    static Tree bind(const StorageFor& storage, const builder_config_t& cfg, SparseArena&& src, const void* label_offset=nullptr)  {return Document(DocumentRaw(cfg,storage.arena_i.bytes(), {(uint8_t*)label_offset,std::span<uint8_t>::extent}));}
+
 };
 
 namespace stored{
@@ -0,0 +1,90 @@
+#pragma once
+
+/**
+ * @file executor.hpp
+ * @author karurochari
+ * @brief Thread pool with work stealing, used to parallelize operations on archives and trees.
+ * @date 2025-06-25
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <vs-xml/commons.hpp>
+
+namespace VS_XML_NS{
+
+/**
+ * @brief Pool of workers, each one with its own queue of tasks. Idle workers steal tasks from the others.
+ * @details Tasks are grouped, and the thread waiting on a group helps running tasks until the group is completed.
+ *          Tasks spawned from within a worker are pushed on its own queue, so nested parallelism is handled without blocking.
+ */
+struct Executor{
+    ///A set of tasks which can be waited for.
+    struct group_t{
+        std::atomic<size_t> pending = 0;
+    };
+
+    typedef void(*fn_t)(void* ctx, size_t begin, size_t end);
+
+    /**
+     * @brief Construct a new executor.
+     * @param threads number of background workers. The thread waiting on a group acts as an extra one.
+     *        If 0, one less than the hardware concurrency is used.
+     */
+    explicit Executor(size_t threads = 0);
+    ~Executor();
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    ///Number of threads running tasks, including the waiting one.
+    [[nodiscard]] inline size_t concurrency() const{return workers.size()+1;}
+
+    ///Schedule fn(ctx, begin, end) as part of group.
+    void spawn(group_t& group, fn_t fn, void* ctx, size_t begin = 0, size_t end = 0);
+
+    ///Run tasks until all those in group are completed.
+    void wait(group_t& group);
+
+    /**
+     * @brief Call fn(ctx, begin, end) over subranges of [0, n) no longer than grain, and wait for all of them.
+     * @details Ranges are split recursively, so that stolen tasks are always large ones.
+     */
+    void parallel_for(size_t n, fn_t fn, void* ctx, size_t grain = 1);
+
+    private:
+        struct task_t{
+            fn_t        fn;
+            void*       ctx;
+            size_t      begin;
+            size_t      end;
+            group_t*    group;
+        };
+
+        struct queue_t{
+            std::mutex          lock;
+            std::deque<task_t>  tasks;
+        };
+
+        std::vector<std::thread>    workers;
+        std::vector<queue_t>        queues;     //One for each worker, plus a shared one for external threads.
+        std::atomic<size_t>         queued = 0;
+        std::atomic<bool>           stop = false;
+        std::mutex                  idle_lock;
+        std::condition_variable     idle;
+
+        bool try_run(size_t self);
+        void loop(size_t self);
+        size_t self() const;
+};
+
+}
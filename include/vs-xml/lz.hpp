@@ -0,0 +1,48 @@
+#pragma once
+
+/**
+ * @file lz.hpp
+ * @author karurochari
+ * @brief Small LZ77 codec for blocks of binaries, with no external dependency.
+ * @date 2025-07-03
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#include <span>
+
+#include <vs-xml/commons.hpp>
+
+namespace VS_XML_NS{
+
+/**
+ * @brief Byte-oriented LZ77 codec, with the same sequence layout as LZ4 blocks.
+ * @details Each sequence is a token (literals length in the high nibble, match length minus 4 in the low one, 15 meaning that more length bytes follow),
+ *          the literals, and a match given as a 16-bit little-endian distance. The last sequence only has literals.
+ *          Blocks are meant to be small (up to a few hundreds KiB), and are decoded independently from each other.
+ */
+namespace lz{
+
+///Largest size of the compressed output for `length` bytes of input.
+constexpr inline size_t bound(size_t length){return length+length/255+16;}
+
+/**
+ * @brief Compress `src` into `dst`.
+ * @return the size of the compressed output, or 0 if it does not fit in `dst` (always fitting if at least `bound(src.size())` bytes).
+ */
+[[nodiscard]] size_t compress(std::span<const uint8_t> src, std::span<uint8_t> dst);
+
+/**
+ * @brief Decompress `src` into `dst`, whose size must be the one of the original input.
+ * @details Malformed input is detected rather than trusted: it is never read nor written out of bounds.
+ * @return true if the whole input was decoded to exactly `dst.size()` bytes.
+ */
+[[nodiscard]] bool decompress(std::span<const uint8_t> src, std::span<uint8_t> dst);
+
+}
+
+}
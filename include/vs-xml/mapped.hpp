@@ -0,0 +1,167 @@
+#pragma once
+
+/**
+ * @file mapped.hpp
+ * @author karurochari
+ * @brief Documents and archives loaded from files mapped read-only in memory, with hints to the kernel on how they are accessed.
+ * @date 2025-07-05
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <expected>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include <vs-xml/archive.hpp>
+#include <vs-xml/commons.hpp>
+#include <vs-xml/document.hpp>
+
+namespace VS_XML_NS{
+
+struct Executor;
+
+struct mapped_error_t{
+    enum Code {
+        OK = 0,
+        OpenFailed,     // "The file could not be opened."
+        MapFailed,      // "The file could not be mapped in memory."
+        NotSupported,   // "Memory mapping is not supported on this platform."
+        Binary,         // "The file is not a valid binary, see `binary`."
+        CreateFailed,   // "The shared memory object could not be created, or it already exists."
+        WriteFailed,    // "Error while writing the shared memory object."
+    } code;
+    TreeRaw::from_binary_error_t binary = {TreeRaw::from_binary_error_t::OK};
+
+    std::string_view msg() const {
+        switch (code) {
+            case OK:            return "OK";
+            case OpenFailed:    return "The file could not be opened.";
+            case MapFailed:     return "The file could not be mapped in memory.";
+            case NotSupported:  return "Memory mapping is not supported on this platform.";
+            case Binary:        {auto tmp = binary; return tmp.msg();}
+            case CreateFailed:  return "The shared memory object could not be created, or it already exists.";
+            case WriteFailed:   return "Error while writing the shared memory object.";
+            default:            return "Unknown error.";
+        }
+    }
+};
+
+///Expected access pattern to the content of a mapped file, which drives the read-ahead of the kernel.
+enum struct access_t{
+    NORMAL,         ///Default read-ahead.
+    RANDOM,         ///Few pages around each access, like query servers picking documents from large archives.
+    SEQUENTIAL,     ///Aggressive read-ahead, like full scans.
+};
+
+/**
+ * @brief Read-only mapping of a whole file, unmapped when destroyed.
+ * @details Pages are mapped without write permissions, so content cannot be changed through the spans handed out by documents.
+ *          Only available on POSIX systems, `open` fails with NotSupported elsewhere.
+ */
+struct MappedRegion{
+    [[nodiscard]] static std::expected<MappedRegion, mapped_error_t> open(const std::filesystem::path& path, access_t access = access_t::NORMAL);
+
+    ///Map the whole content of an open file descriptor, like a shared memory object. The descriptor can be closed afterwards.
+    [[nodiscard]] static std::expected<MappedRegion, mapped_error_t> open(int fd, access_t access = access_t::NORMAL);
+
+    MappedRegion(MappedRegion&& other) noexcept;
+    MappedRegion& operator=(MappedRegion&& other) noexcept;
+    MappedRegion(const MappedRegion&) = delete;
+    MappedRegion& operator=(const MappedRegion&) = delete;
+    ~MappedRegion();
+
+    [[nodiscard]] inline std::span<const uint8_t> bytes() const{return {data,length};}
+
+    ///Hint the kernel to read a range of the mapping in advance. Ranges outside the mapping are clamped.
+    void prefetch(size_t offset, size_t size) const;
+
+    ///Change the expected access pattern for a range of the mapping.
+    void advise(size_t offset, size_t size, access_t access) const;
+
+    private:
+        const uint8_t*  data = nullptr;
+        size_t          length = 0;
+
+        MappedRegion() = default;
+};
+
+/**
+ * @brief Document loaded from a file mapped read-only in memory.
+ * @details Header and symbols are prefetched when opening, nodes are read in on first access.
+ */
+struct MappedDocument{
+    /**
+     * @brief Map a file holding the binary of a single document.
+     * @param access expected access pattern, sequential by default as most operations on a document visit it in full.
+     */
+    [[nodiscard]] static std::expected<MappedDocument, mapped_error_t> open(const std::filesystem::path& path, access_t access = access_t::SEQUENTIAL);
+
+    [[nodiscard]] inline const Document& document() const{return doc;}
+
+    [[nodiscard]] inline std::span<const uint8_t> region() const{return map.bytes();}
+
+    private:
+        MappedRegion    map;
+        Document        doc;
+
+        MappedDocument(MappedRegion&& map, Document&& doc):map(std::move(map)),doc(std::move(doc)){}
+};
+
+/**
+ * @brief Archive loaded from a file mapped read-only in memory, without copying it.
+ * @details Header, symbols and the extensions table are prefetched when opening, as they are needed to locate any document.
+ *          The byte range of a document is prefetched the first time it is returned by `get`, so that pages are read in bulk
+ *          instead of faulting one at a time while visiting it. `prefetch` does the same ahead of time, like for documents about to be queried.
+ *          It is safe to use from multiple threads.
+ */
+struct MappedArchive{
+    /**
+     * @brief Map a file holding the binary of an archive.
+     * @param access expected access pattern, random by default as archives are mostly used to pick a few documents.
+     * @param verify see ArchiveRaw::from_binary. Verifying eagerly reads the whole file.
+     */
+    [[nodiscard]] static std::expected<MappedArchive, mapped_error_t> open(const std::filesystem::path& path, access_t access = access_t::RANDOM, ArchiveRaw::verify_t verify = ArchiveRaw::verify_t::NONE, Executor* executor = nullptr);
+
+    ///Load an archive from a region already mapped, which is then owned by the archive.
+    [[nodiscard]] static std::expected<MappedArchive, mapped_error_t> open(MappedRegion&& map, ArchiveRaw::verify_t verify = ArchiveRaw::verify_t::NONE, Executor* executor = nullptr);
+
+    [[nodiscard]] inline const Archive& archive() const{return arch;}
+
+    [[nodiscard]] inline std::span<const uint8_t> region() const{return map.bytes();}
+
+    ///The number of items present in this archive
+    [[nodiscard]] inline size_t items() const{return arch.items();}
+
+    ///Position of the first document with a given name, if any.
+    [[nodiscard]] inline std::optional<size_t> find(std::string_view name) const{return arch.find(name);}
+
+    ///Get the document in position idx if available, prefetching its content on first access.
+    [[nodiscard]] std::optional<const Document> get(size_t idx) const;
+
+    ///Get the document with a given name if it exists, prefetching its content on first access.
+    [[nodiscard]] inline std::optional<const Document> get(std::string_view name) const{
+        if(auto idx = find(name); idx.has_value())return get(*idx);
+        return {};
+    }
+
+    ///Hint the kernel to read the content of the document in position idx in advance.
+    void prefetch(size_t idx) const;
+
+    private:
+        MappedRegion                            map;
+        Archive                                 arch;
+        std::unique_ptr<std::atomic<bool>[]>    prefetched;     //Documents already prefetched by `get`.
+
+        MappedArchive(MappedRegion&& map, Archive&& arch):map(std::move(map)),arch(std::move(arch)),prefetched(new std::atomic<bool>[this->arch.items()]{}){}
+};
+
+}
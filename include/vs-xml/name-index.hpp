@@ -0,0 +1,150 @@
+#pragma once
+
+/**
+ * @file name-index.hpp
+ * @author karurochari
+ * @brief Posting lists of element names, to reach descendants with a given name without visiting the whole subtree.
+ * @date 2025-06-25
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <expected>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <vs-xml/commons.hpp>
+#include <vs-xml/postings.hpp>
+#include <vs-xml/tree.hpp>
+
+namespace VS_XML_NS{
+
+/**
+ * @brief Index from element labels (namespace and name) to the sorted list of elements using them.
+ * @details Elements are recorded as offsets from the beginning of the tree buffer, and since nodes are laid out in pre-order,
+ *          all the descendants of a node with a given label are found as a contiguous slice of its posting list.
+ *          Stored next to its tree as a NAME_INDEX extension, see extension_kind_t.
+ */
+struct NameIndex{
+    struct header_t{
+        uint8_t  magic[4] = {'$','X','N','I'};
+        uint8_t  width = 4;             //Size in bytes of each entry in the posting lists, either 4 or 8.
+        uint8_t  res[3] = {};
+        uint32_t labels = 0;
+        uint32_t res1 = 0;
+        uint64_t postings = 0;
+    };
+    static_assert(sizeof(header_t)==24, "header_t is expected to be 24 bytes");
+
+    ///Entry of the label table. Labels are sorted by name first, and then by namespace.
+    struct label_t{
+        int64_t  ns_base;               //Relative to the symbols of the tree.
+        int64_t  name_base;             //Relative to the symbols of the tree.
+        uint32_t ns_length;
+        uint32_t name_length;
+        uint64_t first;                 //Position of the first posting for this label.
+        uint64_t count;                 //Number of postings for this label.
+    };
+    static_assert(sizeof(label_t)==40, "label_t is expected to be 40 bytes");
+
+    enum struct from_binary_error_t{
+        OK,
+        Missing,
+        HeaderTooSmall,
+        MagicMismatch,
+        TruncatedSpan,
+        OutOfBounds,
+    };
+
+    ///Build the index for a tree with a single visit.
+    [[nodiscard]] static NameIndex build(const TreeRaw& tree);
+
+    /**
+     * @brief Load the index attached to a binary as extension, for the document in position `doc`.
+     * @details Data is not copied, so `region` must outlive the index.
+     */
+    [[nodiscard]] static std::expected<NameIndex,from_binary_error_t> from_binary(std::span<const uint8_t> region, uint32_t doc = 0);
+
+    ///The binary representation of this index.
+    [[nodiscard]] inline std::span<const uint8_t> bytes() const{return data;}
+
+    ///Side section to pass to `save_binary` for this index to be stored along with its tree.
+    [[nodiscard]] inline binary_extension_t extension(uint32_t doc = 0) const{return {extension_kind_t::NAME_INDEX,doc,data};}
+
+    [[nodiscard]] inline const header_t& header() const{return *(const header_t*)data.data();}
+
+    ///All labels, sorted by name and then by namespace.
+    [[nodiscard]] inline std::span<const label_t> labels() const{
+        return {(const label_t*)(data.data()+sizeof(header_t)),header().labels};
+    }
+
+    ///All posting lists, back to back.
+    [[nodiscard]] inline postings_t postings() const{
+        return {data.data()+sizeof(header_t)+sizeof(label_t)*header().labels,header().width};
+    }
+
+    /**
+     * @brief Positions in `labels()` of all the labels with a given name, for any namespace.
+     */
+    [[nodiscard]] std::pair<size_t,size_t> find(const TreeRaw& tree, std::string_view name) const;
+
+    ///Position in `labels()` of the label with a given namespace and name, if present.
+    [[nodiscard]] std::optional<size_t> find(const TreeRaw& tree, std::string_view ns, std::string_view name) const;
+
+    /**
+     * @brief Visit in document order all elements in [first,last) using any of the selected labels.
+     *
+     * @param tree the tree this index was built for.
+     * @param selected positions in `labels()`, like those returned by `find`.
+     * @param first first node of the range, usually the first child of some element.
+     * @param last end of the range, usually the end of that element.
+     * @param fn called for each element, return false to stop.
+     * @return false if stopped by `fn`, true otherwise.
+     */
+    template<typename Fn>
+    bool visit(const TreeRaw& tree, std::span<const uint32_t> selected, const unknown_t* first, const unknown_t* last, Fn&& fn) const{
+        auto l = labels();
+        return postings().visit(tree,selected.size(),[&](size_t j){return std::pair<size_t,size_t>{l[selected[j]].first,l[selected[j]].count};},first,last,std::forward<Fn>(fn));
+    }
+
+    /**
+     * @brief Visit in document order all the elements below `node` with a given name (and namespace if specified).
+     */
+    template<typename Fn>
+    bool descendants(const TreeRaw& tree, const unknown_t* node, std::string_view name, std::optional<std::string_view> ns, Fn&& fn) const{
+        if(node->type()!=type_t::ELEMENT)return true;
+        std::vector<uint32_t> selected;
+        if(ns.has_value()){
+            if(auto l = find(tree,*ns,name); l.has_value())selected.push_back(*l);
+        }
+        else{
+            auto [a,b] = find(tree,name);
+            for(;a<b;a++)selected.push_back(a);
+        }
+        if(selected.size()==0)return true;
+        auto [first,last] = *node->children_range();
+        return visit(tree,selected,first,last,std::forward<Fn>(fn));
+    }
+
+    NameIndex(NameIndex&&) = default;
+    NameIndex& operator=(NameIndex&&) = default;
+    NameIndex(const NameIndex&) = delete;
+    NameIndex& operator=(const NameIndex&) = delete;
+
+    private:
+        std::vector<uint8_t>        owned;      //Empty when `data` points into a binary.
+        std::span<const uint8_t>    data;
+
+        inline NameIndex(std::vector<uint8_t>&& src):owned(std::move(src)),data(owned){}
+        inline NameIndex(std::span<const uint8_t> src):data(src){}
+};
+
+}
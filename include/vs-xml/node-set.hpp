@@ -0,0 +1,179 @@
+#pragma once
+
+/**
+ * @file node-set.hpp
+ * @author karurochari
+ * @brief Materialized query results, as sorted vectors of node offsets supporting set operations.
+ * @date 2025-06-29
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <limits>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include <vs-xml/commons.hpp>
+#include <vs-xml/node.hpp>
+#include <vs-xml/query.hpp>
+#include <vs-xml/tree.hpp>
+#include <vs-xml/wrp-node.hpp>
+
+namespace VS_XML_NS{
+namespace query{
+
+namespace details{
+    ///Sorted union of two sorted sets, appended to `dst`.
+    template<typename T>
+    void set_union(std::span<const T> a, std::span<const T> b, std::vector<T>& dst);
+
+    ///Sorted intersection of two sorted sets, appended to `dst`.
+    template<typename T>
+    void set_intersection(std::span<const T> a, std::span<const T> b, std::vector<T>& dst);
+
+    ///Elements of `a` not in `b`, both sorted, appended to `dst`.
+    template<typename T>
+    void set_difference(std::span<const T> a, std::span<const T> b, std::vector<T>& dst);
+
+    extern template void set_union<uint32_t>(std::span<const uint32_t>, std::span<const uint32_t>, std::vector<uint32_t>&);
+    extern template void set_union<uint64_t>(std::span<const uint64_t>, std::span<const uint64_t>, std::vector<uint64_t>&);
+    extern template void set_intersection<uint32_t>(std::span<const uint32_t>, std::span<const uint32_t>, std::vector<uint32_t>&);
+    extern template void set_intersection<uint64_t>(std::span<const uint64_t>, std::span<const uint64_t>, std::vector<uint64_t>&);
+    extern template void set_difference<uint32_t>(std::span<const uint32_t>, std::span<const uint32_t>, std::vector<uint32_t>&);
+    extern template void set_difference<uint64_t>(std::span<const uint64_t>, std::span<const uint64_t>, std::vector<uint64_t>&);
+}
+
+/**
+ * @brief Set of nodes of a tree, stored as offsets from the beginning of its buffer (like `wrp::base_t::addr`).
+ * @details Nodes are laid out in pre-order, so sorting offsets sorts nodes in document order.
+ *          Set operations expect both operands to be sorted (see `sort`), and return sorted sets.
+ *          Offsets are only meaningful for the tree they were taken from, which must be passed back to get nodes.
+ * @tparam T either uint32_t, for trees up to 4GB, or uint64_t.
+ */
+template<typename T>
+struct node_set_t{
+    static_assert(std::is_same_v<T,uint32_t> || std::is_same_v<T,uint64_t>, "Offsets must be either 32 or 64 bits");
+    using value_type = T;
+
+    node_set_t() = default;
+
+    ///From offsets, which are not required to be sorted.
+    inline explicit node_set_t(std::vector<T>&& offsets):items(std::move(offsets)){}
+
+    ///Collect the results of a query, sorted in document order since nested steps are not yielded in that order.
+    static inline node_set_t collect(result_t&& src){
+        node_set_t ret;
+        for(auto node : src)ret.push_back(node);
+        ret.sort();
+        return ret;
+    }
+
+    ///Collect the matches of a frame of a query with the new interpreter, sorted in document order and without duplicates.
+    static inline node_set_t collect(const Query& query, const TreeRaw& tree, const unknown_t* root=nullptr, size_t frame=0){
+        collector_t ctx{tree,{}};
+        run(query,tree,root,sink,&ctx,frame);
+        //Overlapping steps (like nested descendants) reach the same node more than once, and not in document order.
+        ctx.set.sort();
+        return std::move(ctx.set);
+    }
+
+    ///Collect the matches of a frame of a compiled plan, sorted in document order and without duplicates.
+    static inline node_set_t collect(const plan_t& plan, const TreeRaw& tree, const unknown_t* root=nullptr, size_t frame=0){
+        collector_t ctx{tree,{}};
+        run(plan,tree,root,sink,&ctx,frame);
+        ctx.set.sort();
+        return std::move(ctx.set);
+    }
+
+    inline void push_back(const TreeRaw& tree, const unknown_t* node){
+        uint64_t offset = (const uint8_t*)node-(const uint8_t*)&tree.root();
+        xml_assert(offset<=std::numeric_limits<T>::max(), "Offset too large for this node set");
+        items.push_back((T)offset);
+    }
+
+    inline void push_back(wrp::base_t<unknown_t> node){push_back(node.tree(),(const unknown_t*)node);}
+
+    [[nodiscard]] inline size_t size() const{return items.size();}
+    [[nodiscard]] inline bool empty() const{return items.empty();}
+    [[nodiscard]] inline T operator[](size_t i) const{return items[i];}
+    [[nodiscard]] inline auto begin() const{return items.begin();}
+    [[nodiscard]] inline auto end() const{return items.end();}
+    [[nodiscard]] inline std::span<const T> offsets() const{return items;}
+
+    inline void reserve(size_t n){items.reserve(n);}
+    inline void clear(){items.clear();}
+
+    ///Sort in document order, removing duplicates.
+    inline void sort(){
+        if(sorted())return;
+        std::sort(items.begin(),items.end());
+        items.erase(std::unique(items.begin(),items.end()),items.end());
+    }
+
+    ///True if sorted in document order and without duplicates.
+    [[nodiscard]] inline bool sorted() const{
+        return std::adjacent_find(items.begin(),items.end(),[](T a, T b){return a>=b;})==items.end();
+    }
+
+    ///Node in position `i`, for the tree the offsets were taken from.
+    [[nodiscard]] inline const unknown_t* node(const TreeRaw& tree, size_t i) const{
+        return (const unknown_t*)((const uint8_t*)&tree.root()+items[i]);
+    }
+
+    ///Wrapper of the node in position `i`, for the tree the offsets were taken from.
+    [[nodiscard]] inline wrp::base_t<unknown_t> at(const TreeRaw& tree, size_t i) const{return {tree,node(tree,i)};}
+
+    ///Generate wrappers for all nodes in order, like the results of a query. The set must outlive the generator.
+    [[nodiscard]] result_t wrap(const TreeRaw& tree) const{
+        for(size_t i=0;i<items.size();i++)co_yield at(tree,i);
+    }
+
+    friend inline node_set_t operator|(const node_set_t& a, const node_set_t& b){
+        xml_assert(a.sorted() && b.sorted(), "Operands of set operations must be sorted");
+        node_set_t ret;
+        details::set_union<T>(a.items,b.items,ret.items);
+        return ret;
+    }
+
+    friend inline node_set_t operator&(const node_set_t& a, const node_set_t& b){
+        xml_assert(a.sorted() && b.sorted(), "Operands of set operations must be sorted");
+        node_set_t ret;
+        details::set_intersection<T>(a.items,b.items,ret.items);
+        return ret;
+    }
+
+    friend inline node_set_t operator-(const node_set_t& a, const node_set_t& b){
+        xml_assert(a.sorted() && b.sorted(), "Operands of set operations must be sorted");
+        node_set_t ret;
+        details::set_difference<T>(a.items,b.items,ret.items);
+        return ret;
+    }
+
+    friend inline bool operator==(const node_set_t&, const node_set_t&) = default;
+
+    private:
+        std::vector<T> items;
+
+        struct collector_t{
+            const TreeRaw&  tree;
+            node_set_t      set;
+        };
+
+        static inline bool sink(const unknown_t* node, void* ctx){
+            auto& c = *(collector_t*)ctx;
+            c.set.push_back(c.tree,node);
+            return true;
+        }
+};
+
+using node_set32_t = node_set_t<uint32_t>;
+using node_set64_t = node_set_t<uint64_t>;
+
+}
+}
@@ -89,6 +89,8 @@ struct attr_t{
     inline std::expected<sv,feature_t> ns() const {return _ns;}
     inline std::expected<sv,feature_t> name() const {return _name;}
     inline std::expected<sv,feature_t> value() const {return _value;}
+
+    friend struct details::BuilderBase;
 };
 
 struct element_t : base_t<element_t>{
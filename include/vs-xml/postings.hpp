@@ -0,0 +1,183 @@
+#pragma once
+
+/**
+ * @file postings.hpp
+ * @author karurochari
+ * @brief Posting lists of node offsets and label tables, shared by the indices of a tree.
+ * @date 2025-06-26
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <vs-xml/commons.hpp>
+#include <vs-xml/node.hpp>
+#include <vs-xml/tree.hpp>
+
+namespace VS_XML_NS{
+
+/**
+ * @brief Packed array of offsets from the beginning of a tree buffer, each `width` (4 or 8) bytes long.
+ * @details Indices store several sorted lists back to back in a single array, each one identified by its first position and length.
+ */
+struct postings_t{
+    const uint8_t*  data = nullptr;
+    uint8_t         width = 4;
+
+    ///Width needed for offsets within a tree.
+    [[nodiscard]] static inline uint8_t width_for(const TreeRaw& tree){
+        return (uint64_t)((const uint8_t*)tree.root().next()-(const uint8_t*)&tree.root())<=UINT32_MAX?4:8;
+    }
+
+    [[nodiscard]] inline uint64_t operator[](size_t i) const{
+        if(width==4){uint32_t v;std::memcpy(&v,data+i*4,4);return v;}
+        else{uint64_t v;std::memcpy(&v,data+i*8,8);return v;}
+    }
+
+    ///Store `value` in position `i` of a writable array. Builders append offsets in document order, which keeps each list sorted.
+    static inline void store(uint8_t* dst, uint8_t width, size_t i, uint64_t value){
+        if(width==4){uint32_t v=value;std::memcpy(dst+i*4,&v,4);}
+        else std::memcpy(dst+i*8,&value,8);
+    }
+
+    ///True if the list of `count` offsets at `first` is strictly increasing and below `limit`, as lookups bisecting on it assume.
+    [[nodiscard]] inline bool valid(size_t first, size_t count, uint64_t limit) const{
+        for(size_t i=first;i<first+count;i++){
+            auto v = (*this)[i];
+            if(v>=limit || (i!=first && v<=(*this)[i-1]))return false;
+        }
+        return true;
+    }
+
+    ///First position in [lo,hi) whose offset is not less than `v`.
+    [[nodiscard]] inline size_t lower_bound(size_t lo, size_t hi, uint64_t v) const{
+        while(lo<hi){
+            size_t mid = lo+(hi-lo)/2;
+            if((*this)[mid]<v)lo=mid+1;
+            else hi=mid;
+        }
+        return lo;
+    }
+
+    /**
+     * @brief Visit in document order the nodes in [first,last) recorded in any of `count` sorted lists.
+     *
+     * @param tree the tree the offsets refer to.
+     * @param count number of lists.
+     * @param list returns first position and length of the list in position `j`.
+     * @param first first node of the range.
+     * @param last end of the range.
+     * @param fn called for each node, return false to stop.
+     * @return false if stopped by `fn`, true otherwise.
+     */
+    template<typename List, typename Fn>
+    bool visit(const TreeRaw& tree, size_t count, List&& list, const unknown_t* first, const unknown_t* last, Fn&& fn) const{
+        const uint8_t* base = (const uint8_t*)&tree.root();
+        uint64_t from = (const uint8_t*)first-base, to = (const uint8_t*)last-base;
+        auto node = [&](uint64_t offset){return (const unknown_t*)(base+offset);};
+
+        //Slice of a list which falls within [from,to).
+        auto slice = [&](size_t j){
+            auto [start,length] = list(j);
+            return std::pair<size_t,size_t>{lower_bound(start,start+length,from),lower_bound(start,start+length,to)};
+        };
+
+        if(count==1){
+            auto [i,end] = slice(0);
+            for(;i<end;i++){
+                if(!fn(node((*this)[i])))return false;
+            }
+            return true;
+        }
+
+        //Several lists, merged to preserve the document order. Nodes found in more than one list are only visited once.
+        std::vector<std::pair<size_t,size_t>> cursors;
+        cursors.reserve(count);
+        for(size_t j=0;j<count;j++){
+            auto s = slice(j);
+            if(s.first<s.second)cursors.push_back(s);
+        }
+        uint64_t previous = UINT64_MAX;
+        while(cursors.size()!=0){
+            size_t best = 0;
+            for(size_t j=1;j<cursors.size();j++){
+                if((*this)[cursors[j].first]<(*this)[cursors[best].first])best=j;
+            }
+            auto offset = (*this)[cursors[best].first];
+            if(offset!=previous && !fn(node(offset)))return false;
+            previous = offset;
+            if(++cursors[best].first==cursors[best].second)cursors.erase(cursors.begin()+best);
+        }
+        return true;
+    }
+};
+
+namespace details{
+
+///Namespace and name of a label, used as key while assigning ids to labels.
+struct label_key_t{
+    std::string_view ns;
+    std::string_view name;
+
+    friend inline bool operator==(const label_key_t&, const label_key_t&) = default;
+};
+
+struct label_hash_t{
+    inline size_t operator()(const label_key_t& k) const{
+        return std::hash<std::string_view>{}(k.name)*31+std::hash<std::string_view>{}(k.ns);
+    }
+};
+
+///True if a string with `base` and `length` fits in a symbols table of `size` bytes. As in the verifier of trees, empty strings can have any base.
+inline bool in_symbols(int64_t base, uint64_t length, uint64_t size){
+    return length==0 || (base>=0 && (uint64_t)base<=size && length<=size-(uint64_t)base);
+}
+
+//Entries of label tables have `ns_base`, `ns_length`, `name_base` and `name_length` relative to the symbols of the tree.
+
+template<typename L>
+inline std::string_view label_ns(const TreeRaw& tree, const L& l){return tree.rsv(sv((std::ptrdiff_t)l.ns_base,(size_t)l.ns_length));}
+
+template<typename L>
+inline std::string_view label_name(const TreeRaw& tree, const L& l){return tree.rsv(sv((std::ptrdiff_t)l.name_base,(size_t)l.name_length));}
+
+///Order of label tables, by name first and then by namespace so that lookups can bisect.
+template<typename L>
+inline bool label_less(const TreeRaw& tree, const L& a, const L& b){
+    auto na = label_name(tree,a), nb = label_name(tree,b);
+    if(na!=nb)return na<nb;
+    return label_ns(tree,a)<label_ns(tree,b);
+}
+
+///Range of labels with `name`, in any namespace.
+template<typename L>
+inline std::pair<size_t,size_t> find_label(const TreeRaw& tree, std::span<const L> l, std::string_view name){
+    auto lo = std::partition_point(l.begin(),l.end(),[&](const L& v){return label_name(tree,v)<name;});
+    auto hi = std::partition_point(lo,l.end(),[&](const L& v){return label_name(tree,v)==name;});
+    return {lo-l.begin(),hi-l.begin()};
+}
+
+///Position of the label with `ns` and `name`, if any.
+template<typename L>
+inline std::optional<size_t> find_label(const TreeRaw& tree, std::span<const L> l, std::string_view ns, std::string_view name){
+    auto [lo,hi] = find_label(tree,l,name);
+    auto it = std::partition_point(l.begin()+lo,l.begin()+hi,[&](const L& v){return label_ns(tree,v)<ns;});
+    if(it!=l.begin()+hi && label_ns(tree,*it)==ns)return it-l.begin();
+    return {};
+}
+
+}
+
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+/**
+ * @file query-archive.hpp
+ * @author karurochari
+ * @brief Parallel queries over all documents of an archive.
+ * @date 2025-06-25
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include <vs-xml/archive.hpp>
+#include <vs-xml/document.hpp>
+#include <vs-xml/executor.hpp>
+#include <vs-xml/query.hpp>
+
+namespace VS_XML_NS{
+namespace query{
+
+///Order in which matches from different documents are reported.
+enum struct order_t{
+    ORDERED,        ///By document, in the same order they have in the archive.
+    UNORDERED,      ///As soon as each document is completed.
+};
+
+/**
+ * @brief Callback receiving matches from the documents of an archive. Return false to stop the evaluation.
+ * @details Calls are never concurrent, but they can happen from any thread of the executor.
+ *          Nodes passed are only valid for the duration of the call, use their address if they must be kept.
+ */
+typedef bool(*archive_sink_t)(size_t document, wrp::base_t<unknown_t> node, void* ctx);
+
+/**
+ * @brief Run a query on each document of an archive, in parallel.
+ * @details Documents which cannot be loaded, like those failing lazy verification, are skipped as if they had no matches.
+ *
+ * @param archive the archive whose documents are queried.
+ * @param query the query to run from the root of each document.
+ * @param executor the executor running the documents.
+ * @param sink the function called for each match.
+ * @param ctx context passed to sink.
+ * @param order if results must be reported in document order or as soon as possible.
+ * @return false if stopped by the sink, true otherwise.
+ */
+template<size_t N=0>
+bool is(const ArchiveRaw& archive, const query_t<N>& query, Executor& executor, archive_sink_t sink, void* ctx=nullptr, order_t order=order_t::ORDERED){
+    struct state_t{
+        const ArchiveRaw&                               archive;
+        const query_t<N>&                               query;
+        archive_sink_t                                  sink;
+        void*                                           ctx;
+        order_t                                         order;
+        std::vector<std::optional<Document>>            docs;     //Loaded by the task running each one, empty if it cannot be.
+        std::vector<std::vector<wrp::base_t<unknown_t>>> results;
+        std::vector<uint8_t>                            done;
+        size_t                                          next = 0;     //First document not reported yet, for ORDERED.
+        std::mutex                                      lock;
+        std::atomic<bool>                               stopped = false;
+
+        //Report all documents which can be, with lock held.
+        void report(size_t idx){
+            if(order==order_t::UNORDERED){
+                for(auto& node : results[idx]){
+                    if(!sink(idx,node,ctx)){stopped=true;break;}
+                }
+                results[idx] = {};
+                return;
+            }
+            done[idx] = true;
+            for(;next<docs.size() && done[next] && !stopped;next++){
+                for(auto& node : results[next]){
+                    if(!sink(next,node,ctx)){stopped=true;break;}
+                }
+                results[next] = {};
+            }
+        }
+    } state{archive,query,sink,ctx,order,{},{},{}};
+
+    auto items = archive.items();
+    state.docs.resize(items);
+    state.results.resize(items);
+    state.done.resize(items);
+
+    executor.parallel_for(items,+[](void* ptr, size_t begin, size_t end){
+        auto& state = *(state_t*)ptr;
+        for(size_t i=begin;i<end;i++){
+            if(state.stopped)return;
+            if(auto doc = state.archive.get(i); doc.has_value())state.docs[i].emplace(std::move(*doc));
+            if(state.docs[i].has_value()){
+                for(auto node : is(state.docs[i]->root(),state.query)){
+                    state.results[i].push_back(node);
+                    if(state.stopped)break;
+                }
+            }
+            std::lock_guard guard(state.lock);
+            state.report(i);
+        }
+    },&state,std::max<size_t>(1,items/(executor.concurrency()*64)));
+
+    return !state.stopped;
+}
+
+}
+}
@@ -1,5 +1,7 @@
+#pragma once
+
 /**
- * @file query-builder.cpp
+ * @file query-builder.hpp
  * @author karurochari
  * @brief Utility classes to build tree-queries & their linear representation.
  * @date 2025-05-28
@@ -9,10 +11,14 @@
  */
 
 #include <expected>
+#include <functional>
+#include <variant>
+#include <vector>
 
 #include <string_view>
 #include <vs-xml/commons.hpp>
 #include <vs-xml/wrp-node.hpp>
+#include <vs-xml/query-new.hpp>
 
 namespace VS_XML_NS{
 namespace query{
@@ -77,12 +83,24 @@ struct Token{
     
 
 struct QueryBuilder;
-struct Query;
-struct QueryResult;
 
+/**
+ * @brief Builder for flat queries.
+ * @details Frames are independent queries, each one evaluated from a root node. 
+ * Inside a frame, `begin`/`any` open a step moving one level (or any number of levels) down, closed by `end`.
+ * Matching operations always refer to the innermost open block and must precede any nested step.
+ * Steps with no nested step implicitly accept the node they matched.
+ */
 struct QueryBuilder{
     enum struct error_t{
-        NOT_IMPLEMENTED
+        OK = 0,
+        NOT_IMPLEMENTED,
+        FRAME_OPEN,         //A frame is already open (or still open when closing).
+        FRAME_CLOSED,       //No frame open to append to.
+        STACK_EMPTY,        //No step to be closed.
+        MISFORMED,          //Operation not allowed in the current position.
+        NOT_SERIALIZABLE,   //Operands like lambdas cannot be represented.
+        TOO_LARGE,          //Limits of the binary representation exceeded.
     };
 
 
@@ -95,8 +113,10 @@ struct QueryBuilder{
     error_t begin_frame(std::string_view name, Type type); //, void(*capturer)(std::string_view, xml_size_t, void*)=nullptr
     error_t end_frame();//Implicit accept
 
+    ///Open a step matching nodes at any depth below the current one. To be closed by `end`.
     error_t any(std::string_view capture = {});
 
+    ///Open a step matching children of the current node. To be closed by `end`.
     error_t begin(std::string_view capture = {});
     error_t end();
 
@@ -104,28 +124,32 @@ struct QueryBuilder{
     error_t match_ns(Token::single_t<Token::type_t::MATCH_NS>);
     error_t match_name(Token::single_t<Token::type_t::MATCH_NAME>);
     error_t match_value(Token::single_t<Token::type_t::MATCH_VALUE>);
-    error_t match_all_text(Token::single_t<Token::type_t::MATCH_ALL_TEXT>);
+    error_t match_all_text(Token::single_t<Token::type_t::MATCH_ALL_TEXT>, text_mode_t mode = text_mode_t::EXACT);
     error_t match_attr(Token::attr_t<Token::type_t::MATCH_ATTR>, std::string_view capture = {});
 
+    ///Match the node in a given position (1-based) among its siblings passing the filters added before this one.
+    error_t match_position(uint32_t position);
+
     //Syntax sugar for ns/name/all_text in case of element
     //error_t element();
 
     //error_t fork();
 
-    error_t inject(const Query query);
+    ///Splice the body of the first frame of `query` in the current position.
+    error_t inject(const Query& query);
 
     [[nodiscard]] std::expected<Query,error_t> close();
 
     private:
-        struct section_t{
-            sv name;
-            size_t offset;
-            size_t length;
-        };
-
-        std::vector<section_t>   sections;
-        std::vector<Token>       tokens;
+        std::vector<cell_t>      cells;
         std::vector<char>        symbols;
+        std::vector<size_t>      stack;         //Positions of the open BEGIN cells.
+        size_t                   frames = 0;
+
+        error_t push(const cell_t& cell);
+        error_t open(op_t op, uint8_t mode, std::string_view capture);
+        std::expected<cell_t::operand_t,error_t> operand(const Token::operand_t& src, uint8_t& flags, size_t i);
+        std::expected<cell_t::operand_t,error_t> operand(std::string_view src);
 };
 
 /*
@@ -0,0 +1,128 @@
+#pragma once
+
+/**
+ * @file query-cache.hpp
+ * @author karurochari
+ * @brief Cache of compiled query plans, and the thread-safe store shared with other caches of queries.
+ * @date 2025-06-23
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <vs-xml/fwd/unordered_map.hpp>
+#include <vs-xml/query-new.hpp>
+
+namespace VS_XML_NS{
+namespace query{
+
+struct cache_stats_t{
+    size_t hits = 0;
+    size_t misses = 0;
+};
+
+namespace details{
+
+/**
+ * @brief Thread-safe store of values in buckets by a 64bit hash, which are never evicted nor moved until `clear`.
+ */
+template<typename T>
+struct cache_store_t{
+    /**
+     * @brief First value in the bucket of `hash` accepted by `match`, or a new one from `make` if none is.
+     * @details `make` runs outside the lock, and returns nullptr on failure, in which case nothing is stored and nullptr is returned.
+     */
+    template<typename Match, typename Make>
+    const T* get(uint64_t hash, Match&& match, Make&& make){
+        {
+            std::lock_guard guard(lock);
+            if(auto it = buckets.find(hash); it!=buckets.end()){
+                for(auto& value : it->second){
+                    if(match(*value)){
+                        counters.hits++;
+                        return value.get();
+                    }
+                }
+            }
+            counters.misses++;
+        }
+
+        std::unique_ptr<T> value = make();
+        if(value==nullptr)return nullptr;
+
+        std::lock_guard guard(lock);
+        auto& bucket = buckets[hash];
+        //Someone else might have made the same value in the meanwhile.
+        for(auto& other : bucket){
+            if(match(*other))return other.get();
+        }
+        bucket.push_back(std::move(value));
+        count++;
+        return bucket.back().get();
+    }
+
+    [[nodiscard]] inline size_t size() const{
+        std::lock_guard guard(lock);
+        return count;
+    }
+
+    [[nodiscard]] inline cache_stats_t stats() const{
+        std::lock_guard guard(lock);
+        return counters;
+    }
+
+    inline void clear(){
+        std::lock_guard guard(lock);
+        buckets.clear();
+        count = 0;
+    }
+
+    private:
+        mutable std::mutex lock;
+        VS_XML_NS::unordered_map<uint64_t,std::vector<std::unique_ptr<T>>> buckets;
+        size_t count = 0;
+        cache_stats_t counters;
+};
+
+}
+
+/**
+ * @brief Thread-safe cache mapping queries (by their hash) to their plans for specific trees.
+ * @details Repeated runs of the same query on the same tree skip compilation and symbol resolution.
+ *          Plans are never evicted unless `clear` is called, so pointers returned by `get` stay valid until then.
+ *          The cache must be cleared (or destroyed) before any of the trees it was used with.
+ */
+struct QueryCache{
+    using stats_t = cache_stats_t;
+
+    /**
+     * @brief Get the plan of a query for a tree (and its indices), compiling it if not already present.
+     */
+    [[nodiscard]] const plan_t& get(const Query& query, const TreeRaw& tree, const indexes_t& indexes = {});
+
+    ///Run the frame in position `frame` of a query, using the cached plan.
+    inline bool run(const Query& query, const TreeRaw& tree, const unknown_t* root, sink_t sink, void* ctx=nullptr, size_t frame=0, const indexes_t& indexes = {}){
+        return query::run(get(query,tree,indexes),tree,root,sink,ctx,frame);
+    }
+
+    ///Number of plans stored.
+    [[nodiscard]] inline size_t size() const{return plans.size();}
+
+    [[nodiscard]] inline stats_t stats() const{return plans.stats();}
+
+    ///Drop all plans. Previously returned references are invalidated.
+    inline void clear(){plans.clear();}
+
+    private:
+        details::cache_store_t<plan_t> plans;
+};
+
+}
+}
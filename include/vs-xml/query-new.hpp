@@ -1,17 +1,295 @@
 #pragma once
 
 /**
- * @file query2.hpp
+ * @file query-new.hpp
  * @author karurochari
- * @brief Queries on Tree/Document.
+ * @brief Flat, serializable queries on Tree/Document and their interpreter.
  * @date 2025-06-22
- * 
+ *
  * @copyright Copyright (c) 2025
- * 
+ *
  */
 
+#include <cstddef>
+#include <cstdint>
+
+#include <expected>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <vs-xml/commons.hpp>
+#include <vs-xml/tree.hpp>
+#include <vs-xml/node.hpp>
+
 namespace VS_XML_NS{
-namespace query2{
 
+struct NameIndex;
+struct AttrIndex;
+struct SubtreeStats;
+
+namespace query{
+
+/**
+ * @brief Operations available in the flat representation of a query.
+ * @details See `docs/specs/query-builder.md` for their semantics.
+ */
+enum struct op_t : uint8_t{
+    EOQ,            ///End of query, always the last cell.
+    BEGIN,          ///Begin of a frame or of a step. `mode` is the frame type or the step axis.
+    END,            ///End of the frame or step opened by the matching BEGIN.
+    CAPTURE,        ///Capture label for the preceding cell (or for the enclosing block if right after BEGIN).
+    MATCH_TYPE,     ///`mode` is a bitmask of `type_mask_t`.
+    MATCH_NS,
+    MATCH_NAME,
+    MATCH_VALUE,
+    MATCH_ALL_TEXT, ///`mode` is a `text_mode_t`.
+    MATCH_ATTR,     ///Operands are ns, name and value of the attribute.
+    MATCH_POSITION, ///`skip` is the 1-based position of the node among its siblings passing the filters before this one.
+};
+
+///Axis of a step block (`mode` of a BEGIN which is not a frame).
+enum struct axis_t : uint8_t{
+    CHILD,          ///Children of the current node.
+    DESCENDANT,     ///Any node below the current one.
+};
+
+///Type of a frame (`mode` of a top level BEGIN).
+enum struct frame_t : uint8_t{
+    CHILD_IS,       ///From a root, select all children fulfilling the query conditions.
+    IS,             ///Pick the root itself if it fulfills the query conditions.
+    HAS,            ///Pick the root if at least one match for the query conditions exists.
+};
+
+///How text is compared by MATCH_ALL_TEXT (`mode` of its cell).
+enum struct text_mode_t : uint8_t{
+    EXACT,          ///The text must be equal to the pattern.
+    PREFIX,         ///The text must start with the pattern.
+    CONTAINS,       ///The pattern must appear somewhere in the text.
+};
+
+///Bits used by MATCH_TYPE.
+enum type_mask_t : uint8_t{
+    TYPE_ELEMENT = 1<<0,
+    TYPE_COMMENT = 1<<1,
+    TYPE_PROC    = 1<<2,
+    TYPE_TEXT    = 1<<3,
+    TYPE_CDATA   = 1<<4,
+    TYPE_MARKER  = 1<<5,
+};
+
+/**
+ * @brief Regular cell of the flat query representation.
+ * @details Strings are stored in a pool placed right after the cells, operands are relative to its beginning.
+ */
+struct cell_t{
+    struct operand_t{
+        uint32_t base;
+        uint32_t length;
+    };
+
+    op_t        op;
+    uint8_t     mode = 0;       //Frame type, axis, type mask or string matching mode, depending on `op`.
+    uint8_t     flags = 0;      //Bit `i` set if `operands[i]` is present. Missing operands match anything.
+    uint8_t     res0 = 0;
+    uint32_t    skip = 0;       //For BEGIN cells to reach their END, for END cells to reach back their BEGIN, for MATCH_POSITION the position.
+    operand_t   operands[3] = {};
+
+    constexpr inline bool has(size_t i) const{return (flags>>i)&1;}
+};
+static_assert(sizeof(cell_t)==32, "cell_t is expected to be 32 bytes");
+
+/**
+ * @brief A query in its flat representation: a contiguous block of bytes which can be freely copied, hashed and shared.
+ * @details Layout is a `header_t`, followed by the cells and by the string pool.
+ */
+struct Query{
+    struct header_t{
+        uint8_t  magic[4] = {'$','X','Q','B'};
+        uint8_t  format_major = 0;
+        uint8_t  format_minor = 1;
+        uint16_t frames = 0;
+        uint32_t cells = 0;
+        uint32_t length_of_symbols = 0;
+    };
+    static_assert(sizeof(header_t)==16, "header_t is expected to be 16 bytes");
+
+    enum struct from_binary_error_t{
+        OK,
+        HeaderTooSmall,
+        MagicMismatch,
+        VersionMismatch,
+        TruncatedSpan,
+        OperandOutOfBounds,
+        Misformed,
+    };
+
+    ///Header of this query.
+    [[nodiscard]] inline const header_t& header() const{return *(const header_t*)data.data();}
+
+    ///All cells, the last one always being EOQ.
+    [[nodiscard]] inline std::span<const cell_t> cells() const{
+        return {(const cell_t*)(data.data()+sizeof(header_t)),header().cells};
+    }
+
+    ///The string pool of the query.
+    [[nodiscard]] inline std::string_view symbols() const{
+        return {(const char*)data.data()+sizeof(header_t)+sizeof(cell_t)*header().cells,header().length_of_symbols};
+    }
+
+    ///Resolve an operand to its string.
+    [[nodiscard]] inline std::string_view rsv(cell_t::operand_t o) const{return symbols().substr(o.base,o.length);}
+
+    ///The binary representation of this query.
+    [[nodiscard]] inline std::span<const uint8_t> bytes() const{return data;}
+
+    ///Number of frames in this query.
+    [[nodiscard]] inline size_t frames() const{return header().frames;}
+
+    ///Position of the BEGIN cell for the frame in position idx, if present.
+    [[nodiscard]] std::optional<size_t> frame(size_t idx) const;
+
+    ///Position of the BEGIN cell for the frame with a given name, if present.
+    [[nodiscard]] std::optional<size_t> frame(std::string_view name) const;
+
+    ///Stable (across builds and processes) 64bit hash of the binary representation.
+    [[nodiscard]] uint64_t hash() const;
+
+    ///Load a query from its binary representation, validating its structure. Data is copied.
+    [[nodiscard]] static std::expected<Query,from_binary_error_t> from_binary(std::span<const uint8_t> region);
+
+    friend inline bool operator==(const Query& a, const Query& b){return a.data==b.data;}
+
+    private:
+        std::vector<uint8_t> data;
+
+        inline Query(std::vector<uint8_t>&& src):data(std::move(src)){}
+
+        friend struct QueryBuilder;
+};
+
+/**
+ * @brief Compare the text of a node (its TEXT and CDATA children, concatenated) against a pattern.
+ * @details Text is streamed frame by frame, and unescaped on the fly for trees with raw strings.
+ *          No buffer is allocated, and the comparison stops as soon as its result is known.
+ *
+ * @param tree the tree hosting `node`, used to resolve its symbols.
+ * @param node the node whose text is tested. Nodes other than elements never match.
+ * @param pattern the pattern to match.
+ * @param mode how the text is compared with the pattern.
+ */
+[[nodiscard]] bool match_all_text(const TreeRaw& tree, const unknown_t* node, std::string_view pattern, text_mode_t mode = text_mode_t::EXACT);
+
+/**
+ * @brief Optional indices of a tree, used by plans to avoid visiting whole subtrees.
+ * @details They must have been built for the same tree the plan is compiled against, and must outlive the plan.
+ */
+struct indexes_t{
+    const NameIndex* names = nullptr;   ///Used to jump to the candidates of descendant steps matching a name.
+    const AttrIndex* attrs = nullptr;   ///Used to jump to the candidates of descendant steps matching a literal attribute value.
+    const SubtreeStats* stats = nullptr;///Used to skip subtrees which are too shallow or lack the labels required by a step.
+
+    friend inline bool operator==(const indexes_t&, const indexes_t&) = default;
+};
+
+/**
+ * @brief A query compiled against one specific tree.
+ * @details Operands are resolved once against the symbol table of the tree, so that labels can be compared by offset in place of strings.
+ *          Occurrence counts are kept as selectivity hints, used to order filters and to prune blocks which can never match.
+ *          Plans are only valid for the tree (and symbol table) they were compiled against.
+ */
+struct plan_t{
+    ///Where the candidates of a descendant step are taken from.
+    enum source_t : uint8_t{
+        SCAN,           ///Visit the whole subtree.
+        NAMES,          ///Posting lists of the name index.
+        ATTRS,          ///Posting lists of the attribute index.
+    };
+
+    enum state_t : uint8_t{
+        ANY,            ///Operand not present.
+        STRING,         ///The operand must be compared as a string.
+        SV,             ///All occurrences in the tree share the same offset, compare `svs[i]` only.
+        ABSENT,         ///The operand never occurs in the tree.
+    };
+
+    struct resolved_t{
+        state_t     state[3] = {ANY,ANY,ANY};
+        sv          svs[3] = {};
+        uint32_t    hits = UINT32_MAX;  //Upper bound of nodes (or attributes) matching this cell. UINT32_MAX if unknown.
+        bool        dead = false;       //For BEGIN cells, true if the block can never accept any node.
+        uint32_t    filters = 0;        //For BEGIN cells, base of the filters of this block in `order`.
+        uint32_t    filters_count = 0;  //For BEGIN cells, number of filters in this block.
+        uint32_t    body = 0;           //For BEGIN cells, position of the first nested BEGIN or of the matching END.
+        source_t    source = SCAN;      //For descendant steps, where candidates are taken from.
+        uint32_t    keys = 0;           //For indexed steps, base of the selected posting lists in `keys`.
+        uint32_t    keys_count = 0;     //For indexed steps, number of selected posting lists.
+        uint32_t    min_depth = 0;      //For BEGIN cells, minimum depth below the node required by the nested steps.
+        bool        prune = false;      //For steps matching a name, true if subtrees can be pruned by `label`.
+        uint64_t    label = 0;          //For steps matching a name, its key in the subtree summaries.
+    };
+
+    Query                   query;
+    const void*             root;       //Identity of the tree this plan was compiled for.
+    const void*             symbols;    //Identity of its symbol table.
+    std::vector<resolved_t> cells;      //One for each cell of query.
+    std::vector<uint32_t>   order;      //Filters of each block, most selective first.
+    indexes_t               indexes;    //Indices this plan was compiled with.
+    std::vector<uint32_t>   keys;       //Labels (for the name index) or values (for the attribute index) selected by indexed steps.
+
+    ///True if this plan can be used to run `q` over `tree`, with the same indices.
+    [[nodiscard]] bool valid_for(const Query& q, const TreeRaw& tree, const indexes_t& idx = {}) const;
+};
+
+/**
+ * @brief Compile a query against a tree.
+ * @details It requires a single visit of the tree to collect its labels, so it is only worth when the plan is reused (see `QueryCache`).
+ *          If indices are provided, descendant steps matching a name or a literal attribute value only visit the elements which can match,
+ *          picking the index with fewer candidates. With subtree summaries, subtrees which cannot host a match are skipped.
+ */
+[[nodiscard]] plan_t compile(const Query& query, const TreeRaw& tree, const indexes_t& indexes = {});
+
+/**
+ * @brief Callback receiving matches of a query. Return false to stop the evaluation.
+ */
+typedef bool(*sink_t)(const unknown_t* node, void* ctx);
+
+/**
+ * @brief Run the frame in position `frame` of a flat query on a tree, starting from `root`.
+ *
+ * @param query the query to evaluate.
+ * @param tree the tree hosting `root`, used to resolve its symbols.
+ * @param root node from which the frame is evaluated. If nullptr, the tree root is used.
+ * @param sink the function called for each match.
+ * @param ctx context passed to sink.
+ * @param frame ordinal of the frame to evaluate.
+ * @return false if stopped by the sink or if the frame does not exist, true otherwise.
+ */
+bool run(const Query& query, const TreeRaw& tree, const unknown_t* root, sink_t sink, void* ctx=nullptr, size_t frame=0);
+
+/**
+ * @brief Run the frame in position `frame` of a compiled query, starting from `root`.
+ * @details Same as the other variant, but operands are not resolved again and blocks which can never match are skipped.
+ */
+bool run(const plan_t& plan, const TreeRaw& tree, const unknown_t* root, sink_t sink, void* ctx=nullptr, size_t frame=0);
+
+/**
+ * @brief Number of matches `run` would report for a frame, without calling any sink.
+ * @details If the frame does not exist, 0 is returned.
+ */
+[[nodiscard]] size_t count(const Query& query, const TreeRaw& tree, const unknown_t* root=nullptr, size_t frame=0);
+[[nodiscard]] size_t count(const plan_t& plan, const TreeRaw& tree, const unknown_t* root=nullptr, size_t frame=0);
+
+///True if a frame has at least one match. The evaluation stops at the first one.
+[[nodiscard]] bool exists(const Query& query, const TreeRaw& tree, const unknown_t* root=nullptr, size_t frame=0);
+[[nodiscard]] bool exists(const plan_t& plan, const TreeRaw& tree, const unknown_t* root=nullptr, size_t frame=0);
+
+/**
+ * @brief Matches of a frame in the order reported by `run`, skipping the first `skip` and stopping once `n` are collected.
+ */
+[[nodiscard]] std::vector<const unknown_t*> first_n(const Query& query, const TreeRaw& tree, size_t n, size_t skip=0, const unknown_t* root=nullptr, size_t frame=0);
+[[nodiscard]] std::vector<const unknown_t*> first_n(const plan_t& plan, const TreeRaw& tree, size_t n, size_t skip=0, const unknown_t* root=nullptr, size_t frame=0);
+
+}
 }
-}
\ No newline at end of file
@@ -0,0 +1,135 @@
+#pragma once
+
+/**
+ * @file query-parallel.hpp
+ * @author karurochari
+ * @brief Parallel queries within a single large tree.
+ * @date 2025-06-26
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <vs-xml/executor.hpp>
+#include <vs-xml/query.hpp>
+
+namespace VS_XML_NS{
+namespace query{
+
+/**
+ * @brief Callback receiving matches of a parallel query. Return false to stop receiving them.
+ */
+typedef bool(*node_sink_t)(wrp::base_t<unknown_t> node, void* ctx);
+
+namespace details{
+
+template<size_t N>
+struct parallel_is_t{
+    using iterator = typename query_t<N>::container_type::const_iterator;
+    using results_t = std::vector<wrp::base_t<unknown_t>>;
+
+    Executor&   executor;
+    iterator    end;
+    size_t      threshold;
+
+    //Same semantics of `is`, but results are appended to out.
+    void eval(wrp::base_t<unknown_t> root, iterator begin, results_t& out){
+        for(auto current = begin;current!=end;current++){
+            if (std::holds_alternative<token_t::empty_t<token_t::ACCEPT>>(current->args)) {
+                out.push_back(root);
+                return;
+            }
+            else if (std::holds_alternative<token_t::empty_t<token_t::NEXT>>(current->args)) {
+                if(root.type()==type_t::ELEMENT)children(root,current+1,out);
+                return;
+            }
+            else if (std::holds_alternative<token_t::empty_t<token_t::FORK>>(current->args)) {
+                if(root.type()!=type_t::ELEMENT)return;
+                children(root,current,out);
+            }
+            else if(!filter_helper(root,current,end))return;
+        }
+    }
+
+    struct chunks_t{
+        parallel_is_t*                          self;
+        iterator                                pc;
+        std::vector<wrp::base_t<unknown_t>>     kids;
+        std::vector<size_t>                     bounds;     //First child of each chunk, plus the end.
+        std::vector<results_t>                  parts;
+    };
+
+    //Evaluate pc on all children of root. Large subtrees are split in chunks of about `threshold` bytes, run as separate tasks.
+    void children(wrp::base_t<unknown_t> root, iterator pc, results_t& out){
+        auto range = ((const unknown_t*)root)->children_range();
+        size_t extent = (const uint8_t*)range->second-(const uint8_t*)range->first;
+        if(extent<threshold){
+            for(auto child : root.children())eval(child,pc,out);
+            return;
+        }
+
+        chunks_t chunks{this,pc,{},{0},{}};
+        size_t accumulated = 0;
+        for(auto child : root.children()){
+            auto raw = (const unknown_t*)child;
+            chunks.kids.push_back(child);
+            //Subtrees are laid out contiguously, so their extent is given by the start of the next sibling.
+            accumulated += (const uint8_t*)raw->next()-(const uint8_t*)raw;
+            if(accumulated>=threshold){
+                chunks.bounds.push_back(chunks.kids.size());
+                accumulated = 0;
+            }
+        }
+        if(chunks.bounds.back()!=chunks.kids.size())chunks.bounds.push_back(chunks.kids.size());
+        chunks.parts.resize(chunks.bounds.size()-1);
+
+        Executor::group_t group;
+        for(size_t i=0;i+1<chunks.bounds.size();i++){
+            executor.spawn(group,+[](void* ptr, size_t idx, size_t){
+                auto& chunks = *(chunks_t*)ptr;
+                for(size_t j=chunks.bounds[idx];j<chunks.bounds[idx+1];j++){
+                    chunks.self->eval(chunks.kids[j],chunks.pc,chunks.parts[idx]);
+                }
+            },&chunks,i,i+1);
+        }
+        executor.wait(group);
+
+        //Merged in document order.
+        for(auto& part : chunks.parts)out.insert(out.end(),part.begin(),part.end());
+    }
+};
+
+}
+
+/**
+ * @brief Run a query on a tree, splitting the children of large elements into tasks of the executor.
+ * @details Splitting happens whenever children are explored, by `next()` or by `fork()` (like `**`), if the extent of their subtrees exceeds `threshold` bytes.
+ *          Results are the same of `is`, and they are reported in the same order once the evaluation is completed.
+ *          The whole query always runs before the first result is reported, so the sink returning false only skips the remaining ones.
+ *          Use `is` when only the first few matches are needed.
+ *
+ * @param root the node from which the query is evaluated.
+ * @param query the query to run.
+ * @param executor the executor running the tasks.
+ * @param sink the function called for each match.
+ * @param ctx context passed to sink.
+ * @param threshold minimum extent in bytes for children to be split.
+ * @return false if the sink stopped receiving results, true otherwise.
+ */
+template<size_t N=0>
+bool is(wrp::base_t<unknown_t> root, const query_t<N>& query, Executor& executor, node_sink_t sink, void* ctx=nullptr, size_t threshold=1<<16){
+    details::parallel_is_t<N> engine{executor,query.tokens.end(),threshold==0?1:threshold};
+    std::vector<wrp::base_t<unknown_t>> results;
+    engine.eval(root,query.tokens.begin(),results);
+    for(auto& node : results){
+        if(!sink(node,ctx))return false;
+    }
+    return true;
+}
+
+}
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+/**
+ * @file query-static.hpp
+ * @author karurochari
+ * @brief Queries specialised at compile time.
+ * @date 2025-06-24
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#include <string_view>
+#include <utility>
+#include <variant>
+
+#include <vs-xml/commons.hpp>
+#include <vs-xml/wrp-node.hpp>
+#include <vs-xml/query.hpp>
+
+namespace VS_XML_NS{
+namespace query{
+
+namespace details{
+
+///Token of a query known at compile time, with no variant and operands stored in a constant pool.
+struct static_token_t{
+    token_t::type_t op = token_t::ACCEPT;
+    uint8_t         mask = 0;           //Type mask for TYPE.
+    uint8_t         present = 0;        //Bit `i` set if operand `i` is present.
+    uint32_t        base[3] = {};
+    uint32_t        length[3] = {};
+};
+
+template<size_t N, size_t C>
+struct static_query_t{
+    static_token_t  tokens[N == 0 ? 1 : N] = {};
+    char            pool[C + 1] = {};
+
+    static constexpr size_t size = N;
+
+    constexpr std::string_view operand(size_t pc, size_t i) const{return {pool+tokens[pc].base[i],tokens[pc].length[i]};}
+};
+
+template<typename Q>
+constexpr size_t used_tokens(const Q& q){
+    if constexpr(requires{q.current;})return q.current;
+    else return q.tokens.size();
+}
+
+constexpr size_t operand_size(const token_t::operand_t& o){
+    //Not a constant expression, so that lambdas are reported at compile time.
+    if(std::holds_alternative<std::function<bool(std::string_view)>>(o))throw "Lambdas cannot be used in specialised queries";
+    else if(std::holds_alternative<std::string_view>(o))return std::get<std::string_view>(o).size();
+    return 0;
+}
+
+template<typename Q>
+constexpr size_t pool_size(const Q& q){
+    size_t ret = 0;
+    for(size_t i=0;i<used_tokens(q);i++){
+        std::visit([&](const auto& arg){
+            using T = std::decay_t<decltype(arg)>;
+            if constexpr(std::is_base_of_v<token_t::operand_t,T>)ret+=operand_size(arg);
+            else if constexpr(requires{arg.ns;})ret+=operand_size(arg.ns)+operand_size(arg.name)+operand_size(arg.value);
+        },q.tokens[i].args);
+    }
+    return ret;
+}
+
+template<auto F>
+consteval auto flatten(){
+    constexpr size_t N = used_tokens(F());
+    constexpr size_t C = pool_size(F());
+    auto q = F();
+
+    static_query_t<N,C> ret;
+    size_t top = 0;
+    auto store = [&](static_token_t& dst, size_t i, const token_t::operand_t& o){
+        if(!std::holds_alternative<std::string_view>(o))return;
+        auto str = std::get<std::string_view>(o);
+        dst.present|=1<<i;
+        dst.base[i]=top;
+        dst.length[i]=str.size();
+        for(auto c : str)ret.pool[top++]=c;
+    };
+
+    for(size_t i=0;i<N;i++){
+        auto& dst = ret.tokens[i];
+        dst.op = (token_t::type_t)q.tokens[i].args.index();
+        std::visit([&](const auto& arg){
+            using T = std::decay_t<decltype(arg)>;
+            if constexpr(std::is_same_v<T,token_t::type_filter_t<token_t::TYPE>>){
+                dst.mask =
+                    (arg.is_element?1:0) | (arg.is_comment?2:0) | (arg.is_proc?4:0) |
+                    (arg.is_text?8:0) | (arg.is_cdata?16:0) | (arg.is_marker?32:0);
+            }
+            else if constexpr(std::is_base_of_v<token_t::operand_t,T>)store(dst,0,arg);
+            else if constexpr(requires{arg.ns;}){
+                store(dst,0,arg.ns);
+                store(dst,1,arg.name);
+                store(dst,2,arg.value);
+            }
+        },q.tokens[i].args);
+    }
+    return ret;
+}
+
+template<auto Q, size_t PC>
+consteval size_t consecutive_attrs(){
+    size_t i = PC;
+    while(i<Q.size && Q.tokens[i].op==token_t::MATCH_ATTR)i++;
+    return i-PC;
+}
+
+//Compare a symbol of the tree against a constant.
+template<auto Q, size_t PC, size_t I>
+inline bool static_match(const TreeRaw& tree, const std::expected<VS_XML_NS::sv,feature_t>& check){
+    if constexpr(((Q.tokens[PC].present>>I)&1)==0)return true;
+    else{
+        constexpr std::string_view pattern = Q.operand(PC,I);
+        if(!check.has_value())return false;
+        if(!tree.config().raw_strings)return tree.rsv(*check)==pattern;
+        return wrp::sv(tree,*check)==pattern;
+    }
+}
+
+template<auto Q, size_t PC>
+bool static_step(wrp::base_t<unknown_t> node, auto& sink){
+    if constexpr(PC>=Q.size)return true;
+    else{
+        constexpr auto t = Q.tokens[PC];
+        const auto* raw = (const unknown_t*)node;
+
+        if constexpr(t.op==token_t::ACCEPT){
+            return sink(node);
+        }
+        else if constexpr(t.op==token_t::NEXT){
+            if(node.type()==type_t::ELEMENT){
+                for(auto child : node.children()){
+                    if(!static_step<Q,PC+1>(child,sink))return false;
+                }
+            }
+            return true;
+        }
+        else if constexpr(t.op==token_t::FORK){
+            if(node.type()!=type_t::ELEMENT)return true;
+            for(auto child : node.children()){
+                if(!static_step<Q,PC>(child,sink))return false;
+            }
+            return static_step<Q,PC+1>(node,sink);
+        }
+        else if constexpr(t.op==token_t::TYPE){
+            constexpr uint8_t masks[] = {0,1,0,8,16,2,4,32};
+            auto type = (size_t)node.type();
+            if(type>=sizeof(masks) || (masks[type]&t.mask)==0)return true;
+            return static_step<Q,PC+1>(node,sink);
+        }
+        else if constexpr(t.op==token_t::MATCH_NS){
+            if(!static_match<Q,PC,0>(node.tree(),raw->ns()))return true;
+            return static_step<Q,PC+1>(node,sink);
+        }
+        else if constexpr(t.op==token_t::MATCH_NAME){
+            if(!static_match<Q,PC,0>(node.tree(),raw->name()))return true;
+            return static_step<Q,PC+1>(node,sink);
+        }
+        else if constexpr(t.op==token_t::MATCH_VALUE){
+            if(!static_match<Q,PC,0>(node.tree(),raw->value()))return true;
+            return static_step<Q,PC+1>(node,sink);
+        }
+        else if constexpr(t.op==token_t::MATCH_ALL_TEXT || t.op==token_t::MATCH_TEXT_PREFIX || t.op==token_t::MATCH_TEXT_CONTAINS){
+            if constexpr(t.present&1){
+                constexpr auto mode = t.op==token_t::MATCH_ALL_TEXT?text_mode_t::EXACT:t.op==token_t::MATCH_TEXT_PREFIX?text_mode_t::PREFIX:text_mode_t::CONTAINS;
+                if(!match_all_text(node.tree(),raw,Q.operand(PC,0),mode))return true;
+            }
+            return static_step<Q,PC+1>(node,sink);
+        }
+        else if constexpr(t.op==token_t::MATCH_ATTR){
+            //All consecutive attribute matches are unrolled over a single pass on the attributes.
+            constexpr size_t K = consecutive_attrs<Q,PC>();
+            static_assert(K<=64, "Too many consecutive attribute matches");
+            constexpr uint64_t full = (K==64)?~(uint64_t)0:(((uint64_t)1<<K)-1);
+            if(node.type()!=type_t::ELEMENT)return true;
+
+            const auto& tree = node.tree();
+            uint64_t satisfied = 0;
+            for(auto& attr : raw->attrs()){
+                [&]<size_t... I>(std::index_sequence<I...>){
+                    ((satisfied |= (
+                        static_match<Q,PC+I,0>(tree,attr.ns()) &&
+                        static_match<Q,PC+I,1>(tree,attr.name()) &&
+                        static_match<Q,PC+I,2>(tree,attr.value())
+                    )?((uint64_t)1<<I):0), ...);
+                }(std::make_index_sequence<K>{});
+                if(satisfied==full)break;
+            }
+            if(satisfied!=full)return true;
+            return static_step<Q,PC+K>(node,sink);
+        }
+        else return true;
+    }
+}
+
+}
+
+/**
+ * @brief A query specialised at compile time.
+ * @details `F` is a constexpr callable returning the `query_t` to specialise, as queries themselves cannot be template arguments.
+ *          Tokens are resolved while compiling, so no variant dispatch is left at runtime and strings are compared against constants.
+ *          Operands must be strings, lambdas are rejected at compile time.
+ *
+ * @code
+ * constexpr auto selector = query::specialize<[]{return query_t<8>{}/"item"*match_attr({"id"})*accept();}>;
+ * selector.run(tree.root(),[](auto node){...; return true;});
+ * @endcode
+ */
+template<auto F>
+struct specialized_t{
+    static constexpr auto program = details::flatten<F>();
+
+    /**
+     * @brief Run the query from root, calling `sink` for each match in the same order of `is`.
+     * @param sink callable receiving a `wrp::base_t<unknown_t>`, returning false to stop the evaluation.
+     * @return false if stopped by the sink, true otherwise.
+     */
+    template<typename Sink>
+    static inline bool run(wrp::base_t<unknown_t> root, Sink&& sink){
+        return details::static_step<program,0>(root,sink);
+    }
+};
+
+template<auto F>
+inline constexpr specialized_t<F> specialize{};
+
+}
+}
@@ -11,14 +11,19 @@
  */
 
 //Temporary add custom implementation here later
+#include <algorithm>
 #include <cstddef>
 #include <generator>
+#include <string>
 #include <functional>
+#include <span>
 #include <string_view>
+#include <type_traits>
 #include <variant>
 #include <vector>
 #include <vs-xml/commons.hpp>
 #include <vs-xml/wrp-node.hpp>
+#include <vs-xml/query-new.hpp>
 
 namespace VS_XML_NS{
 namespace query{
@@ -173,7 +178,7 @@ struct token_t{
         /*type_filter*/
         TYPE,
         /*Unary sv*/
-        MATCH_NS, MATCH_NAME, MATCH_VALUE, MATCH_ALL_TEXT,
+        MATCH_NS, MATCH_NAME, MATCH_VALUE, MATCH_ALL_TEXT, MATCH_TEXT_PREFIX, MATCH_TEXT_CONTAINS,
         /*Attr*/
         MATCH_ATTR
     };
@@ -211,6 +216,8 @@ struct token_t{
             single_t<MATCH_NAME>,
             single_t<MATCH_VALUE>,
             single_t<MATCH_ALL_TEXT>,
+            single_t<MATCH_TEXT_PREFIX>,
+            single_t<MATCH_TEXT_CONTAINS>,
             attr_t<MATCH_ATTR>
         > ;
 
@@ -252,12 +259,28 @@ constexpr static token_t match_all_text(token_t::single_t<token_t::MATCH_ALL_TEX
     return {arg};
 }
 
+constexpr static token_t match_text_prefix(token_t::single_t<token_t::MATCH_TEXT_PREFIX> arg) {
+    return {arg};
+}
+
+constexpr static token_t match_text_contains(token_t::single_t<token_t::MATCH_TEXT_CONTAINS> arg) {
+    return {arg};
+}
+
 constexpr static token_t match_attr(token_t::attr_t<token_t::MATCH_ATTR> arg) {
     return {arg};
 }
 
 
-extern std::pair<std::string_view, std::string_view> split_on_colon(std::string_view input);
+constexpr inline std::pair<std::string_view, std::string_view> split_on_colon(std::string_view input) {
+    std::size_t pos = input.find(':');
+    if (pos == std::string_view::npos) {
+        // No colon found: return the whole string and an empty view.
+        return {{}, input};
+    } else {
+        return {input.substr(0, pos), input.substr(pos + 1)};
+    }
+}
 
 template<size_t N>
 struct query_t{
@@ -347,21 +370,22 @@ inline result_t operator&(result_t&& src, const query_t<N>& query){return is(std
 
 //TODO: not tested
 
+/**
+ * @brief True if the query has at least one match on root. The evaluation stops at the first one.
+ */
+template<size_t N=0>
+bool exists(wrp::base_t<unknown_t> root, const query_t<N>& query);
+
 template<size_t N=0>
 inline result_t has(wrp::base_t<unknown_t> root, const query_t<N>& query) {
-    auto b = false;
-    for(auto c : is<N>(root, query.tokens.begin(), query.tokens.end())){b=true;break;}
-    if(b)co_yield root;
+    if(exists<N>(root, query))co_yield root;
     co_return;
 }
 
 template<size_t N=0>
 inline result_t has(result_t&& src, const query_t<N>& query) {
     for(auto element : src){
-        //Does this stop after the first match is found, as that is sufficient? Should we also return those matches somehow?
-        auto b = false;
-        for(auto c : is<N>(element, query.tokens.begin(), query.tokens.end())){b=true;break;}
-        if(b)co_yield element;
+        if(exists<N>(element, query))co_yield element;
     }
     co_return;
 }
@@ -369,9 +393,49 @@ inline result_t has(result_t&& src, const query_t<N>& query) {
 template<size_t N=0>
 inline result_t operator|(wrp::base_t<unknown_t> src, const query_t<N>& query){return has(src,query);}
 
+/**
+ * @brief Callback receiving the matches of a batch of queries, tagged with the position of the query producing them.
+ * @details Return false to stop the evaluation.
+ */
+typedef bool(*batch_sink_t)(size_t query, wrp::base_t<unknown_t> node, void* ctx);
+
+/**
+ * @brief Run a set of queries on root with a single traversal of its subtree.
+ * @details Queries are evaluated together as one automaton, whose states are pairs of query and token.
+ *          Matches are reported in document order, each node at most once per query.
+ *
+ * @param root the node from which all queries are evaluated.
+ * @param queries the queries to run.
+ * @param sink the function called for each match.
+ * @param ctx context passed to sink.
+ * @return false if stopped by the sink, true otherwise.
+ */
+template<size_t N=0>
+bool batch(wrp::base_t<unknown_t> root, std::type_identity_t<std::span<const query_t<N>>> queries, batch_sink_t sink, void* ctx=nullptr);
+
+template<size_t N=0>
+inline bool batch(wrp::base_t<unknown_t> root, std::type_identity_t<std::span<const query_t<N>>> queries, std::function<bool(size_t, wrp::base_t<unknown_t>)>&& sink){
+    return batch<N>(root,queries,+[](size_t query, wrp::base_t<unknown_t> node, void* ctx){
+        return (*(std::function<bool(size_t, wrp::base_t<unknown_t>)>*)ctx)(query,node);
+    },&sink);
+}
+
 template<size_t N=0>
 inline result_t operator|(result_t&& src, const query_t<N>& query){return has(std::move(src),query);}
 
+/**
+ * @brief Count the matches of a query on root, without generating them.
+ * @details Same matches of `batch` for a single query, so each node is counted once.
+ */
+template<size_t N=0>
+size_t count(wrp::base_t<unknown_t> root, const query_t<N>& query);
+
+/**
+ * @brief Matches of a query on root in document order, skipping the first `skip` and stopping once `n` are collected.
+ */
+template<size_t N=0>
+std::vector<wrp::base_t<unknown_t>> first_n(wrp::base_t<unknown_t> root, const query_t<N>& query, size_t n, size_t skip=0);
+
 }
 }
 
@@ -394,6 +458,117 @@ namespace VS_XML_NS{
         return false;
     }
     
+    static inline bool text_helper(const auto& pattern, wrp::base_t<unknown_t> root, text_mode_t mode){
+        if(std::holds_alternative<std::string_view>(pattern)){
+            return match_all_text(root.tree(),(const unknown_t*)root,std::get<std::string_view>(pattern),mode);
+        }
+        else if(std::holds_alternative<std::function<bool(std::string_view)>>(pattern)){
+            //Predicates need the whole text at once, so it must be collected.
+            if(root.type()!=type_t::ELEMENT)return false;
+            std::string text;
+            for(auto child : root.children()){
+                if(child.type()!=type_t::TEXT && child.type()!=type_t::CDATA)continue;
+                std::string_view chunk = *child.value();
+                if(root.tree().config().raw_strings){
+                    for(auto c : serialize::unescaped_view(chunk))text.push_back(c);
+                }
+                else text.append(chunk);
+            }
+            return std::get<std::function<bool(std::string_view)>>(pattern)(text);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Evaluate the filter token in `current` on `root`.
+     * @details Consecutive attribute matches are consumed together, leaving `current` on the last of them.
+     * @return false if the filter fails, or if `current` is not a filter.
+     */
+    template<typename It>
+    static inline bool filter_helper(wrp::base_t<unknown_t> root, It& current, It end){
+        //Filter based on type
+        if (std::holds_alternative<token_t::type_filter_t<token_t::TYPE>>(current->args)) {
+            auto type = std::get<token_t::type_filter_t<token_t::TYPE>>(current->args);
+            bool match = false;
+            switch(root.type()){
+                case type_t::ELEMENT:
+                    if(type.is_element)match=true;
+                    break;
+                case type_t::TEXT:
+                    if(type.is_text)match=true;
+                    break;
+                case type_t::CDATA:
+                    if(type.is_cdata)match=true;
+                    break;
+                case type_t::COMMENT:
+                    if(type.is_comment)match=true;
+                    break;
+                case type_t::PROC:
+                    if(type.is_proc)match=true;
+                    break;
+                case type_t::MARKER:
+                    if(type.is_marker)match=true;
+                    break;
+                default:
+                    break;
+            }
+            if(!match) return false;   //All matches failing. Fail branch.
+        }
+        //Match NS
+        else if ( std::holds_alternative<token_t::single_t<token_t::MATCH_NS>>(current->args) ){
+            if(!expr_helper(std::get<token_t::single_t<token_t::MATCH_NS>>(current->args),root.ns())) return false; 
+        }
+        //Match name
+        else if ( std::holds_alternative<token_t::single_t<token_t::MATCH_NAME>>(current->args) ){
+            if(!expr_helper(std::get<token_t::single_t<token_t::MATCH_NAME>>(current->args),root.name())) return false; 
+        }
+        //Match value
+        else if ( std::holds_alternative<token_t::single_t<token_t::MATCH_VALUE>>(current->args) ){
+            if(!expr_helper(std::get<token_t::single_t<token_t::MATCH_VALUE>>(current->args),root.value())) return false; 
+        }
+        //Match text, streamed over TEXT and CDATA children with no intermediate buffer.
+        else if ( std::holds_alternative<token_t::single_t<token_t::MATCH_ALL_TEXT>>(current->args) ){
+            if(!text_helper(std::get<token_t::single_t<token_t::MATCH_ALL_TEXT>>(current->args),root,text_mode_t::EXACT)) return false;
+        }
+        else if ( std::holds_alternative<token_t::single_t<token_t::MATCH_TEXT_PREFIX>>(current->args) ){
+            if(!text_helper(std::get<token_t::single_t<token_t::MATCH_TEXT_PREFIX>>(current->args),root,text_mode_t::PREFIX)) return false;
+        }
+        else if ( std::holds_alternative<token_t::single_t<token_t::MATCH_TEXT_CONTAINS>>(current->args) ){
+            if(!text_helper(std::get<token_t::single_t<token_t::MATCH_TEXT_CONTAINS>>(current->args),root,text_mode_t::CONTAINS)) return false;
+        }
+        //Match attributes
+        //Consecutive attribute matches are tested together, in a single pass over the attributes of root.
+        else if (std::holds_alternative<token_t::attr_t<token_t::MATCH_ATTR>>(current->args)) {
+            if(root.type()!=type_t::ELEMENT)return false;
+
+            //Gather up to 64 consecutive tokens, any further one is handled by the next iteration.
+            auto last = current;
+            size_t count = 0;
+            while(last!=end && count<64 && std::holds_alternative<token_t::attr_t<token_t::MATCH_ATTR>>(last->args)){last++;count++;}
+
+            uint64_t full = (count==64)?~(uint64_t)0:(((uint64_t)1<<count)-1);
+            uint64_t satisfied = 0;
+            for(auto& attr: root.attrs()){
+                size_t i = 0;
+                for(auto it = current; it!=last; it++, i++){
+                    if((satisfied>>i)&1)continue;
+                    const auto& pattern = std::get<token_t::attr_t<token_t::MATCH_ATTR>>(it->args);
+                    if(expr_helper(pattern.ns,attr.ns()) && expr_helper(pattern.name,attr.name()) && expr_helper(pattern.value,attr.value())){
+                        satisfied|=(uint64_t)1<<i;
+                    }
+                }
+                if(satisfied==full)break;
+            }
+            if(satisfied!=full)return false;
+            current = last-1;
+        }
+        else{
+            //Failed commands will prevent propagation.
+            return false;
+        }
+        return true;
+    }
+
     template<size_t N>
     result_t is(wrp::base_t<unknown_t> root, typename query_t<N>::container_type::const_iterator begin, typename query_t<N>::container_type::const_iterator end) {
         for(auto current = begin;current!=end;current++){
@@ -422,81 +597,109 @@ namespace VS_XML_NS{
                 }
                 else co_return;
             }
-            //Filter based on type
-            else if (std::holds_alternative<token_t::type_filter_t<token_t::TYPE>>(current->args)) {
-                auto type = std::get<token_t::type_filter_t<token_t::TYPE>>(current->args);
-                bool match = false;
-                switch(root.type()){
-                    case type_t::ELEMENT:
-                        if(type.is_element)match=true;
-                        break;
-                    case type_t::TEXT:
-                        if(type.is_text)match=true;
-                        break;
-                    case type_t::CDATA:
-                        if(type.is_cdata)match=true;
-                        break;
-                    case type_t::COMMENT:
-                        if(type.is_comment)match=true;
-                        break;
-                    case type_t::PROC:
-                        if(type.is_proc)match=true;
-                        break;
-                    case type_t::MARKER:
-                        if(type.is_marker)match=true;
-                        break;
-                    default:
-                        break;
-                }
-                if(!match) co_return;   //All matches failing. Fail branch.
-            }
-            //Match NS
-            else if ( std::holds_alternative<token_t::single_t<token_t::MATCH_NS>>(current->args) ){
-                if(!expr_helper(std::get<token_t::single_t<token_t::MATCH_NS>>(current->args),root.ns())) co_return; 
-            }
-            //Match name
-            else if ( std::holds_alternative<token_t::single_t<token_t::MATCH_NAME>>(current->args) ){
-                if(!expr_helper(std::get<token_t::single_t<token_t::MATCH_NAME>>(current->args),root.name())) co_return; 
-            }
-            //Match value
-            else if ( std::holds_alternative<token_t::single_t<token_t::MATCH_VALUE>>(current->args) ){
-                if(!expr_helper(std::get<token_t::single_t<token_t::MATCH_VALUE>>(current->args),root.value())) co_return; 
+            else if(!filter_helper(root,current,end)){
+                co_return;
             }
-            //Match text, not implemented as .text() is missing upstream.
-            /*
-            else if ( std::holds_alternative<token_t::single_t<token_t::MATCH_ALL_TEXT>>(current->args) ){ 
-                auto pattern = std::get<token_t::single_t<token_t::MATCH_VALUE>>(current->args);
-                auto check = root.text();
-                if(std::holds_alternative<std::string_view>(pattern)){
-                    if(check==std::get<std::string_view>(pattern));
-                    else co_return;
+        }
+    }
+
+    namespace details{
+
+    template<size_t N>
+    struct batch_t{
+        struct state_t{
+            uint32_t query;
+            uint32_t pc;
+
+            friend inline bool operator<(state_t a, state_t b){return a.query<b.query || (a.query==b.query && a.pc<b.pc);}
+            friend inline bool operator==(state_t a, state_t b){return a.query==b.query && a.pc==b.pc;}
+        };
+
+        std::span<const query_t<N>>     queries;
+        batch_sink_t                    sink;
+        void*                           ctx;
+        std::vector<state_t>            pool;   //Active states for each level of the visit, stacked.
+        std::vector<const unknown_t*>   last;   //Last node reported for each query.
+
+        //Run a state on node, pushing the states for its children. Returns false if the sink requested to stop.
+        bool step(wrp::base_t<unknown_t> node, state_t state){
+            const auto& tokens = queries[state.query].tokens;
+            auto end = tokens.end();
+            for(auto current = tokens.begin()+state.pc; current!=end; current++){
+                if (std::holds_alternative<token_t::empty_t<token_t::ACCEPT>>(current->args)) {
+                    if(last[state.query]==(const unknown_t*)node)return true;
+                    last[state.query]=(const unknown_t*)node;
+                    return sink(state.query,node,ctx);
                 }
-                else if(std::holds_alternative<std::function<bool(std::string_view)>>(pattern)){
-                    if(std::get<std::function<bool(std::string_view)>>(pattern)(check));
-                    else co_return;
+                else if (std::holds_alternative<token_t::empty_t<token_t::NEXT>>(current->args)) {
+                    if(node.type()==type_t::ELEMENT)pool.push_back({state.query,(uint32_t)(current+1-tokens.begin())});
+                    return true;
                 }
-                else co_return;
-            }
-            */
-            //TODO: right now attribute matching has k*O(n) complexity if k attributes must be tested.
-            //By looking ahead it is possible to check if there are more attributes to be tested, and perform the operation in just O(n)
-            //Match attribute
-            else if (std::holds_alternative<token_t::attr_t<token_t::MATCH_ATTR>>(current->args)) {
-                auto pattern = std::get<token_t::attr_t<token_t::MATCH_ATTR>>(current->args);
-                bool found = false;
-                if(root.type()!=type_t::ELEMENT)co_return;
-                for(auto& attr: root.attrs()){
-                    if(expr_helper(pattern.ns,attr.ns()) && expr_helper(pattern.name,attr.name()) && expr_helper(pattern.value,attr.value())){
-                        found=true;break;
-                    }
+                else if (std::holds_alternative<token_t::empty_t<token_t::FORK>>(current->args)) {
+                    if(node.type()!=type_t::ELEMENT)return true;
+                    pool.push_back({state.query,(uint32_t)(current-tokens.begin())});
                 }
-                if(!found)co_return;
+                else if(!filter_helper(node,current,end))return true;
             }
-            else{
-                //Failed commands will prevent propagation.
-                co_return;
+            return true;
+        }
+
+        bool visit(wrp::base_t<unknown_t> node, size_t states_first, size_t states_last){
+            size_t children_first = pool.size();
+            for(size_t i=states_first;i<states_last;i++){
+                if(!step(node,pool[i]))return false;
             }
+
+            if(pool.size()!=children_first){
+                //Duplicated states would only repeat the same work.
+                std::sort(pool.begin()+children_first,pool.end());
+                pool.erase(std::unique(pool.begin()+children_first,pool.end()),pool.end());
+                size_t children_last = pool.size();
+                for(auto child : node.children()){
+                    if(!visit(child,children_first,children_last))return false;
+                }
+            }
+            pool.resize(children_first);
+            return true;
         }
+    };
+
+    }
+
+    template<size_t N>
+    bool batch(wrp::base_t<unknown_t> root, std::type_identity_t<std::span<const query_t<N>>> queries, batch_sink_t sink, void* ctx){
+        details::batch_t<N> engine{queries,sink,ctx,{},std::vector<const unknown_t*>(queries.size(),nullptr)};
+        for(size_t i=0;i<queries.size();i++)engine.pool.push_back({(uint32_t)i,0});
+        return engine.visit(root,0,queries.size());
+    }
+
+    template<size_t N>
+    size_t count(wrp::base_t<unknown_t> root, const query_t<N>& query){
+        size_t ret = 0;
+        batch<N>(root,{&query,1},+[](size_t, wrp::base_t<unknown_t>, void* ctx){(*(size_t*)ctx)++;return true;},&ret);
+        return ret;
+    }
+
+    template<size_t N>
+    bool exists(wrp::base_t<unknown_t> root, const query_t<N>& query){
+        return !batch<N>(root,{&query,1},+[](size_t, wrp::base_t<unknown_t>, void*){return false;});
+    }
+
+    template<size_t N>
+    std::vector<wrp::base_t<unknown_t>> first_n(wrp::base_t<unknown_t> root, const query_t<N>& query, size_t n, size_t skip){
+        struct ctx_t{
+            std::vector<wrp::base_t<unknown_t>> ret;
+            size_t n;
+            size_t skip;
+        } ctx{{},n,skip};
+        if(n==0)return {};
+        batch<N>(root,{&query,1},+[](size_t, wrp::base_t<unknown_t> node, void* ctx){
+            auto& c = *(ctx_t*)ctx;
+            if(c.skip!=0){c.skip--;return true;}
+            c.ret.push_back(node);
+            return c.ret.size()<c.n;
+        },&ctx);
+        return std::move(ctx.ret);
     }
     
 }
@@ -0,0 +1,156 @@
+#pragma once
+
+/**
+ * @file subtree-stats.hpp
+ * @author karurochari
+ * @brief Summaries of large subtrees (size, depth and labels), used to skip them when they cannot contain a match.
+ * @date 2025-06-27
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#include <expected>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <vs-xml/commons.hpp>
+#include <vs-xml/node.hpp>
+#include <vs-xml/tree.hpp>
+
+namespace VS_XML_NS{
+
+/**
+ * @brief Side table of summaries for the elements of a tree, keyed by their offset.
+ * @details Only elements spanning at least `min_extent` bytes get a summary, since smaller subtrees are cheaper to visit than to look up.
+ *          Each summary holds the number of nodes below the element, their maximum depth relative to it, and a Bloom filter of their labels.
+ *          Stored next to its tree as a SUBTREE_STATS extension, see extension_kind_t.
+ */
+struct SubtreeStats{
+    struct header_t{
+        uint8_t  magic[4] = {'$','X','S','S'};
+        uint8_t  words = 2;             //Size of each Bloom filter, in 64bit words.
+        uint8_t  res[3] = {};
+        uint32_t res1 = 0;
+        uint64_t entries = 0;
+        uint64_t min_extent = 0;        //Minimum size in bytes of the subtrees with a summary.
+    };
+    static_assert(sizeof(header_t)==32, "header_t is expected to be 32 bytes");
+
+    ///Fixed part of each entry, followed by `words` words of Bloom filter. Entries are sorted by offset.
+    struct entry_t{
+        uint64_t offset;                //Of the element, from the beginning of the tree buffer.
+        uint64_t nodes;                 //Number of nodes below the element, attributes excluded.
+        uint32_t depth;                 //Maximum depth below the element, 0 if it has no children.
+        uint32_t res = 0;
+    };
+    static_assert(sizeof(entry_t)==24, "entry_t is expected to be 24 bytes");
+
+    ///View over one entry.
+    struct summary_t{
+        const entry_t*  entry;
+        const uint8_t*  bloom;
+        uint8_t         words;
+
+        [[nodiscard]] inline uint64_t nodes() const{return entry->nodes;}
+        [[nodiscard]] inline uint32_t depth() const{return entry->depth;}
+
+        ///False if no element below has the label with this key (see `SubtreeStats::key`). True means it might.
+        [[nodiscard]] inline bool may_contain(uint64_t key) const{
+            for(size_t i=0;i<3;i++){
+                auto bit = SubtreeStats::bit(key,i,words);
+                if(!((bloom[bit/8]>>(bit%8))&1))return false;
+            }
+            return true;
+        }
+    };
+
+    enum struct from_binary_error_t{
+        OK,
+        Missing,
+        HeaderTooSmall,
+        MagicMismatch,
+        TruncatedSpan,
+        OutOfBounds,
+    };
+
+    /**
+     * @brief Build the summaries for a tree with a single visit.
+     *
+     * @param tree the tree to summarize.
+     * @param min_extent minimum size in bytes of the elements getting a summary.
+     * @param words size of each Bloom filter in 64bit words, between 1 and 8.
+     */
+    [[nodiscard]] static SubtreeStats build(const TreeRaw& tree, size_t min_extent = 4096, uint8_t words = 2);
+
+    /**
+     * @brief Load the summaries attached to a binary as extension, for the document in position `doc`.
+     * @details Data is not copied, so `region` must outlive the index.
+     */
+    [[nodiscard]] static std::expected<SubtreeStats,from_binary_error_t> from_binary(std::span<const uint8_t> region, uint32_t doc = 0);
+
+    ///Key of a label for any namespace.
+    [[nodiscard]] static constexpr inline uint64_t key(std::string_view name){return hash(name,0xcbf29ce484222325ull);}
+
+    ///Key of a label for a specific namespace.
+    [[nodiscard]] static constexpr inline uint64_t key(std::string_view ns, std::string_view name){return hash(name,hash(ns,0x84222325cbf29ce4ull)^':');}
+
+    ///The binary representation of this index.
+    [[nodiscard]] inline std::span<const uint8_t> bytes() const{return data;}
+
+    ///Side section to pass to `save_binary` for this index to be stored along with its tree.
+    [[nodiscard]] inline binary_extension_t extension(uint32_t doc = 0) const{return {extension_kind_t::SUBTREE_STATS,doc,data};}
+
+    [[nodiscard]] inline const header_t& header() const{return *(const header_t*)data.data();}
+
+    ///Number of summaries.
+    [[nodiscard]] inline size_t size() const{return header().entries;}
+
+    ///Summary in position `i`.
+    [[nodiscard]] inline summary_t at(size_t i) const{
+        const uint8_t* e = data.data()+sizeof(header_t)+stride()*i;
+        return {(const entry_t*)e,e+sizeof(entry_t),header().words};
+    }
+
+    ///Summary of an element, if it has one.
+    [[nodiscard]] inline std::optional<summary_t> find(const TreeRaw& tree, const unknown_t* node) const{
+        if((uint64_t)((const uint8_t*)node->next()-(const uint8_t*)node)<header().min_extent)return {};
+        uint64_t offset = (const uint8_t*)node-(const uint8_t*)&tree.root();
+        size_t lo = 0, hi = size();
+        while(lo<hi){
+            size_t mid = lo+(hi-lo)/2;
+            if(at(mid).entry->offset<offset)lo=mid+1;
+            else hi=mid;
+        }
+        if(lo<size() && at(lo).entry->offset==offset)return at(lo);
+        return {};
+    }
+
+    SubtreeStats(SubtreeStats&&) = default;
+    SubtreeStats& operator=(SubtreeStats&&) = default;
+    SubtreeStats(const SubtreeStats&) = delete;
+    SubtreeStats& operator=(const SubtreeStats&) = delete;
+
+    private:
+        std::vector<uint8_t>        owned;      //Empty when `data` points into a binary.
+        std::span<const uint8_t>    data;
+
+        inline size_t stride() const{return sizeof(entry_t)+8*header().words;}
+
+        static constexpr inline uint64_t hash(std::string_view s, uint64_t h){return fnv1a(s,h);}
+
+        //Position of the i-th bit set by a key in a filter of `words` words.
+        static constexpr inline size_t bit(uint64_t key, size_t i, uint8_t words){
+            return ((key>>(i*21))&0x1fffff)%(64*words);
+        }
+
+        inline SubtreeStats(std::vector<uint8_t>&& src):owned(std::move(src)),data(owned){}
+        inline SubtreeStats(std::span<const uint8_t> src):data(src){}
+};
+
+}
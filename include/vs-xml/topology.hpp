@@ -0,0 +1,170 @@
+#pragma once
+
+/**
+ * @file topology.hpp
+ * @author karurochari
+ * @brief Side arrays with the pre-order position, subtree end and depth of each node, for constant time structural checks.
+ * @date 2025-06-28
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <expected>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <vs-xml/commons.hpp>
+#include <vs-xml/node.hpp>
+#include <vs-xml/postings.hpp>
+#include <vs-xml/tree.hpp>
+
+namespace VS_XML_NS{
+
+/**
+ * @brief Structure of a tree as flat arrays indexed by the pre-order position (id) of each node.
+ * @details Ids of nodes are found in constant time from their address, via a bitvector marking where nodes start in the buffer and its rank directory.
+ *          For each id, the id where its subtree ends and its depth are stored, so that `is_ancestor` and `depth` are constant time.
+ *          Level ancestors are found by bisection on the ids of the nodes at that depth, in logarithmic time.
+ *          Attributes are not nodes, so they have no id.
+ *          Stored next to its tree as a TOPOLOGY extension, see extension_kind_t.
+ */
+struct Topology{
+    struct header_t{
+        uint8_t  magic[4] = {'$','X','T','P'};
+        uint8_t  width = 4;             //Size in bytes of ids and offsets, either 4 or 8.
+        uint8_t  depth_width = 2;       //Size in bytes of depths, either 2 or 4.
+        uint8_t  granule = 3;           //Log2 of the alignment of nodes, each bit of `starts` covering one granule.
+        uint8_t  res = 0;
+        uint32_t max_depth = 0;
+        uint32_t res1 = 0;
+        uint64_t nodes = 0;
+        uint64_t words = 0;             //Size of `starts`, in 64bit words.
+    };
+    static_assert(sizeof(header_t)==32, "header_t is expected to be 32 bytes");
+
+    ///Id used for missing nodes.
+    static constexpr size_t npos = SIZE_MAX;
+
+    enum struct from_binary_error_t{
+        OK,
+        Missing,
+        HeaderTooSmall,
+        MagicMismatch,
+        TruncatedSpan,
+        OutOfBounds,
+    };
+
+    ///Build the arrays for a tree with a single visit.
+    [[nodiscard]] static Topology build(const TreeRaw& tree);
+
+    /**
+     * @brief Load the arrays attached to a binary as extension, for the document in position `doc`.
+     * @details Data is not copied, so `region` must outlive the index.
+     */
+    [[nodiscard]] static std::expected<Topology,from_binary_error_t> from_binary(std::span<const uint8_t> region, uint32_t doc = 0);
+
+    ///The binary representation of this index.
+    [[nodiscard]] inline std::span<const uint8_t> bytes() const{return data;}
+
+    ///Side section to pass to `save_binary` for this index to be stored along with its tree.
+    [[nodiscard]] inline binary_extension_t extension(uint32_t doc = 0) const{return {extension_kind_t::TOPOLOGY,doc,data};}
+
+    [[nodiscard]] inline const header_t& header() const{return *(const header_t*)data.data();}
+
+    ///Number of nodes.
+    [[nodiscard]] inline size_t size() const{return header().nodes;}
+
+    ///Id of a node, or npos if `node` is not the beginning of a node of the tree.
+    [[nodiscard]] inline size_t id(const TreeRaw& tree, const unknown_t* node) const{
+        uint64_t offset = (const uint8_t*)node-(const uint8_t*)&tree.root();
+        if((offset&((1ull<<header().granule)-1))!=0)return npos;
+        uint64_t slot = offset>>header().granule;
+        if(slot>=header().words*64)return npos;
+        auto w = word(slot/64);
+        if(!((w>>(slot%64))&1))return npos;
+        //Rank: samples every 8 words, then popcount of the words in between.
+        size_t block = slot/512;
+        uint64_t rank = sample(block);
+        for(size_t i=block*8;i<slot/64;i++)rank+=std::popcount(word(i));
+        return rank+std::popcount(w&((1ull<<(slot%64))-1));
+    }
+
+    ///Node with a given id.
+    [[nodiscard]] inline const unknown_t* node(const TreeRaw& tree, size_t id) const{
+        return (const unknown_t*)((const uint8_t*)&tree.root()+offsets()[id]);
+    }
+
+    ///Id right after the last node in the subtree of `id`.
+    [[nodiscard]] inline size_t end(size_t id) const{return ends()[id];}
+
+    ///Depth of a node, 0 for the root. `id` must be less than `size()`.
+    [[nodiscard]] inline uint32_t depth(size_t id) const{
+        const uint8_t* base = arrays()+2*header().width*size();
+        if(header().depth_width==2){uint16_t v;std::memcpy(&v,base+2*id,2);return v;}
+        else{uint32_t v;std::memcpy(&v,base+4*id,4);return v;}
+    }
+
+    ///True if `a` is a proper ancestor of `b`.
+    [[nodiscard]] inline bool is_ancestor(size_t a, size_t b) const{return a<b && b<size() && b<end(a);}
+
+    ///Ancestor of `id` at a given depth (the node itself if it is the depth of `id`), or npos if deeper than `id` or if `id` is not valid.
+    [[nodiscard]] inline size_t ancestor(size_t id, uint32_t level) const{
+        if(id>=size() || level>depth(id))return npos;
+        //Nodes at the same depth are sorted by id, and the ancestor is the last of them before `id`.
+        auto list = levels();
+        size_t lo = level_first(level), hi = level_first(level+1);
+        while(lo<hi){
+            size_t mid = lo+(hi-lo)/2;
+            if(list[mid]<=id)lo=mid+1;
+            else hi=mid;
+        }
+        return list[lo-1];
+    }
+
+    ///Depth of a node of the tree, if it has an id.
+    [[nodiscard]] inline std::optional<uint32_t> depth(const TreeRaw& tree, const unknown_t* node) const{
+        auto i = id(tree,node);
+        if(i==npos)return {};
+        return depth(i);
+    }
+
+    ///True if `a` is a proper ancestor of `b`, both being nodes of the tree. False if any of them has no id.
+    [[nodiscard]] inline bool is_ancestor(const TreeRaw& tree, const unknown_t* a, const unknown_t* b) const{return is_ancestor(id(tree,a),id(tree,b));}
+
+    ///Ancestor of a node of the tree at a given depth, or nullptr if deeper than `node` or if `node` has no id.
+    [[nodiscard]] inline const unknown_t* ancestor(const TreeRaw& tree, const unknown_t* node, uint32_t level) const{
+        auto a = ancestor(id(tree,node),level);
+        return a==npos?nullptr:this->node(tree,a);
+    }
+
+    Topology(Topology&&) = default;
+    Topology& operator=(Topology&&) = default;
+    Topology(const Topology&) = delete;
+    Topology& operator=(const Topology&) = delete;
+
+    private:
+        std::vector<uint8_t>        owned;      //Empty when `data` points into a binary.
+        std::span<const uint8_t>    data;
+
+        //Layout: starts (words), rank samples (one every 8 words), first position of each level (max_depth+2), then packed arrays.
+        inline size_t samples_count() const{return (header().words+7)/8;}
+        inline uint64_t word(size_t i) const{uint64_t v;std::memcpy(&v,data.data()+sizeof(header_t)+8*i,8);return v;}
+        inline uint64_t sample(size_t i) const{uint64_t v;std::memcpy(&v,data.data()+sizeof(header_t)+8*(header().words+i),8);return v;}
+        inline uint64_t level_first(size_t i) const{uint64_t v;std::memcpy(&v,data.data()+sizeof(header_t)+8*(header().words+samples_count()+i),8);return v;}
+        inline const uint8_t* arrays() const{return data.data()+sizeof(header_t)+8*(header().words+samples_count()+header().max_depth+2);}
+        inline postings_t offsets() const{return {arrays(),header().width};}
+        inline postings_t ends() const{return {arrays()+header().width*size(),header().width};}
+        inline postings_t levels() const{return {arrays()+2*header().width*size()+header().depth_width*size(),header().width};}
+
+        inline Topology(std::vector<uint8_t>&& src):owned(std::move(src)),data(owned){}
+        inline Topology(std::span<const uint8_t> src):data(src){}
+};
+
+}
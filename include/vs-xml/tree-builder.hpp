@@ -16,12 +16,14 @@
 
 #include <expected>
 #include <functional>
+#include <optional>
 #include <utility>
 
 #include <vs-xml/fwd/unordered_set.hpp>
 #include <vector>
 #include <string_view>
 
+#include <vs-xml/arena.hpp>
 #include <vs-xml/commons.hpp>
 #include <vs-xml/tree.hpp>
 #include <vs-xml/node.hpp>
@@ -93,6 +95,26 @@ namespace details{
     };
 
 
+    ///Nodes of a builder, in a vector unless a sparse arena was requested (see TreeBuilder::reserve).
+    struct node_buffer_t{
+        std::vector<uint8_t>        vector;
+        std::optional<SparseArena>  arena;
+
+        inline uint8_t* data(){return arena.has_value()?arena->data():vector.data();}
+        inline size_t size() const{return arena.has_value()?arena->size():vector.size();}
+        inline uint8_t* end(){return data()+size();}
+        inline void resize(size_t size){
+            if(arena.has_value())arena->resize(size);
+            else vector.resize(size);
+        }
+
+        ///Move the content to an arena reserving `reserve` bytes, so that it never moves again.
+        void make_sparse(size_t reserve);
+
+        ///The content as a vector, which is copied if stored in an arena.
+        std::vector<uint8_t> take_vector();
+    };
+
     struct BuilderBase{
         enum struct error_t{
             SKIP = -1,
@@ -102,10 +124,11 @@ namespace details{
             STACK_EMPTY,
             MISFORMED,
             FRAME_ERROR,
+            TOO_LARGE,          //Limits of the binary representation exceeded, like the number of documents of an archive.
         };
     
         protected:
-            std::vector<uint8_t> buffer;
+            node_buffer_t buffer;
 
             bool open = true;               //True if the tree is still open to append things.
             bool attribute_block = false;   //True after a begin to add attributes. It is automatically closed when any other command is triggered.
@@ -136,6 +159,13 @@ namespace details{
     
             //TODO: injection can be a simple memcpy if the symbols space is shared, or require full tree refactoring.
             error_t inject(const TreeRaw& tree, const unknown_t* base = nullptr, bool include_root = false);
+
+            /**
+             * @brief Visit all symbol references (names, namespaces and values) of the nodes laid out in `frame`, allowing them to be rewritten.
+             * @details Used to relocate symbols when buffers built with different tables are merged.
+             * @return false if a node of unknown type was found, and the visit interrupted.
+             */
+            static bool remap_symbols(std::span<uint8_t> frame, void(*fn)(sv& ref, void* ctx), void* ctx);
     };
     
 }
@@ -159,6 +189,26 @@ struct TreeBuilder : details::BuilderBase{
             return tmp;
         }
         inline auto rsv(auto a){return symbols.rsv(a);}
+
+        //Move nodes and symbols into a stored tree or document, keeping the arena as its storage if one is used.
+        template<typename T>
+        inline T take(){
+            auto emit = [&](auto&& nodes){
+                if constexpr (
+                    cfg.symbols==builder_config_t::symbols_t::COMPRESS_ALL ||
+                    cfg.symbols==builder_config_t::symbols_t::COMPRESS_LABELS ||
+                    cfg.symbols==builder_config_t::symbols_t::OWNED 
+                )return T(configs,std::move(nodes),std::exchange(symbols.symbols,{}));
+                else return T(configs,std::move(nodes),symbols.symbols.data());
+            };
+            if(buffer.arena.has_value()){
+                SparseArena nodes = std::move(*buffer.arena);
+                buffer.arena.reset();
+                nodes.release();
+                return emit(std::move(nodes));
+            }
+            return emit(std::exchange(buffer.vector,{}));
+        }
         
 
     public:
@@ -211,12 +261,7 @@ struct TreeBuilder : details::BuilderBase{
          */
         [[nodiscard]] std::expected<stored::Tree,error_t> close(){
             if (auto ret = details::BuilderBase::close(); ret != details::BuilderBase::error_t::OK)return std::unexpected(ret);
-            if constexpr (
-                cfg.symbols==builder_config_t::symbols_t::COMPRESS_ALL ||
-                cfg.symbols==builder_config_t::symbols_t::COMPRESS_LABELS ||
-                cfg.symbols==builder_config_t::symbols_t::OWNED 
-            )return stored::Tree(configs,std::exchange(buffer,{}),std::exchange(symbols.symbols,{}));
-            else return stored::Tree(configs,std::exchange(buffer,{}),symbols.symbols.data());
+            return take<stored::Tree>();
         }
 
         /**
@@ -230,12 +275,25 @@ struct TreeBuilder : details::BuilderBase{
             if (auto ret = details::BuilderBase::close(); ret != details::BuilderBase::error_t::OK)return std::unexpected(ret);
             open=true;
             attribute_block=false;
-            stack.push_back({0,-1});
+            //The next frame starts from here, so that its root has no parent outside of it.
+            stack.push_back({(ptrdiff_t)buffer.size(),-1});
             delta_ptr_t cpy_offset = last_offset;
             last_offset=buffer.size();
             return binary_header_t::section_t{{sv_name.base,sv_name.length},cpy_offset,buffer.size()-cpy_offset};
         }
 
+        /**
+         * @brief Drop everything added since the last frame was closed, so that building can resume from a clean state after an error.
+         * @details Symbols recorded in the meanwhile are kept.
+         */
+        inline void discard_frame(){
+            buffer.resize(last_offset);
+            stack.clear();
+            stack.push_back({(ptrdiff_t)last_offset,-1});
+            open=true;
+            attribute_block=false;
+        }
+
         /**
          * @brief It allows to extract symbols if the builder has been closed.
          * @details Not to be used with `close` only with `close_frame`
@@ -243,7 +301,7 @@ struct TreeBuilder : details::BuilderBase{
          */     
         [[nodiscard]] std::optional<std::pair<std::vector<uint8_t>,std::vector<uint8_t>>> extract(){
             details::BuilderBase::close();
-            return std::pair{std::move(buffer),std::move(symbols.symbols)};
+            return std::pair{buffer.take_vector(),std::move(symbols.symbols)};
         }
 
         /**
@@ -287,13 +345,18 @@ struct TreeBuilder : details::BuilderBase{
             size_t buffer;
             size_t symbols;
             size_t symbols_index;
+            bool sparse = false;    //If true, nodes are stored in a SparseArena reserving `buffer` bytes of address space (or its default if 0).
         };
 
         /**
          * @brief Reserves space for the buffer to avoid many of the initial small allocations. Ideally run just after initialization.
+         * @details With `sparse`, nodes are never moved while building and memory is committed page by page, so there is no peak of twice
+         *          the size of the tree when growing, and the arena is kept as storage of the tree returned by `close`.
+         *          Suited for huge single documents, while builders of archives copy nodes out of it when extracted.
          */
         inline void reserve(reserve_t sizes){
-            this->buffer.reserve(sizes.buffer);
+            if(sizes.sparse)this->buffer.make_sparse(sizes.buffer==0?SparseArena::default_reserve:sizes.buffer);
+            else if(!this->buffer.arena.has_value())this->buffer.vector.reserve(sizes.buffer);
             if constexpr(configs.symbols==builder_config_t::OWNED || configs.symbols==builder_config_t::COMPRESS_ALL || configs.symbols==builder_config_t::COMPRESS_LABELS){
                 symbols.symbols.reserve(sizes.symbols);
             }
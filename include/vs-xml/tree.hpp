@@ -22,10 +22,20 @@
 
 #include <ostream>
 
+#include <vs-xml/arena.hpp>
 #include <vs-xml/commons.hpp>
 
 namespace VS_XML_NS{
 
+struct Executor;
+
+namespace details{
+    /**
+     * @brief Write the payloads of extensions and their table, for binaries whose data ends at `offset`.
+     */
+    void save_extensions(std::ostream& out, size_t offset, std::span<const binary_extension_t> extensions);
+}
+
 /**
  * @brief Base class for a tree. 
  * @warning Unless you need MAXIMUM PERFORMANCE, your are better using its derived VS_XML_NS::Tree
@@ -133,6 +143,9 @@ struct TreeRaw{
 
     [[nodiscard]] inline const unknown_t& root() const {return *(const unknown_t*)buffer.data();}
 
+    ///Configuration used when building this tree.
+    [[nodiscard]] inline const builder_config_t& config() const {return configs;}
+
     /**
      * @brief Stream the serialized version of the document onto an output stream.
      * 
@@ -145,11 +158,29 @@ struct TreeRaw{
 
     bool print_fast(std::ostream& out, const print_cfg_t& cfg = {}, const unknown_t* node = nullptr)const;
 
-    bool save_binary(std::ostream& out)const;
+    /**
+     * @brief Save a binary representation of this tree to an output stream.
+     *
+     * @param out Output stream.
+     * @param extensions Side sections (like indices) to be attached to the binary.
+     * @param checksums If true, CRC32C checksums of header, symbols and data are attached as well, see verify_checksums.
+     * @return true if no error was met
+     * @return false else
+     */
+    bool save_binary(std::ostream& out, std::span<const binary_extension_t> extensions = {}, bool checksums = false)const;
 
     [[nodiscard]] static std::expected<TreeRaw, TreeRaw::from_binary_error_t> from_binary(std::span<uint8_t> region);
     [[nodiscard]] static std::expected<const TreeRaw , TreeRaw::from_binary_error_t> from_binary(std::span<const uint8_t> region);
 
+    /**
+     * @brief Check that the content of the tree can be safely traversed, like after loading it from an untrusted source.
+     * @details Every node must lie within the buffer, with parent, previous and next links matching the actual structure,
+     *          and every string view must lie within the symbols. `from_binary` only checks headers, this covers the rest.
+     * @param executor if provided, large trees are checked in parallel, one task for each group of subtrees.
+     * @return TreeOutOfBounds or SymbolsOutOfBounds if any check fails.
+     */
+    [[nodiscard]] std::expected<void, from_binary_error_t> verify(Executor* executor = nullptr) const;
+
     inline std::string_view rsv(sv s) const{
         return std::string_view(s.base+(char*)symbols.data(),s.base+(char*)symbols.data()+s.length);
     }
@@ -265,26 +296,40 @@ template<>
 struct StorageFor<TreeRaw>{
     std::vector<uint8_t> buffer_i;
     std::vector<uint8_t> symbols_i;
+    SparseArena arena_i;    //Used instead of buffer_i by trees built in a sparse arena.
 
-    StorageFor(const builder_config_t& cfg, std::vector<uint8_t>&& buf, std::vector<uint8_t>&& sym):buffer_i(buf),symbols_i(sym){}
-    StorageFor(const builder_config_t& cfg, std::vector<uint8_t>&& buf, const void* label_offset=nullptr):buffer_i(buf){}
+    StorageFor(const builder_config_t& cfg, std::vector<uint8_t>&& buf, std::vector<uint8_t>&& sym):buffer_i(std::move(buf)),symbols_i(std::move(sym)){}
+    StorageFor(const builder_config_t& cfg, std::vector<uint8_t>&& buf, const void* label_offset=nullptr):buffer_i(std::move(buf)){}
 
     static TreeRaw bind(const StorageFor& storage, const builder_config_t& cfg, std::vector<uint8_t>&& src, std::vector<uint8_t>&& sym)  {return TreeRaw(cfg,storage.buffer_i,storage.symbols_i);}
     static TreeRaw bind(const StorageFor& storage, const builder_config_t& cfg, std::vector<uint8_t>&& src, const void* label_offset=nullptr)  {return TreeRaw(cfg,storage.buffer_i, {(uint8_t*)label_offset,std::span<uint8_t>::extent});}
 
+    StorageFor(const builder_config_t& cfg, SparseArena&& buf, std::vector<uint8_t>&& sym):symbols_i(std::move(sym)),arena_i(std::move(buf)){}
+    StorageFor(const builder_config_t& cfg, SparseArena&& buf, const void* label_offset=nullptr):arena_i(std::move(buf)){}
+
+    static TreeRaw bind(const StorageFor& storage, const builder_config_t& cfg, SparseArena&& src, std::vector<uint8_t>&& sym)  {return TreeRaw(cfg,storage.arena_i.bytes(),storage.symbols_i);}
+    static TreeRaw bind(const StorageFor& storage, const builder_config_t& cfg, SparseArena&& src, const void* label_offset=nullptr)  {return TreeRaw(cfg,storage.arena_i.bytes(), {(uint8_t*)label_offset,std::span<uint8_t>::extent});}
+
 };
 
 template<>
 struct StorageFor<Tree>{
     std::vector<uint8_t> buffer_i;
     std::vector<uint8_t> symbols_i;
+    SparseArena arena_i;    //Used instead of buffer_i by trees built in a sparse arena.
 
-    StorageFor(const builder_config_t& cfg, std::vector<uint8_t>&& buf, std::vector<uint8_t>&& sym):buffer_i(buf),symbols_i(sym){}
-    StorageFor(const builder_config_t& cfg, std::vector<uint8_t>&& buf, const void* label_offset=nullptr):buffer_i(buf){}
+    StorageFor(const builder_config_t& cfg, std::vector<uint8_t>&& buf, std::vector<uint8_t>&& sym):buffer_i(std::move(buf)),symbols_i(std::move(sym)){}
+    StorageFor(const builder_config_t& cfg, std::vector<uint8_t>&& buf, const void* label_offset=nullptr):buffer_i(std::move(buf)){}
 
     static Tree bind(const StorageFor& storage, const builder_config_t& cfg, std::vector<uint8_t>&& src, std::vector<uint8_t>&& sym)  {return Tree(TreeRaw(cfg,storage.buffer_i,storage.symbols_i));}
     static Tree bind(const StorageFor& storage, const builder_config_t& cfg, std::vector<uint8_t>&& src, const void* label_offset=nullptr)  {return Tree(TreeRaw(cfg,storage.buffer_i, {(uint8_t*)label_offset,std::span<uint8_t>::extent}));}
 
+    StorageFor(const builder_config_t& cfg, SparseArena&& buf, std::vector<uint8_t>&& sym):symbols_i(std::move(sym)),arena_i(std::move(buf)){}
+    StorageFor(const builder_config_t& cfg, SparseArena&& buf, const void* label_offset=nullptr):arena_i(std::move(buf)){}
+
+    static Tree bind(const StorageFor& storage, const builder_config_t& cfg, SparseArena&& src, std::vector<uint8_t>&& sym)  {return Tree(TreeRaw(cfg,storage.arena_i.bytes(),storage.symbols_i));}
+    static Tree bind(const StorageFor& storage, const builder_config_t& cfg, SparseArena&& src, const void* label_offset=nullptr)  {return Tree(TreeRaw(cfg,storage.arena_i.bytes(), {(uint8_t*)label_offset,std::span<uint8_t>::extent}));}
+
 };
 
 namespace stored{
@@ -38,7 +38,7 @@ inline const char* getColorForOffset(size_t offset) {
     else if (offset == 7)                   return colors::magenta;         // endianess/res0 (1 byte)
     else if (offset >= 8 && offset < 12)    return colors::cyan;            // bitfields for sizes (4 bytes)
     else if (offset >= 12 && offset < 14)   return colors::white;           // docs_count (2 bytes)
-    else if (offset >= 14 && offset < 16)   return colors::brightYellow;    // res[2]
+    else if (offset >= 14 && offset < 16)   return colors::brightYellow;    // extensions_count (2 bytes)
     else if (offset >= 16 && offset < 16 + 
            sizeof(VS_XML_NS::xml_count_t))  return colors::brightMagenta;   // length_of_symbols (8 bytes)
     else                                    return colors::reset;           // sections & others
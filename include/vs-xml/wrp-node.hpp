@@ -121,6 +121,9 @@ struct base_t{
 
     inline delta_ptr_t addr() const{return (const uint8_t*)ptr-base->buffer.data();}
 
+    ///The tree hosting this node.
+    inline const TreeRaw& tree() const{return *base;}
+
     inline std::expected<sv,feature_t> ns() const{auto tmp = ptr->ns(); if(!tmp.has_value())return std::unexpected{tmp.error()}; else return sv(*base,*tmp);}
     inline std::expected<sv,feature_t> name() const{auto tmp = ptr->name(); if(!tmp.has_value())return std::unexpected{tmp.error()}; else return sv(*base,*tmp);}
     inline std::expected<sv,feature_t> value() const{auto tmp = ptr->value(); if(!tmp.has_value())return std::unexpected{tmp.error()}; else return sv(*base,*tmp);}
@@ -0,0 +1,105 @@
+#pragma once
+
+/**
+ * @file xpath.hpp
+ * @author karurochari
+ * @brief Compiler from a subset of XPath to flat queries, and a cache of compiled expressions.
+ * @date 2025-06-30
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#include <expected>
+#include <string>
+#include <string_view>
+
+#include <vs-xml/query-builder.hpp>
+#include <vs-xml/query-cache.hpp>
+#include <vs-xml/query-new.hpp>
+
+namespace VS_XML_NS{
+namespace query{
+
+struct xpath_error_t{
+    enum ErrorCode {
+        OK = 0,
+        UNEXPECTED_END,         // "Unexpected end of the expression."
+        UNEXPECTED_TOKEN,       // "Unexpected character in the expression."
+        UNSUPPORTED,            // "Construct not supported by this subset of XPath."
+        BAD_NAME,               // "Expected a name or a node test."
+        BAD_LITERAL,            // "Unterminated string literal."
+        BAD_POSITION,           // "Positions must be integers greater than zero."
+        BUILDER,                // "The query builder rejected the expression."
+    } code;
+    size_t ctx;                 // position in the expression
+    QueryBuilder::error_t builder = QueryBuilder::error_t::OK;
+
+    std::string_view msg() const {
+        switch (code) {
+            case OK:                return "OK";
+            case UNEXPECTED_END:    return "Unexpected end of the expression.";
+            case UNEXPECTED_TOKEN:  return "Unexpected character in the expression.";
+            case UNSUPPORTED:       return "Construct not supported by this subset of XPath.";
+            case BAD_NAME:          return "Expected a name or a node test.";
+            case BAD_LITERAL:       return "Unterminated string literal.";
+            case BAD_POSITION:      return "Positions must be integers greater than zero.";
+            case BUILDER:           return "The query builder rejected the expression.";
+            default:                return "Unknown error.";
+        }
+    }
+};
+
+/**
+ * @brief Append a frame evaluating an XPath expression to a builder.
+ * @details The supported subset is made of location paths with:
+ *          - `/` and `//` separators, and the `child::` and `descendant::` axes;
+ *          - name tests (`name`, `ns:name`, `ns:*`, `*`) and the node tests `text()`, `comment()`, `processing-instruction()` and `node()`;
+ *          - predicates joined by `and`: positions (`[2]`), attributes (`[@a]`, `[@ns:a='v']`) and text (`[text()='v']`, `[.='v']`,
+ *            `[contains(text(),'v')]`, `[starts-with(.,'v')]`).
+ *
+ *          Expressions are evaluated from the root element of a tree, which is matched by the first step of absolute paths.
+ *          Names without a prefix match elements in any namespace. Unlike XPath, `//` at the beginning does not select the root element itself.
+ *
+ * @param bld the builder, which must have no frame open. On failure it is left with a partial frame open, and must be discarded.
+ * @param expr the expression.
+ * @param name name of the frame, `expr` itself if empty.
+ */
+[[nodiscard]] std::expected<void,xpath_error_t> xpath(QueryBuilder& bld, std::string_view expr, std::string_view name = {});
+
+///Compile an XPath expression into a query with a single frame. See the other variant for the supported subset.
+[[nodiscard]] std::expected<Query,xpath_error_t> xpath(std::string_view expr);
+
+/**
+ * @brief Thread-safe cache of compiled XPath expressions, keyed by their text.
+ * @details Queries are never evicted unless `clear` is called, so pointers returned by `get` stay valid until then.
+ *          Expressions failing to compile are not cached.
+ */
+struct XPathCache{
+    using stats_t = cache_stats_t;
+
+    ///Get the query for an expression, compiling it if not already present.
+    [[nodiscard]] std::expected<const Query*,xpath_error_t> get(std::string_view expr);
+
+    ///Number of queries stored.
+    [[nodiscard]] inline size_t size() const{return queries.size();}
+
+    [[nodiscard]] inline stats_t stats() const{return queries.stats();}
+
+    ///Drop all queries. Previously returned pointers are invalidated.
+    inline void clear(){queries.clear();}
+
+    private:
+        struct entry_t{
+            std::string text;
+            Query       query;
+        };
+
+        details::cache_store_t<entry_t> queries;
+};
+
+}
+}
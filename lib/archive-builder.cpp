@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include <vs-xml/archive-builder.hpp>
+#include <vs-xml/fwd/unordered_map.hpp>
+
+namespace VS_XML_NS{
+namespace details{
+
+namespace{
+
+//A symbol reference as found in nodes, ordered by position in its table.
+using ref_t = std::pair<delta_ptr_t,xml_count_t>;
+
+//Frames of a part are contiguous, from the beginning of its buffer.
+inline size_t frames_length(const archive_part_t& part){
+    return part.sections.size()==0?0:part.sections.back().base+part.sections.back().length;
+}
+
+struct merge_ctx_t{
+    std::span<archive_part_t>       parts;
+    std::vector<std::vector<ref_t>> refs;           //Distinct references of each part.
+    std::vector<std::vector<delta_ptr_t>> remap;    //Their position in the merged table.
+    std::vector<delta_ptr_t>        shift;          //Offset of each part table in the merged one, if not compressing.
+    std::vector<size_t>             offsets;        //Of each part in the merged buffer.
+    std::vector<uint8_t>*           buffer;
+    bool                            compress;
+    std::atomic<bool>               failed = false;
+};
+
+void collect(void* ptr, size_t begin, size_t end){
+    auto& ctx = *(merge_ctx_t*)ptr;
+    for(size_t i=begin;i<end;i++){
+        auto& part = ctx.parts[i];
+        auto& refs = ctx.refs[i];
+        for(auto& section : part.sections){
+            if(section.name.length!=0)refs.push_back({(delta_ptr_t)section.name.base,(xml_count_t)section.name.length});
+        }
+        bool ok = BuilderBase::remap_symbols({part.buffer.data(),frames_length(part)},+[](sv& ref, void* refs){
+            if(ref.length!=0)((std::vector<ref_t>*)refs)->emplace_back(ref.base,ref.length);
+        },&refs);
+        if(!ok)ctx.failed=true;
+        std::sort(refs.begin(),refs.end());
+        refs.erase(std::unique(refs.begin(),refs.end()),refs.end());
+    }
+}
+
+void relocate(void* ptr, size_t begin, size_t end){
+    auto& ctx = *(merge_ctx_t*)ptr;
+    for(size_t i=begin;i<end;i++){
+        auto& part = ctx.parts[i];
+        std::span<uint8_t> dst{ctx.buffer->data()+ctx.offsets[i],frames_length(part)};
+        std::memcpy(dst.data(),part.buffer.data(),dst.size());
+
+        struct lookup_t{
+            const std::vector<ref_t>&       refs;
+            const std::vector<delta_ptr_t>& remap;
+            delta_ptr_t                     shift;
+            bool                            compress;
+        } lookup{ctx.refs[i],ctx.remap[i],ctx.shift[i],ctx.compress};
+
+        bool ok = BuilderBase::remap_symbols(dst,+[](sv& ref, void* ptr){
+            if(ref.length==0)return;
+            auto& lookup = *(lookup_t*)ptr;
+            if(!lookup.compress){ref.base+=lookup.shift;return;}
+            auto it = std::lower_bound(lookup.refs.begin(),lookup.refs.end(),ref_t{ref.base,ref.length});
+            ref.base = lookup.remap[it-lookup.refs.begin()];
+        },&lookup);
+        if(!ok)ctx.failed=true;
+    }
+}
+
+}
+
+bool merge_archive_parts(std::span<archive_part_t> parts, bool compress, Executor* executor,
+    std::vector<binary_header_t::section_t>& sections, std::vector<uint8_t>& buffer, std::vector<uint8_t>& symbols){
+    merge_ctx_t ctx;
+    ctx.parts = parts;
+    ctx.compress = compress;
+    ctx.buffer = &buffer;
+    ctx.refs.resize(parts.size());
+    ctx.remap.resize(parts.size());
+    ctx.shift.resize(parts.size());
+
+    //Scanning nodes for references is only needed to deduplicate symbols.
+    if(compress){
+        if(executor!=nullptr)executor->parallel_for(parts.size(),collect,&ctx);
+        else collect(&ctx,0,parts.size());
+        if(ctx.failed)return false;
+    }
+
+    //Symbols are interned sequentially, one lookup for each distinct reference of each part.
+    size_t total_symbols = 0, total_buffer = 0, total_sections = 0;
+    for(auto& part : parts){
+        total_symbols+=part.symbols.size();
+        total_buffer+=frames_length(part);
+        total_sections+=part.sections.size();
+    }
+    symbols.clear();
+    if(compress){
+        VS_XML_NS::unordered_map<std::string_view,delta_ptr_t> table;
+        for(size_t i=0;i<parts.size();i++){
+            auto& remap = ctx.remap[i];
+            remap.reserve(ctx.refs[i].size());
+            for(auto [base,length] : ctx.refs[i]){
+                if((uint64_t)base+length>parts[i].symbols.size())return false;
+                std::string_view label((const char*)parts[i].symbols.data()+base,length);
+                auto [it,inserted] = table.try_emplace(label,(delta_ptr_t)symbols.size());
+                if(inserted)symbols.insert(symbols.end(),label.begin(),label.end());
+                remap.push_back(it->second);
+            }
+        }
+    }
+    else{
+        symbols.reserve(total_symbols);
+        for(size_t i=0;i<parts.size();i++){
+            ctx.shift[i]=symbols.size();
+            symbols.insert(symbols.end(),parts[i].symbols.begin(),parts[i].symbols.end());
+        }
+    }
+
+    sections.clear();
+    sections.reserve(total_sections);
+    ctx.offsets.resize(parts.size());
+    size_t offset = 0;
+    for(size_t i=0;i<parts.size();i++){
+        ctx.offsets[i]=offset;
+        for(auto section : parts[i].sections){
+            if(section.name.length!=0){
+                if(compress){
+                    auto it = std::lower_bound(ctx.refs[i].begin(),ctx.refs[i].end(),ref_t{(delta_ptr_t)section.name.base,(xml_count_t)section.name.length});
+                    section.name.base = ctx.remap[i][it-ctx.refs[i].begin()];
+                }
+                else section.name.base+=ctx.shift[i];
+            }
+            section.base+=offset;
+            sections.push_back(section);
+        }
+        offset+=frames_length(parts[i]);
+    }
+
+    buffer.resize(total_buffer);
+    if(executor!=nullptr)executor->parallel_for(parts.size(),relocate,&ctx);
+    else relocate(&ctx,0,parts.size());
+    return !ctx.failed;
+}
+
+}
+}
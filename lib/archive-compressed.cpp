@@ -0,0 +1,270 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include <vs-xml/archive-compressed.hpp>
+#include <vs-xml/executor.hpp>
+#include <vs-xml/lz.hpp>
+
+namespace VS_XML_NS{
+
+namespace{
+
+using from_binary_error_t = TreeRaw::from_binary_error_t;
+
+inline size_t block_length(const compressed_header_t& header, uint64_t idx){
+    return std::min<uint64_t>(header.block_size,header.length-idx*header.block_size);
+}
+
+//Decode a block, whose size in the original binary is `dst.size()`.
+inline bool decode_block(std::span<const uint8_t> src, std::span<uint8_t> dst){
+    if(src.size()==dst.size()){
+        std::memcpy(dst.data(),src.data(),dst.size());
+        return true;
+    }
+    return lz::decompress(src,dst);
+}
+
+//Header and block offsets, checked to be consistent with the region.
+std::expected<std::span<const uint64_t>, from_binary_error_t> load_index(std::span<const uint8_t> region, compressed_header_t& header){
+    if(region.size_bytes()<sizeof(compressed_header_t))return std::unexpected(from_binary_error_t{from_binary_error_t::HeaderTooSmall});
+    std::memcpy(&header,region.data(),sizeof(header));
+    if(std::memcmp(header.magic,"$XMZ",4)!=0 || header.codec!=0)return std::unexpected(from_binary_error_t{from_binary_error_t::MagicMismatch});
+    if(header.block_size==0 || header.blocks!=header.length/header.block_size+(header.length%header.block_size!=0))
+        return std::unexpected(from_binary_error_t{from_binary_error_t::TruncatedSpan});
+    if((region.size_bytes()-sizeof(compressed_header_t))/sizeof(uint64_t)<=header.blocks)
+        return std::unexpected(from_binary_error_t{from_binary_error_t::HeaderTooSmall});
+    if((uintptr_t)region.data()%alignof(uint64_t)!=0)return std::unexpected(from_binary_error_t{from_binary_error_t::TruncatedSpan});
+
+    std::span<const uint64_t> offsets((const uint64_t*)(region.data()+sizeof(compressed_header_t)),header.blocks+1);
+    if(offsets[0]!=sizeof(compressed_header_t)+offsets.size_bytes() || offsets.back()>region.size_bytes())
+        return std::unexpected(from_binary_error_t{from_binary_error_t::TruncatedSpan});
+    for(size_t i=0;i<header.blocks;i++){
+        if(offsets[i+1]<offsets[i] || offsets[i+1]-offsets[i]>lz::bound(block_length(header,i)))
+            return std::unexpected(from_binary_error_t{from_binary_error_t::TruncatedSpan});
+    }
+    return offsets;
+}
+
+}
+
+bool compress_binary(std::span<const uint8_t> binary, std::ostream& out, uint32_t block_size, Executor* executor){
+    if(block_size==0)return false;
+    compressed_header_t header;
+    header.block_size = block_size;
+    header.length = binary.size_bytes();
+    header.blocks = (header.length+block_size-1)/block_size;
+
+    struct ctx_t{
+        std::span<const uint8_t>            binary;
+        const compressed_header_t&          header;
+        std::vector<std::vector<uint8_t>>   blocks;
+    } ctx{binary,header};
+    ctx.blocks.resize(header.blocks);
+
+    auto task = +[](void* ptr, size_t begin, size_t end){
+        auto& ctx = *(ctx_t*)ptr;
+        for(size_t i=begin;i<end;i++){
+            auto src = ctx.binary.subspan(i*ctx.header.block_size,block_length(ctx.header,i));
+            auto& dst = ctx.blocks[i];
+            dst.resize(lz::bound(src.size()));
+            size_t length = lz::compress(src,dst);
+            //Blocks which do not shrink are stored as they are.
+            if(length==0 || length>=src.size())dst.assign(src.begin(),src.end());
+            else dst.resize(length);
+        }
+    };
+    if(executor!=nullptr)executor->parallel_for(header.blocks,task,&ctx);
+    else task(&ctx,0,header.blocks);
+
+    std::vector<uint64_t> offsets(header.blocks+1);
+    offsets[0] = sizeof(compressed_header_t)+sizeof(uint64_t)*offsets.size();
+    for(size_t i=0;i<header.blocks;i++)offsets[i+1]=offsets[i]+ctx.blocks[i].size();
+
+    out.write((const char*)&header,sizeof(header));
+    out.write((const char*)offsets.data(),sizeof(uint64_t)*offsets.size());
+    for(auto& block : ctx.blocks)out.write((const char*)block.data(),block.size());
+    out.flush();
+    return out.good();
+}
+
+std::expected<std::vector<uint8_t>, TreeRaw::from_binary_error_t> decompress_binary(std::span<const uint8_t> region, Executor* executor){
+    compressed_header_t header;
+    auto offsets = load_index(region,header);
+    if(!offsets.has_value())return std::unexpected(offsets.error());
+
+    struct ctx_t{
+        std::span<const uint8_t>    region;
+        const compressed_header_t&  header;
+        std::span<const uint64_t>   offsets;
+        std::vector<uint8_t>        ret;
+        std::atomic<bool>           failed = false;
+    } ctx{region,header,*offsets};
+    ctx.ret.resize(header.length);
+
+    auto task = +[](void* ptr, size_t begin, size_t end){
+        auto& ctx = *(ctx_t*)ptr;
+        for(size_t i=begin;i<end;i++){
+            auto src = ctx.region.subspan(ctx.offsets[i],ctx.offsets[i+1]-ctx.offsets[i]);
+            if(!decode_block(src,{ctx.ret.data()+i*ctx.header.block_size,block_length(ctx.header,i)}))ctx.failed=true;
+        }
+    };
+    if(executor!=nullptr)executor->parallel_for(header.blocks,task,&ctx);
+    else task(&ctx,0,header.blocks);
+
+    if(ctx.failed)return std::unexpected(from_binary_error_t{from_binary_error_t::TruncatedSpan});
+    return std::move(ctx.ret);
+}
+
+std::expected<CompressedArchive, CompressedArchive::from_binary_error_t> CompressedArchive::from_binary(std::span<const uint8_t> region, size_t cache_blocks, bool verify){
+    compressed_header_t header;
+    auto offsets = load_index(region,header);
+    if(!offsets.has_value())return std::unexpected(offsets.error());
+
+    //Blocks are read without a cache while loading.
+    auto read = [&](uint64_t offset, std::span<uint8_t> out)->bool{
+        if(offset>header.length || out.size()>header.length-offset)return false;
+        std::vector<uint8_t> tmp;
+        for(uint64_t i=offset/header.block_size;out.size()!=0;i++){
+            tmp.resize(block_length(header,i));
+            if(!decode_block(region.subspan((*offsets)[i],(*offsets)[i+1]-(*offsets)[i]),tmp))return false;
+            size_t skip = offset-i*header.block_size;
+            size_t count = std::min(out.size(),tmp.size()-skip);
+            std::memcpy(out.data(),tmp.data()+skip,count);
+            out = out.subspan(count);
+            offset+=count;
+        }
+        return true;
+    };
+
+    std::vector<uint8_t> head(sizeof(binary_header_t));
+    if(!read(0,head))return std::unexpected(from_binary_error_t{from_binary_error_t::HeaderTooSmall});
+    binary_header_t fixed;
+    std::memcpy((void*)&fixed,head.data(),sizeof(binary_header_t));
+
+    if(std::memcmp(fixed.magic,"$XML",4)!=0)
+        return std::unexpected(from_binary_error_t{from_binary_error_t::MagicMismatch});
+    if(fixed.format_major!=format_major)
+        return std::unexpected(from_binary_error_t{from_binary_error_t::MajorVersionMismatch});
+    if(fixed.format_minor>format_minor)
+        return std::unexpected(from_binary_error_t{from_binary_error_t::MinorVersionTooHigh});
+    if  (
+            fixed.size__delta_ptr!=sizeof(delta_ptr_t) ||
+            fixed.size__xml_count!=sizeof(xml_count_t) ||
+            fixed.size__xml_enum_size!=sizeof(xml_enum_size_t) ||
+            fixed.size__xml_size!=sizeof(xml_size_t)
+        ) return std::unexpected(from_binary_error_t{from_binary_error_t::TypeMismatch});
+    auto endianess = std::endian::native==std::endian::little?binary_header_t::endianess_t::LITTLE:binary_header_t::endianess_t::BIG;
+    if(fixed.endianess!=endianess)return std::unexpected(from_binary_error_t{from_binary_error_t::TypeMismatch});
+    if(fixed.length_of_symbols>header.length || header.length<fixed.start_data()+sizeof(binary_header_t::extension_t)*fixed.extensions_count)
+        return std::unexpected(from_binary_error_t{from_binary_error_t::TruncatedSpan});
+
+    //Sections and symbols, the same checks as ArchiveRaw::from_binary.
+    head.resize(fixed.start_data());
+    if(!read(0,head))return std::unexpected(from_binary_error_t{from_binary_error_t::TruncatedSpan});
+    auto& full = *(const binary_header_t*)head.data();
+    std::span<const uint8_t> symbols{head.data()+full.size(),full.length_of_symbols};
+    size_t data_length = header.length-full.start_data();
+    for(size_t i=0;i<full.docs_count;i++){
+        auto section = full.region(i);
+        if(section.base<0 || (uint64_t)section.base+section.length>data_length)
+            return std::unexpected(from_binary_error_t{from_binary_error_t::TreeOutOfBounds});
+        if(section.name.length!=0 && (section.name.base<0 || (uint64_t)section.name.base+section.name.length>full.length_of_symbols))
+            return std::unexpected(from_binary_error_t{from_binary_error_t::SymbolsOutOfBounds});
+    }
+
+    //The name index, if present.
+    std::vector<uint32_t> names;
+    std::vector<binary_header_t::extension_t> extensions(full.extensions_count);
+    if(!read(header.length-sizeof(binary_header_t::extension_t)*extensions.size(),{(uint8_t*)extensions.data(),sizeof(binary_header_t::extension_t)*extensions.size()}))
+        return std::unexpected(from_binary_error_t{from_binary_error_t::TruncatedSpan});
+    for(auto& entry : extensions){
+        if(entry.kind!=(uint16_t)extension_kind_t::ARCHIVE_NAMES || entry.doc!=0)continue;
+        if(entry.length!=sizeof(uint32_t)*full.docs_count)return std::unexpected(from_binary_error_t{from_binary_error_t::TruncatedSpan});
+        names.resize(full.docs_count);
+        if(!read(entry.base,{(uint8_t*)names.data(),entry.length}))return std::unexpected(from_binary_error_t{from_binary_error_t::TruncatedSpan});
+        for(auto position : names){
+            if(position>=full.docs_count)return std::unexpected(from_binary_error_t{from_binary_error_t::TreeOutOfBounds});
+        }
+        break;
+    }
+
+    ArchiveRaw catalog(full.configs,std::span<const binary_header_t::section_t>{(const binary_header_t::section_t*)(head.data()+sizeof(binary_header_t)),full.docs_count},
+        std::span<const uint8_t>{},symbols,names);
+    CompressedArchive ret(catalog);
+    ret.region = region;
+    ret.header = header;
+    ret.offsets = *offsets;
+    ret.start_data = full.start_data();
+    ret.head = std::move(head);
+    ret.names = std::move(names);
+    ret.symbols_i = symbols;
+    ret.configs = full.configs;
+    ret.verify = verify;
+    ret.cache = std::make_unique<cache_t>();
+    ret.cache->capacity = std::max<size_t>(cache_blocks,1);
+    return ret;
+}
+
+std::shared_ptr<const std::vector<uint8_t>> CompressedArchive::block(uint64_t idx) const{
+    {
+        std::lock_guard guard(cache->lock);
+        if(auto it = cache->entries.find(idx); it!=cache->entries.end()){
+            cache->counters.hits++;
+            cache->lru.splice(cache->lru.begin(),cache->lru,it->second);
+            return it->second->second;
+        }
+        cache->counters.misses++;
+    }
+
+    //Decoded outside of the lock, so that threads missing different blocks do not wait for each other.
+    auto decoded = std::make_shared<std::vector<uint8_t>>(block_length(header,idx));
+    if(!decode_block(region.subspan(offsets[idx],offsets[idx+1]-offsets[idx]),*decoded))return {};
+
+    std::lock_guard guard(cache->lock);
+    if(auto it = cache->entries.find(idx); it!=cache->entries.end())return it->second->second;
+    cache->lru.emplace_front(idx,decoded);
+    cache->entries[idx] = cache->lru.begin();
+    while(cache->lru.size()>cache->capacity){
+        cache->entries.erase(cache->lru.back().first);
+        cache->lru.pop_back();
+    }
+    return decoded;
+}
+
+bool CompressedArchive::read(uint64_t offset, std::span<uint8_t> out) const{
+    if(offset>header.length || out.size()>header.length-offset)return false;
+    for(uint64_t i=offset/header.block_size;out.size()!=0;i++){
+        auto current = block(i);
+        if(!current)return false;
+        size_t skip = offset-i*header.block_size;
+        size_t count = std::min(out.size(),current->size()-skip);
+        std::memcpy(out.data(),current->data()+skip,count);
+        out = out.subspan(count);
+        offset+=count;
+    }
+    return true;
+}
+
+std::shared_ptr<const DocumentRaw> CompressedArchive::get(size_t idx) const{
+    if(idx>=items())return {};
+    auto& section = ((const binary_header_t*)head.data())->sections[idx];
+
+    struct holder_t{
+        std::vector<uint8_t>        buffer;
+        std::optional<DocumentRaw>  document;
+    };
+    auto holder = std::make_shared<holder_t>();
+    holder->buffer.resize(section.length);
+    if(!read(start_data+section.base,holder->buffer))return {};
+    holder->document.emplace(configs,std::span<uint8_t>{holder->buffer},std::span<uint8_t>{(uint8_t*)symbols_i.data(),symbols_i.size()});
+    if(verify && !holder->document->verify().has_value())return {};
+    return std::shared_ptr<const DocumentRaw>(holder,&*holder->document);
+}
+
+CompressedArchive::stats_t CompressedArchive::stats() const{
+    std::lock_guard guard(cache->lock);
+    return cache->counters;
+}
+
+}
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#if __has_include(<unistd.h>)
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+#include <vs-xml/archive-segments.hpp>
+
+namespace VS_XML_NS{
+
+namespace{
+
+//Segment, padding and footer, ready to be written at once.
+std::optional<std::string> serialize_segment(const ArchiveRaw& archive, std::span<const binary_extension_t> extensions){
+    if(archive.items()>UINT16_MAX)return {};
+    std::ostringstream tmp;
+    if(!archive.save_binary(tmp,extensions))return {};
+    std::string ret = std::move(tmp).str();
+
+    SegmentedArchive::footer_t footer;
+    footer.length = ret.size();
+    footer.docs = archive.items();
+    footer.padding = ret.size()%16==0?0:16-ret.size()%16;
+    ret.append(footer.padding,'\0');
+    ret.append((const char*)&footer,sizeof(footer));
+    return ret;
+}
+
+}
+
+bool SegmentedArchive::append(std::ostream& out, const ArchiveRaw& archive, std::span<const binary_extension_t> extensions){
+    auto segment = serialize_segment(archive,extensions);
+    if(!segment.has_value())return false;
+    out.write(segment->data(),segment->size());
+    out.flush();
+    return out.good();
+}
+
+bool SegmentedArchive::append(int fd, const ArchiveRaw& archive, std::span<const binary_extension_t> extensions){
+#if __has_include(<unistd.h>)
+    auto segment = serialize_segment(archive,extensions);
+    if(!segment.has_value())return false;
+    const char* data = segment->data();
+    size_t left = segment->size();
+    while(left>0){
+        auto written = ::write(fd,data,left);
+        if(written<0){
+            if(errno==EINTR)continue;
+            return false;
+        }
+        data+=written;
+        left-=written;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::expected<SegmentedArchive, SegmentedArchive::from_binary_error_t> SegmentedArchive::from_binary(std::span<const uint8_t> region, ArchiveRaw::verify_t verify, Executor* executor){
+    SegmentedArchive ret;
+    ret.length = region.size_bytes();
+
+    //Footers are walked from the end, each one leading to the one before its segment.
+    size_t end = region.size_bytes();
+    while(end>0){
+        if(end<sizeof(footer_t) || end%16!=0)return std::unexpected(from_binary_error_t{from_binary_error_t::TruncatedSpan});
+        footer_t footer;
+        std::memcpy(&footer,region.data()+end-sizeof(footer_t),sizeof(footer_t));
+        if(std::memcmp(footer.magic,"$XSG",4)!=0)return std::unexpected(from_binary_error_t{from_binary_error_t::MagicMismatch});
+        size_t available = end-sizeof(footer_t);
+        if(footer.padding>=16 || footer.padding>available || footer.length>available-footer.padding || footer.length<sizeof(binary_header_t))
+            return std::unexpected(from_binary_error_t{from_binary_error_t::TruncatedSpan});
+        size_t start = available-footer.padding-footer.length;
+        if((footer.length+footer.padding)%16!=0)return std::unexpected(from_binary_error_t{from_binary_error_t::TruncatedSpan});
+
+        auto archive = ArchiveRaw::from_binary(region.subspan(start,footer.length),verify,executor);
+        if(!archive.has_value())return std::unexpected(archive.error());
+        if(archive->items()!=footer.docs)return std::unexpected(from_binary_error_t{from_binary_error_t::TooManyDocs});
+        ret.parts.push_back(*archive);
+        end = start;
+    }
+
+    std::reverse(ret.parts.begin(),ret.parts.end());
+    ret.starts.reserve(ret.parts.size());
+    size_t total = 0;
+    for(auto& part : ret.parts){
+        total+=part.items();
+        ret.starts.push_back(total);
+    }
+    return ret;
+}
+
+std::optional<std::pair<size_t,size_t>> SegmentedArchive::locate(size_t idx) const{
+    auto it = std::upper_bound(starts.begin(),starts.end(),idx);
+    if(it==starts.end())return {};
+    size_t segment = it-starts.begin();
+    return std::pair{segment, idx-(segment==0?0:starts[segment-1])};
+}
+
+std::optional<const DocumentRaw> SegmentedArchive::get(size_t idx) const{
+    auto at = locate(idx);
+    if(!at.has_value())return {};
+    return parts[at->first].get(at->second);
+}
+
+std::optional<size_t> SegmentedArchive::find(std::string_view name) const{
+    for(size_t i=0;i<parts.size();i++){
+        if(auto idx = parts[i].find(name); idx.has_value())return *idx+(i==0?0:starts[i-1]);
+    }
+    return {};
+}
+
+std::optional<const DocumentRaw> SegmentedArchive::get(std::string_view name) const{
+    auto idx = find(name);
+    if(!idx.has_value())return {};
+    return get(*idx);
+}
+
+}
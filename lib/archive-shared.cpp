@@ -0,0 +1,148 @@
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define VS_XML_HAS_MMAN
+#endif
+
+#include <vs-xml/archive-shared.hpp>
+
+namespace VS_XML_NS{
+
+namespace{
+
+#if defined(VS_XML_HAS_MMAN)
+
+//Only counts the bytes written.
+struct counter_t : std::streambuf{
+    size_t count = 0;
+
+    int_type overflow(int_type c) override{
+        if(!traits_type::eq_int_type(c,traits_type::eof()))count++;
+        return traits_type::not_eof(c);
+    }
+    std::streamsize xsputn(const char*, std::streamsize n) override{
+        count+=n;
+        return n;
+    }
+};
+
+//Writes into a fixed region, failing when going past its end.
+struct region_t : std::streambuf{
+    region_t(char* data, size_t size){setp(data,data+size);}
+    size_t written() const{return pptr()-pbase();}
+};
+
+inline std::string object_name(std::string_view name){
+    return name.starts_with('/')?std::string(name):"/"+std::string(name);
+}
+
+//Size the object for the binary and write it through a shared mapping.
+template<typename F>
+std::expected<void, mapped_error_t> fill(int fd, F&& save){
+    counter_t counter;
+    std::ostream measure(&counter);
+    if(!save(measure) || !measure.good())return std::unexpected(mapped_error_t{mapped_error_t::WriteFailed});
+    size_t size = counter.count;
+    if(size==0 || ::ftruncate(fd,size)!=0)return std::unexpected(mapped_error_t{mapped_error_t::WriteFailed});
+
+    void* ptr = ::mmap(nullptr,size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+    if(ptr==MAP_FAILED)return std::unexpected(mapped_error_t{mapped_error_t::MapFailed});
+    region_t region((char*)ptr,size);
+    std::ostream out(&region);
+    bool ok = save(out) && out.good() && region.written()==size;
+    ::munmap(ptr,size);
+    if(!ok)return std::unexpected(mapped_error_t{mapped_error_t::WriteFailed});
+    return {};
+}
+
+template<typename F>
+std::expected<void, mapped_error_t> publish(std::string_view name, unsigned mode, F&& save){
+    auto path = object_name(name);
+    //No permissions until complete, so that nobody else can open it in the meanwhile.
+    int fd = ::shm_open(path.c_str(),O_RDWR|O_CREAT|O_EXCL|O_CLOEXEC,0);
+    if(fd<0)return std::unexpected(mapped_error_t{mapped_error_t::CreateFailed});
+    auto ret = fill(fd,save);
+    if(ret.has_value() && ::fchmod(fd,mode)!=0)ret = std::unexpected(mapped_error_t{mapped_error_t::WriteFailed});
+    ::close(fd);
+    if(!ret.has_value())::shm_unlink(path.c_str());
+    return ret;
+}
+
+#endif
+
+}
+
+std::expected<void, mapped_error_t> publish_archive(std::string_view name, const ArchiveRaw& archive, std::span<const binary_extension_t> extensions, unsigned mode){
+#if defined(VS_XML_HAS_MMAN)
+    return publish(name,mode,[&](std::ostream& out){return archive.save_binary(out,extensions);});
+#else
+    return std::unexpected(mapped_error_t{mapped_error_t::NotSupported});
+#endif
+}
+
+std::expected<void, mapped_error_t> publish_binary(std::string_view name, std::span<const uint8_t> binary, unsigned mode){
+#if defined(VS_XML_HAS_MMAN)
+    if(binary.size_bytes()<sizeof(binary_header_t))
+        return std::unexpected(mapped_error_t{mapped_error_t::Binary,{TreeRaw::from_binary_error_t::HeaderTooSmall}});
+    if(auto archive = ArchiveRaw::from_binary(binary); !archive.has_value())
+        return std::unexpected(mapped_error_t{mapped_error_t::Binary,archive.error()});
+    return publish(name,mode,[&](std::ostream& out){
+        out.write((const char*)binary.data(),binary.size_bytes());
+        return true;
+    });
+#else
+    return std::unexpected(mapped_error_t{mapped_error_t::NotSupported});
+#endif
+}
+
+bool unpublish_archive(std::string_view name){
+#if defined(VS_XML_HAS_MMAN)
+    return ::shm_unlink(object_name(name).c_str())==0;
+#else
+    return false;
+#endif
+}
+
+std::expected<MappedArchive, mapped_error_t> attach_archive(std::string_view name, access_t access, ArchiveRaw::verify_t verify, Executor* executor){
+#if defined(VS_XML_HAS_MMAN)
+    int fd = ::shm_open(object_name(name).c_str(),O_RDONLY|O_CLOEXEC,0);
+    if(fd<0)return std::unexpected(mapped_error_t{mapped_error_t::OpenFailed});
+    auto ret = attach_archive(fd,access,verify,executor);
+    ::close(fd);
+    return ret;
+#else
+    return std::unexpected(mapped_error_t{mapped_error_t::NotSupported});
+#endif
+}
+
+std::expected<int, mapped_error_t> publish_archive_fd(const ArchiveRaw& archive, std::span<const binary_extension_t> extensions){
+#if defined(VS_XML_HAS_MMAN) && defined(MFD_ALLOW_SEALING)
+    int fd = ::memfd_create("vs-xml-archive",MFD_CLOEXEC|MFD_ALLOW_SEALING);
+    if(fd<0)return std::unexpected(mapped_error_t{mapped_error_t::CreateFailed});
+    auto ret = fill(fd,[&](std::ostream& out){return archive.save_binary(out,extensions);});
+    //Sealed once the writable mapping is gone, so that receivers can trust it never changes.
+    if(ret.has_value() && ::fcntl(fd,F_ADD_SEALS,F_SEAL_SHRINK|F_SEAL_GROW|F_SEAL_WRITE|F_SEAL_SEAL)!=0)
+        ret = std::unexpected(mapped_error_t{mapped_error_t::WriteFailed});
+    if(!ret.has_value()){
+        ::close(fd);
+        return std::unexpected(ret.error());
+    }
+    return fd;
+#else
+    return std::unexpected(mapped_error_t{mapped_error_t::NotSupported});
+#endif
+}
+
+std::expected<MappedArchive, mapped_error_t> attach_archive(int fd, access_t access, ArchiveRaw::verify_t verify, Executor* executor){
+    auto map = MappedRegion::open(fd,access);
+    if(!map.has_value())return std::unexpected(map.error());
+    return MappedArchive::open(std::move(*map),verify,executor);
+}
+
+}
@@ -1,13 +1,39 @@
 #include "vs-xml/commons.hpp"
 #include "vs-xml/utils/warn-suppress.h"
+#include <algorithm>
 #include <expected>
 #include <vs-xml/archive.hpp>
+#include <vs-xml/checksum.hpp>
+#include <vs-xml/executor.hpp>
 #include <cstring>
 
 namespace VS_XML_NS{
 
-bool ArchiveRaw::save_binary(std::ostream& out)const{
+std::vector<uint32_t> ArchiveRaw::sort_names(std::span<const binary_header_t::section_t> index, const uint8_t* symbols){
+    std::vector<uint32_t> ret(index.size());
+    for(size_t i=0;i<index.size();i++)ret[i]=i;
+    if(symbols==nullptr)return ret;
+    auto label = [&](uint32_t i){return std::string_view((const char*)symbols+index[i].name.base,index[i].name.length);};
+    //Stable, so that the first of several documents with the same name is the one found.
+    std::stable_sort(ret.begin(),ret.end(),[&](uint32_t a, uint32_t b){return label(a)<label(b);});
+    return ret;
+}
+
+bool ArchiveRaw::save_binary(std::ostream& out, std::span<const binary_extension_t> extensions, bool checksums)const{
     if(configs.symbols==builder_config_t::EXTERN_ABS)return false; //Symbols not relocatable.
+    if(extensions.size()+checksums>=UINT16_MAX)return false;
+    if(index.size()>UINT16_MAX)return false; //docs_count is 16 bits.
+
+    //The name index is always written, rebuilding it if this archive was loaded without one.
+    std::vector<uint32_t> sorted;
+    if(names.size()!=index.size())sorted = sort_names(index,symbols.data());
+    std::span<const uint32_t> positions = names.size()==index.size()?names:std::span<const uint32_t>(sorted);
+    std::vector<binary_extension_t> all(extensions.begin(),extensions.end());
+    all.push_back({extension_kind_t::ARCHIVE_NAMES,0,{(const uint8_t*)positions.data(),positions.size_bytes()}});
+    //Header, symbols and then each document, filled in while writing them.
+    std::vector<uint32_t> sums(checksums?2+index.size():0);
+    if(checksums)all.push_back({extension_kind_t::CHECKSUMS,0,{(const uint8_t*)sums.data(),sums.size()*sizeof(uint32_t)}});
+    extensions = all;
 
     binary_header_t header{};
     header.configs = configs;
@@ -16,8 +42,10 @@ bool ArchiveRaw::save_binary(std::ostream& out)const{
     size_t align_symbols = (header.size()+symbols.size_bytes()%16==0)?0:(16-(header.size()+symbols.size_bytes())%16);
     header.length_of_symbols = symbols.size_bytes();
     header.docs_count = index.size();
+    header.extensions_count = extensions.size();
 
     out.write((const char*)&header, sizeof(header));
+    if(checksums)sums[0] = crc32c({(const uint8_t*)&header,sizeof(header)});
 
     delta_ptr_t current=0;
     for(auto& document: this->index){
@@ -27,10 +55,12 @@ bool ArchiveRaw::save_binary(std::ostream& out)const{
             document.length
         };
         out.write((const char*)&section, sizeof(binary_header_t::section_t));
+        if(checksums)sums[0] = crc32c({(const uint8_t*)&section,sizeof(section)},sums[0]);
         current+=document.length;
     }
 
     out.write((const char*)symbols.data(), symbols.size_bytes());
+    if(checksums)sums[1] = crc32c({(const uint8_t*)symbols.data(),symbols.size_bytes()});
 
     if(align_symbols!=0){
         //std::printf("----Align %d %d\n", align_symbols,symbols.size_bytes());
@@ -38,15 +68,18 @@ bool ArchiveRaw::save_binary(std::ostream& out)const{
         out.write(tmp, align_symbols);
     }
 
-    for(auto& document: this->index){
-        out.write((const char*)this->buffer.data()+document.base, document.length);
+    for(size_t i=0;i<index.size();i++){
+        out.write((const char*)this->buffer.data()+index[i].base, index[i].length);
+        if(checksums)sums[2+i] = crc32c({(const uint8_t*)this->buffer.data()+index[i].base,index[i].length});
     }
 
+    details::save_extensions(out, header.start_data()+current, extensions);
+
     out.flush();
     return true;
 }
 
-std::expected<ArchiveRaw, ArchiveRaw::from_binary_error_t> ArchiveRaw::from_binary(std::span<uint8_t> region){
+std::expected<ArchiveRaw, ArchiveRaw::from_binary_error_t> ArchiveRaw::from_binary(std::span<uint8_t> region, verify_t verify, Executor* executor){
     std::span<uint8_t> symbols;
 
     const binary_header_t& header = *(const binary_header_t*)region.data();
@@ -73,17 +106,66 @@ std::expected<ArchiveRaw, ArchiveRaw::from_binary_error_t> ArchiveRaw::from_bina
     auto endianess = std::endian::native==std::endian::little?binary_header_t::endianess_t::LITTLE:binary_header_t::endianess_t::BIG;
     if(header.endianess!=endianess) return std::unexpected(from_binary_error_t{from_binary_error_t::TypeMismatch});
 
+    if(region.size_bytes() < header.start_data()+sizeof(binary_header_t::extension_t)*header.extensions_count)
+        return std::unexpected(from_binary_error_t{from_binary_error_t::TruncatedSpan});
+
     symbols=std::span<uint8_t>{region.data()+header.size(), header.length_of_symbols};
 
+    //Optional, archives without it fall back to linear lookups by name.
+    std::span<const uint32_t> names;
+    if(auto payload = binary_extension(region,extension_kind_t::ARCHIVE_NAMES,0); payload.has_value()){
+        if(payload->size_bytes()!=sizeof(uint32_t)*header.docs_count || (uintptr_t)payload->data()%alignof(uint32_t)!=0)
+            return std::unexpected(from_binary_error_t{from_binary_error_t::TruncatedSpan});
+        names = {(const uint32_t*)payload->data(),header.docs_count};
+    }
+
+    //Sections and their names must be within the region, whatever the verification requested.
+    size_t data_length = region.size_bytes()-header.start_data();
+    for(size_t i=0;i<header.docs_count;i++){
+        auto section = header.region(i);
+        if(section.base<0 || (uint64_t)section.base+section.length>data_length)
+            return std::unexpected(from_binary_error_t{from_binary_error_t::TreeOutOfBounds});
+        if(section.name.length!=0 && (section.name.base<0 || (uint64_t)section.name.base+section.name.length>header.length_of_symbols))
+            return std::unexpected(from_binary_error_t{from_binary_error_t::SymbolsOutOfBounds});
+    }
+    for(auto position : names){
+        if(position>=header.docs_count)return std::unexpected(from_binary_error_t{from_binary_error_t::TreeOutOfBounds});
+    }
+
     WARN_PUSH;
     WARN_IGNORE("-Waddress-of-packed-member");
     //`sections` alignment is safe since as it is being guarded by a separate static_assert to be 64bit aligned.
-    return ArchiveRaw(header.configs,{header.sections,header.docs_count},{region.data()+header.start_data(),region.data()+region.size_bytes()},symbols);
+    ArchiveRaw ret(header.configs,{header.sections,header.docs_count},{region.data()+header.start_data(),region.data()+region.size_bytes()},symbols,names);
     WARN_POP;
+
+    if(verify==verify_t::LAZY){
+        ret.checked = std::shared_ptr<std::atomic<uint8_t>[]>(new std::atomic<uint8_t>[header.docs_count]());
+    }
+    else if(verify==verify_t::EAGER){
+        struct ctx_t{
+            const ArchiveRaw& archive;
+            std::atomic<int> failure = from_binary_error_t::OK;
+        } ctx{ret};
+        auto task = +[](void* ptr, size_t begin, size_t end){
+            auto& ctx = *(ctx_t*)ptr;
+            for(size_t i=begin;i<end && ctx.failure==from_binary_error_t::OK;i++){
+                auto v = ctx.archive.index[i];
+                auto doc = DocumentRaw(ctx.archive.configs,std::span{ctx.archive.buffer.data()+v.base,v.length},std::span{ctx.archive.symbols.begin(),ctx.archive.symbols.end()});
+                if(auto ok = doc.verify(); !ok.has_value()){
+                    int expected = from_binary_error_t::OK;
+                    ctx.failure.compare_exchange_strong(expected,ok.error().code);
+                }
+            }
+        };
+        if(executor!=nullptr)executor->parallel_for(header.docs_count,task,&ctx,16);
+        else task(&ctx,0,header.docs_count);
+        if(ctx.failure!=from_binary_error_t::OK)return std::unexpected(from_binary_error_t{(from_binary_error_t::Code)ctx.failure.load()});
+    }
+    return ret;
 }
 
-std::expected<const ArchiveRaw, ArchiveRaw::from_binary_error_t> ArchiveRaw::from_binary(std::span<const uint8_t> region){
-    return from_binary(std::span<uint8_t>{(uint8_t*)region.data(),(uint8_t*)region.data()+region.size_bytes()});
+std::expected<const ArchiveRaw, ArchiveRaw::from_binary_error_t> ArchiveRaw::from_binary(std::span<const uint8_t> region, verify_t verify, Executor* executor){
+    return from_binary(std::span<uint8_t>{(uint8_t*)region.data(),(uint8_t*)region.data()+region.size_bytes()},verify,executor);
 }
 
 }
@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#if __has_include(<sys/mman.h>)
+#include <sys/mman.h>
+#include <unistd.h>
+#define VS_XML_HAS_MMAN
+#endif
+
+#include <vs-xml/arena.hpp>
+
+namespace VS_XML_NS{
+
+namespace{
+
+//Accessible memory grows in steps of this size, or of the current size if larger, up to the maximum step.
+constexpr size_t commit_step = 2<<20;
+constexpr size_t max_commit_step = 256<<20;
+
+#if defined(VS_XML_HAS_MMAN)
+const size_t page_size = sysconf(_SC_PAGESIZE);
+#endif
+
+inline size_t round_up(size_t value, size_t step){return (value+step-1)/step*step;}
+
+}
+
+SparseArena::SparseArena(size_t reserve){
+#if defined(VS_XML_HAS_MMAN)
+    if(reserve==0)return;
+    reserve = round_up(reserve,page_size);
+    void* region = ::mmap(nullptr,reserve,PROT_NONE,MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE,-1,0);
+    if(region==MAP_FAILED)throw std::bad_alloc();
+    ptr = (uint8_t*)region;
+    reserved = reserve;
+#else
+    reserved = reserve;
+#endif
+}
+
+SparseArena::SparseArena(SparseArena&& other) noexcept:
+    ptr(std::exchange(other.ptr,nullptr)),
+    length(std::exchange(other.length,0)),
+    accessible(std::exchange(other.accessible,0)),
+    reserved(std::exchange(other.reserved,0)),
+    dirty(std::exchange(other.dirty,0))
+#if !defined(VS_XML_HAS_MMAN)
+    ,fallback(std::move(other.fallback))
+#endif
+{}
+
+SparseArena& SparseArena::operator=(SparseArena&& other) noexcept{
+    if(this!=&other){
+        this->~SparseArena();
+        new (this) SparseArena(std::move(other));
+    }
+    return *this;
+}
+
+SparseArena::SparseArena(const SparseArena& other):SparseArena(other.reserved){
+    resize(other.length);
+    if(length!=0)std::memcpy(ptr,other.ptr,length);
+}
+
+SparseArena& SparseArena::operator=(const SparseArena& other){
+    if(this!=&other)*this = SparseArena(other);
+    return *this;
+}
+
+SparseArena::~SparseArena(){
+#if defined(VS_XML_HAS_MMAN)
+    if(ptr!=nullptr)::munmap(ptr,reserved);
+#endif
+    ptr = nullptr;
+    length = accessible = reserved = dirty = 0;
+}
+
+void SparseArena::commit(size_t size){
+    if(size>reserved)throw std::bad_alloc();
+    size_t target = std::min(reserved,round_up(std::max(size,accessible+std::clamp(accessible,commit_step,max_commit_step)),commit_step));
+#if defined(VS_XML_HAS_MMAN)
+    //Pages are already zero, and only backed by memory once written.
+    if(::mprotect(ptr+accessible,target-accessible,PROT_READ|PROT_WRITE)!=0)throw std::bad_alloc();
+#else
+    fallback.resize(target);
+    ptr = fallback.data();
+#endif
+    accessible = target;
+}
+
+void SparseArena::clean(size_t size){
+    std::memset(ptr+length,0,std::min(size,dirty)-length);
+}
+
+void SparseArena::release(){
+#if defined(VS_XML_HAS_MMAN)
+    size_t keep = round_up(length,page_size);
+    if(keep>=accessible)return;
+    ::madvise(ptr+keep,accessible-keep,MADV_DONTNEED);
+    ::mprotect(ptr+keep,accessible-keep,PROT_NONE);
+    accessible = keep;
+    dirty = std::min(dirty,keep);
+#else
+    fallback.resize(length);
+    fallback.shrink_to_fit();
+    ptr = fallback.data();
+    accessible = length;
+    dirty = length;
+#endif
+}
+
+}
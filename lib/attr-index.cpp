@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <string>
+
+#include <vs-xml/attr-index.hpp>
+#include <vs-xml/fwd/unordered_map.hpp>
+#include <vs-xml/node.hpp>
+#include <vs-xml/serializer.hpp>
+#include <vs-xml/wrp-node.hpp>
+
+namespace VS_XML_NS{
+
+namespace{
+
+struct value_key_t{
+    uint32_t         label;
+    std::string_view value;     //Unescaped
+
+    friend inline bool operator==(const value_key_t&, const value_key_t&) = default;
+};
+
+struct value_hash_t{
+    inline size_t operator()(const value_key_t& k) const{
+        return std::hash<std::string_view>{}(k.value)*31+k.label;
+    }
+};
+
+}
+
+AttrIndex AttrIndex::build(const TreeRaw& tree, std::span<const selector_t> selected){
+    const uint8_t* base = (const uint8_t*)&tree.root();
+    const unknown_t* end = tree.root().next();
+    bool raw = tree.config().raw_strings;
+
+    VS_XML_NS::unordered_map<details::label_key_t,uint32_t,details::label_hash_t> label_ids;
+    VS_XML_NS::unordered_map<value_key_t,uint32_t,value_hash_t> value_ids;
+    std::vector<label_t> labels;
+    std::vector<value_t> values;
+    std::vector<uint32_t> value_label;      //Label id of each value.
+    std::vector<uint64_t> value_last;       //Offset of the last element recorded for each value, to skip duplicates.
+    std::deque<std::string> unescaped;      //Storage for the keys of value_ids, for raw strings only.
+    std::string buffer;
+
+    std::vector<uint32_t> sequence;         //Value id of each posting, in document order.
+    std::vector<uint64_t> offsets;
+
+    //First pass: assign ids to labels and values, and record postings in document order.
+    for(auto current = &tree.root(); current<end;){
+        if(current->type()!=type_t::ELEMENT){current=current->next();continue;}
+        uint64_t offset = (const uint8_t*)current-base;
+        for(auto& attr : current->attrs()){
+            auto ns = *attr.ns(), name = *attr.name(), value = *attr.value();
+            details::label_key_t lkey{tree.rsv(ns),tree.rsv(name)};
+            auto [lit,linserted] = label_ids.try_emplace(lkey,(uint32_t)labels.size());
+            if(linserted){
+                uint32_t flags = ALL_NS;
+                if(selected.size()!=0){
+                    bool any = false, named = false;
+                    for(auto& s : selected){
+                        if(s.name!=lkey.name)continue;
+                        if(!s.ns.has_value())any=true;
+                        else if(*s.ns==lkey.ns)named=true;
+                    }
+                    flags = any?ALL_NS:named?0:UINT32_MAX;
+                }
+                labels.push_back({ns.base,name.base,(uint32_t)ns.length,(uint32_t)name.length,0,0,flags});
+            }
+            //Labels which were not selected are kept aside, and dropped once sorting is over.
+            if(labels[lit->second].flags==UINT32_MAX)continue;
+
+            std::string_view text = tree.rsv(value);
+            if(raw){
+                buffer.clear();
+                for(auto c : serialize::unescaped_view(text))buffer.push_back(c);
+                text = buffer;
+            }
+            auto vit = value_ids.find(value_key_t{lit->second,text});
+            if(vit==value_ids.end()){
+                if(raw)text = unescaped.emplace_back(buffer);
+                vit = value_ids.emplace(value_key_t{lit->second,text},(uint32_t)values.size()).first;
+                values.push_back({hash(text),value.base,(uint32_t)value.length,0,0,0});
+                value_label.push_back(lit->second);
+                value_last.push_back(UINT64_MAX);
+            }
+            auto id = vit->second;
+            if(value_last[id]==offset)continue;
+            value_last[id] = offset;
+            values[id].count++;
+            sequence.push_back(id);
+            offsets.push_back(offset);
+        }
+        current=current->children_range()->first;
+    }
+
+    //Sort labels by name and namespace, and values by label and hash.
+    std::vector<uint32_t> lorder;
+    for(size_t i=0;i<labels.size();i++){
+        if(labels[i].flags!=UINT32_MAX)lorder.push_back(i);
+    }
+    std::sort(lorder.begin(),lorder.end(),[&](uint32_t a, uint32_t b){return details::label_less(tree,labels[a],labels[b]);});
+    std::vector<uint32_t> lrank(labels.size());
+    for(size_t i=0;i<lorder.size();i++)lrank[lorder[i]]=i;
+
+    std::vector<uint32_t> vorder(values.size());
+    for(size_t i=0;i<vorder.size();i++)vorder[i]=i;
+    std::sort(vorder.begin(),vorder.end(),[&](uint32_t a, uint32_t b){
+        if(lrank[value_label[a]]!=lrank[value_label[b]])return lrank[value_label[a]]<lrank[value_label[b]];
+        return values[a].hash<values[b].hash;
+    });
+    std::vector<uint32_t> vrank(values.size());
+    std::vector<value_t> vsorted(values.size());
+    std::vector<label_t> lsorted(lorder.size());
+    for(size_t i=0;i<lorder.size();i++)lsorted[i]=labels[lorder[i]];
+    uint64_t first = 0;
+    for(size_t i=0;i<vorder.size();i++){
+        vrank[vorder[i]]=i;
+        vsorted[i]=values[vorder[i]];
+        vsorted[i].first=first;
+        first+=vsorted[i].count;
+        auto& label = lsorted[lrank[value_label[vorder[i]]]];
+        if(label.count==0)label.first=i;
+        label.count++;
+    }
+
+    header_t header;
+    header.width = postings_t::width_for(tree);
+    header.flags = selected.size()==0?COMPLETE:0;
+    header.labels = lsorted.size();
+    header.values = vsorted.size();
+    header.postings = offsets.size();
+
+    size_t head = sizeof(header_t)+sizeof(label_t)*lsorted.size()+sizeof(value_t)*vsorted.size();
+    std::vector<uint8_t> data(head+header.width*offsets.size());
+    std::memcpy(data.data(),&header,sizeof(header));
+    std::memcpy(data.data()+sizeof(header),lsorted.data(),sizeof(label_t)*lsorted.size());
+    std::memcpy(data.data()+sizeof(header)+sizeof(label_t)*lsorted.size(),vsorted.data(),sizeof(value_t)*vsorted.size());
+
+    //Second pass: postings of each value, in the order they were recorded.
+    std::vector<uint64_t> cursor(vsorted.size());
+    for(size_t i=0;i<vsorted.size();i++)cursor[i]=vsorted[i].first;
+    for(size_t i=0;i<sequence.size();i++){
+        postings_t::store(data.data()+head,header.width,cursor[vrank[sequence[i]]]++,offsets[i]);
+    }
+
+    return AttrIndex(std::move(data));
+}
+
+std::expected<AttrIndex,AttrIndex::from_binary_error_t> AttrIndex::from_binary(std::span<const uint8_t> region, uint32_t doc){
+    if(region.size_bytes()<sizeof(binary_header_t))return std::unexpected(from_binary_error_t::Missing);
+    auto payload = binary_extension(region,extension_kind_t::ATTR_INDEX,doc);
+    if(!payload.has_value())return std::unexpected(from_binary_error_t::Missing);
+
+    if(payload->size_bytes()<sizeof(header_t))return std::unexpected(from_binary_error_t::HeaderTooSmall);
+    header_t header;
+    std::memcpy(&header,payload->data(),sizeof(header));
+    if(std::memcmp(header.magic,"$XAI",4)!=0 || (header.width!=4 && header.width!=8))return std::unexpected(from_binary_error_t::MagicMismatch);
+    uint64_t available = payload->size_bytes()-sizeof(header_t);
+    if(header.labels>available/sizeof(label_t))return std::unexpected(from_binary_error_t::TruncatedSpan);
+    available-=sizeof(label_t)*header.labels;
+    if(header.values>available/sizeof(value_t))return std::unexpected(from_binary_error_t::TruncatedSpan);
+    available-=sizeof(value_t)*header.values;
+    if(header.postings>available/header.width || available!=header.width*header.postings)
+        return std::unexpected(from_binary_error_t::TruncatedSpan);
+
+    //Labels point into the value table and values into the postings, which are offsets within the document.
+    const binary_header_t& bin = *(const binary_header_t*)region.data();
+    if(doc>=bin.docs_count)return std::unexpected(from_binary_error_t::OutOfBounds);
+    uint64_t limit = bin.sections[doc].length;
+
+    AttrIndex ret(*payload);
+    for(auto& label : ret.labels()){
+        if(label.first>header.values || label.count>header.values-label.first)return std::unexpected(from_binary_error_t::OutOfBounds);
+        if(!details::in_symbols(label.ns_base,label.ns_length,bin.length_of_symbols) || !details::in_symbols(label.name_base,label.name_length,bin.length_of_symbols))
+            return std::unexpected(from_binary_error_t::OutOfBounds);
+    }
+    for(auto& value : ret.values()){
+        if(value.first>header.postings || value.count>header.postings-value.first)return std::unexpected(from_binary_error_t::OutOfBounds);
+        if(!ret.postings().valid(value.first,value.count,limit))return std::unexpected(from_binary_error_t::OutOfBounds);
+        if(!details::in_symbols(value.base,value.length,bin.length_of_symbols))return std::unexpected(from_binary_error_t::OutOfBounds);
+    }
+    return ret;
+}
+
+std::pair<size_t,size_t> AttrIndex::find(const TreeRaw& tree, std::string_view name) const{
+    return details::find_label(tree,labels(),name);
+}
+
+std::optional<size_t> AttrIndex::find(const TreeRaw& tree, std::string_view ns, std::string_view name) const{
+    return details::find_label(tree,labels(),ns,name);
+}
+
+bool AttrIndex::covers(const TreeRaw& tree, std::optional<std::string_view> ns, std::string_view name) const{
+    if(header().flags&COMPLETE)return true;
+    if(ns.has_value()){
+        //Labels not occurring in the tree have no entry, so a selective index cannot tell them apart from those not selected.
+        return find(tree,*ns,name).has_value();
+    }
+    auto [a,b] = find(tree,name);
+    if(a==b)return false;
+    for(;a<b;a++){
+        if(!(labels()[a].flags&ALL_NS))return false;
+    }
+    return true;
+}
+
+std::optional<size_t> AttrIndex::find_value(const TreeRaw& tree, size_t label, std::string_view value) const{
+    auto& l = labels()[label];
+    auto v = values();
+    auto h = hash(value);
+    auto it = std::partition_point(v.begin()+l.first,v.begin()+l.first+l.count,[&](const value_t& e){return e.hash<h;});
+    for(;it!=v.begin()+l.first+l.count && it->hash==h;it++){
+        if(wrp::sv(tree,sv((std::ptrdiff_t)it->base,(size_t)it->length))==value)return it-v.begin();
+    }
+    return {};
+}
+
+}
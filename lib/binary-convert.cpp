@@ -0,0 +1,459 @@
+#include <cstring>
+#include <optional>
+#include <vector>
+
+#include <vs-xml/binary-convert.hpp>
+#include <vs-xml/node.hpp>
+
+namespace VS_XML_NS{
+
+namespace{
+
+/*
+    Offsets of the fields in nodes and headers for each layout, as laid out by the compiler for the types selected in commons.hpp.
+    Bit-fields (node types and flags, builder configs, type sizes) are allocated from the least significant bit on little-endian
+    targets and from the most significant one on big-endian targets, so they are handled explicitly.
+*/
+struct layout_info_t{
+    uint8_t delta, size, count, enum_size;      //Sizes of delta_ptr_t, xml_size_t, xml_count_t and xml_enum_size_t
+    size_t  sv_length;                          //Offset of the length in sv, base being at 0
+    size_t  sv_size;
+    struct{size_t parent, prev, next, attrs_count, ns, name, size;} element;
+    size_t  attr_size;                          //Made of three sv (ns, name and value)
+    struct{size_t parent, prev, value, size;} leaf;
+    size_t  section_size;                       //Packed, as {{delta, count}, delta, count}
+};
+
+constexpr layout_info_t layouts[] = {
+    {8,8,8,8, 8,16, {8,16,24,32,40,56,72}, 48, {8,16,24,40}, 32},
+    {4,4,2,1, 4,8,  {4,8,12,16,20,28,36},  24, {4,8,12,20},  12},
+};
+
+static_assert(sizeof(element_t)==layouts[VS_XML_LAYOUT].element.size, "Layout of element_t not matching the converter");
+static_assert(sizeof(attr_t)==layouts[VS_XML_LAYOUT].attr_size, "Layout of attr_t not matching the converter");
+static_assert(sizeof(text_t)==layouts[VS_XML_LAYOUT].leaf.size, "Layout of leaf nodes not matching the converter");
+static_assert(sizeof(sv)==layouts[VS_XML_LAYOUT].sv_size, "Layout of sv not matching the converter");
+static_assert(sizeof(binary_header_t::section_t)==layouts[VS_XML_LAYOUT].section_size, "Layout of section_t not matching the converter");
+
+constexpr size_t header_size = offsetof(binary_header_t,sections);
+static_assert(header_size==24, "Fixed part of binary_header_t not matching the converter");
+
+inline uint64_t load(const uint8_t* ptr, unsigned width, bool big){
+    uint64_t ret = 0;
+    for(unsigned i=0;i<width;i++)ret|=(uint64_t)ptr[big?width-1-i:i]<<(8*i);
+    return ret;
+}
+
+inline int64_t load_signed(const uint8_t* ptr, unsigned width, bool big){
+    uint64_t ret = load(ptr,width,big);
+    if(width<8 && (ret>>(8*width-1))&1)ret|=~0ull<<(8*width);
+    return (int64_t)ret;
+}
+
+inline void store(uint8_t* ptr, unsigned width, bool big, uint64_t value){
+    for(unsigned i=0;i<width;i++)ptr[big?width-1-i:i]=(uint8_t)(value>>(8*i));
+}
+
+inline bool fits_signed(int64_t value, unsigned width){
+    return width==8 || (value>=-(int64_t(1)<<(8*width-1)) && value<(int64_t(1)<<(8*width-1)));
+}
+
+inline bool fits(uint64_t value, unsigned width){
+    return width==8 || value<(uint64_t(1)<<(8*width));
+}
+
+//Flags after the type of nodes (_bit0 to _bit3), in order.
+inline uint8_t reverse4(uint8_t v){return ((v&1)<<3)|((v&2)<<1)|((v&4)>>1)|((v&8)>>3);}
+
+inline std::pair<uint8_t,uint8_t> load_type(uint8_t byte, bool big){
+    if(big)return {byte>>4,reverse4(byte&0xf)};
+    return {byte&0xf,byte>>4};
+}
+
+inline uint8_t store_type(uint8_t type, uint8_t flags, bool big){
+    if(big)return (type<<4)|reverse4(flags);
+    return type|(flags<<4);
+}
+
+//Header fields, independent from the layout of the binary.
+struct header_info_t{
+    uint8_t     format_major;
+    uint8_t     format_minor;
+    uint8_t     symbols;
+    bool        raw_strings, allow_comments, allow_procs;
+    bool        big;
+    size_t      layout;
+    uint16_t    docs_count;
+    uint16_t    extensions_count;
+    uint64_t    length_of_symbols;
+
+    inline const layout_info_t& info() const{return layouts[layout];}
+    inline size_t size() const{return header_size+info().section_size*docs_count;}
+    //Same padding as binary_header_t::start_data
+    inline size_t start_data() const{return size()+length_of_symbols+(16-(size()+length_of_symbols)%16);}
+};
+
+std::expected<header_info_t, convert_error_t> load_header(std::span<const uint8_t> region){
+    if(region.size_bytes()<header_size)return std::unexpected(convert_error_t{convert_error_t::HeaderTooSmall});
+    auto ptr = region.data();
+    if(std::memcmp(ptr,"$XML",4)!=0)return std::unexpected(convert_error_t{convert_error_t::MagicMismatch});
+
+    header_info_t ret;
+    ret.format_major = ptr[4];
+    ret.format_minor = ptr[5];
+    if(ret.format_major!=format_major)return std::unexpected(convert_error_t{convert_error_t::MajorVersionMismatch});
+    if(ret.format_minor>format_minor)return std::unexpected(convert_error_t{convert_error_t::MinorVersionTooHigh});
+
+    //The byte order is the one in which the endianess flag and the type sizes are consistent.
+    std::optional<size_t> found;
+    for(bool big : {false,true}){
+        bool flag = big?(ptr[7]>>7)&1:ptr[7]&1;
+        if(flag!=big)continue;
+        uint32_t sizes = load(ptr+8,4,big);
+        uint8_t delta, size, count, enum_size;
+        if(big){delta=sizes>>26;size=(sizes>>20)&63;count=(sizes>>14)&63;enum_size=(sizes>>8)&63;}
+        else{delta=sizes&63;size=(sizes>>6)&63;count=(sizes>>12)&63;enum_size=(sizes>>18)&63;}
+        for(size_t i=0;i<std::size(layouts);i++){
+            auto& info = layouts[i];
+            if(info.delta==delta && info.size==size && info.count==count && info.enum_size==enum_size){ret.big=big;found=i;break;}
+        }
+        if(found.has_value())break;
+    }
+    if(!found.has_value())return std::unexpected(convert_error_t{convert_error_t::UnknownLayout});
+    ret.layout = *found;
+
+    uint8_t configs = ptr[6];
+    if(ret.big){
+        ret.symbols=configs>>5;ret.raw_strings=(configs>>4)&1;ret.allow_comments=(configs>>3)&1;ret.allow_procs=(configs>>2)&1;
+    }
+    else{
+        ret.symbols=configs&7;ret.raw_strings=(configs>>3)&1;ret.allow_comments=(configs>>4)&1;ret.allow_procs=(configs>>5)&1;
+    }
+    ret.docs_count = load(ptr+12,2,ret.big);
+    ret.extensions_count = load(ptr+14,2,ret.big);
+    ret.length_of_symbols = load(ptr+16,8,ret.big);
+
+    if(region.size_bytes()<ret.size())return std::unexpected(convert_error_t{convert_error_t::HeaderTooSmall});
+    if(ret.length_of_symbols>region.size_bytes() || region.size_bytes()<ret.start_data()+sizeof(binary_header_t::extension_t)*ret.extensions_count)
+        return std::unexpected(convert_error_t{convert_error_t::TruncatedSpan});
+    return ret;
+}
+
+void store_header(uint8_t* ptr, const header_info_t& header){
+    std::memcpy(ptr,"$XML",4);
+    ptr[4] = header.format_major;
+    ptr[5] = header.format_minor;
+    auto& info = header.info();
+    if(header.big){
+        ptr[6] = (header.symbols<<5)|(header.raw_strings<<4)|(header.allow_comments<<3)|(header.allow_procs<<2);
+        ptr[7] = 0x80;
+        store(ptr+8,4,true,((uint32_t)info.delta<<26)|((uint32_t)info.size<<20)|((uint32_t)info.count<<14)|((uint32_t)info.enum_size<<8));
+    }
+    else{
+        ptr[6] = header.symbols|(header.raw_strings<<3)|(header.allow_comments<<4)|(header.allow_procs<<5);
+        ptr[7] = 0;
+        store(ptr+8,4,false,info.delta|((uint32_t)info.size<<6)|((uint32_t)info.count<<12)|((uint32_t)info.enum_size<<18));
+    }
+    store(ptr+12,2,header.big,header.docs_count);
+    store(ptr+14,2,header.big,header.extensions_count);
+    store(ptr+16,8,header.big,header.length_of_symbols);
+}
+
+//Output through a fixed size window. Bytes which already left the window are patched by seeking back.
+struct writer_t{
+    static constexpr size_t capacity = 1<<20;
+
+    std::ostream&           out;
+    std::streampos          origin;
+    std::vector<uint8_t>    window;
+    uint64_t                flushed = 0;
+    convert_error_t::Code   error = convert_error_t::OK;
+
+    writer_t(std::ostream& out):out(out),origin(out.tellp()){window.reserve(capacity);}
+
+    inline uint64_t tell() const{return flushed+window.size();}
+
+    void flush(){
+        if(window.size()==0)return;
+        out.write((const char*)window.data(),window.size());
+        if(!out.good() && error==convert_error_t::OK)error=convert_error_t::WriteFailed;
+        flushed+=window.size();
+        window.clear();
+    }
+
+    //Zeroed space for `n` bytes, which must not exceed the capacity.
+    uint8_t* reserve(size_t n){
+        if(window.size()+n>capacity)flush();
+        auto size = window.size();
+        window.resize(size+n);
+        return window.data()+size;
+    }
+
+    void write(const uint8_t* data, size_t n){
+        while(n>0){
+            size_t chunk = std::min(n,capacity);
+            std::memcpy(reserve(chunk),data,chunk);
+            data+=chunk;
+            n-=chunk;
+        }
+    }
+
+    void pad(size_t n){
+        while(n>0){
+            size_t chunk = std::min(n,capacity);
+            reserve(chunk);
+            n-=chunk;
+        }
+    }
+
+    void patch(uint64_t pos, const uint8_t* data, size_t n){
+        if(pos<flushed){
+            size_t before = std::min<uint64_t>(n,flushed-pos);
+            if(origin==std::streampos(-1)){
+                if(error==convert_error_t::OK)error=convert_error_t::NotSeekable;
+                return;
+            }
+            auto end = out.tellp();
+            out.seekp(origin+std::streamoff(pos));
+            out.write((const char*)data,before);
+            out.seekp(end);
+            if(!out.good() && error==convert_error_t::OK)error=convert_error_t::WriteFailed;
+            pos+=before;
+            data+=before;
+            n-=before;
+        }
+        if(n>0)std::memcpy(window.data()+(pos-flushed),data,n);
+    }
+};
+
+struct converter_t{
+    std::span<const uint8_t>    data;       //Data of the source binary, sections are relative to it
+    const header_info_t&        from;
+    const header_info_t&        to;
+    writer_t&                   w;
+
+    static constexpr uint64_t none = -1;
+
+    inline const layout_info_t& src() const{return from.info();}
+    inline const layout_info_t& dst() const{return to.info();}
+
+    //Empty views might have any base, which is dropped if not fitting the target.
+    bool convert_sv(const uint8_t* in, uint8_t* out){
+        int64_t base = load_signed(in,src().delta,from.big);
+        uint64_t length = load(in+src().sv_length,src().count,from.big);
+        if(length==0 && !fits_signed(base,dst().delta))base=0;
+        if(!fits_signed(base,dst().delta) || !fits(length,dst().count))return false;
+        store(out,dst().delta,to.big,base);
+        store(out+dst().sv_length,dst().count,to.big,length);
+        return true;
+    }
+
+    bool convert_delta(int64_t value, uint8_t* out){
+        if(!fits_signed(value,dst().delta))return false;
+        store(out,dst().delta,to.big,value);
+        return true;
+    }
+
+    //Size of a section once converted, visiting its nodes in order without following the structure.
+    std::expected<uint64_t, convert_error_t> measure(uint64_t base, uint64_t length){
+        uint64_t ret = 0;
+        for(uint64_t offset=0;offset<length;){
+            auto node = data.data()+base+offset;
+            auto [type,flags] = load_type(node[0],from.big);
+            if(type==(uint8_t)type_t::ELEMENT){
+                if(length-offset<src().element.size)return std::unexpected(convert_error_t{convert_error_t::TreeOutOfBounds});
+                uint64_t attrs = load(node+src().element.attrs_count,src().count,from.big);
+                if(attrs>(length-offset-src().element.size)/src().attr_size)return std::unexpected(convert_error_t{convert_error_t::TreeOutOfBounds});
+                offset+=src().element.size+attrs*src().attr_size;
+                ret+=dst().element.size+attrs*dst().attr_size;
+            }
+            else if(type>=(uint8_t)type_t::TEXT && type<=(uint8_t)type_t::MARKER){
+                if(length-offset<src().leaf.size)return std::unexpected(convert_error_t{convert_error_t::TreeOutOfBounds});
+                offset+=src().leaf.size;
+                ret+=dst().leaf.size;
+            }
+            else return std::unexpected(convert_error_t{convert_error_t::TreeOutOfBounds});
+        }
+        return ret;
+    }
+
+    //Write a section, rebuilding links from the subtree sizes of elements.
+    std::expected<void, convert_error_t> convert(uint64_t base, uint64_t length){
+        auto fail = [](convert_error_t::Code code){return std::unexpected(convert_error_t{code});};
+        struct open_t{
+            uint64_t    end;        //In the source section
+            uint64_t    pos;        //Of the element in the output
+            uint64_t    last;       //Last child written
+        };
+        std::vector<open_t> stack;
+        stack.push_back({length,none,none});
+
+        auto close = [&]()->bool{
+            auto& top = stack.back();
+            uint8_t tmp[8];
+            int64_t size = w.tell()-top.pos;
+            if(!fits_signed(size,dst().delta))return false;
+            store(tmp,dst().delta,to.big,size);
+            w.patch(top.pos+dst().element.next,tmp,dst().delta);
+            stack.pop_back();
+            return true;
+        };
+
+        for(uint64_t offset=0;;){
+            while(stack.size()>1 && offset==stack.back().end){
+                if(!close())return fail(convert_error_t::Overflow);
+            }
+            if(offset==length)break;
+            if(offset>stack.back().end)return fail(convert_error_t::TreeOutOfBounds);
+
+            auto node = data.data()+base+offset;
+            auto [type,flags] = load_type(node[0],from.big);
+            auto& top = stack.back();
+            uint64_t pos = w.tell();
+            int64_t parent = top.pos==none?0:(int64_t)(top.pos-pos);
+            int64_t prev = top.last==none?0:(int64_t)(top.last-pos);
+            top.last = pos;
+
+            if(type==(uint8_t)type_t::ELEMENT){
+                auto& s = src().element;
+                auto& d = dst().element;
+                uint64_t attrs = load(node+s.attrs_count,src().count,from.big);
+                int64_t next = load_signed(node+s.next,src().delta,from.big);
+                uint64_t children = s.size+attrs*src().attr_size;
+                if(next<0 || (uint64_t)next<children || (uint64_t)next>top.end-offset)return fail(convert_error_t::TreeOutOfBounds);
+                if(!fits(attrs,dst().count))return fail(convert_error_t::Overflow);
+
+                auto out = w.reserve(d.size);
+                out[0] = store_type(type,flags,to.big);
+                if(!convert_delta(parent,out+d.parent) || !convert_delta(prev,out+d.prev))return fail(convert_error_t::Overflow);
+                store(out+d.attrs_count,dst().count,to.big,attrs);
+                if(!convert_sv(node+s.ns,out+d.ns) || !convert_sv(node+s.name,out+d.name))return fail(convert_error_t::Overflow);
+                for(uint64_t i=0;i<attrs;i++){
+                    auto in = node+s.size+i*src().attr_size;
+                    auto attr = w.reserve(dst().attr_size);
+                    for(size_t j=0;j<3;j++){
+                        if(!convert_sv(in+j*src().sv_size,attr+j*dst().sv_size))return fail(convert_error_t::Overflow);
+                    }
+                }
+                stack.push_back({offset+next,pos,none});
+                offset+=children;
+            }
+            else if(type>=(uint8_t)type_t::TEXT && type<=(uint8_t)type_t::MARKER){
+                auto& s = src().leaf;
+                auto& d = dst().leaf;
+                if(s.size>top.end-offset)return fail(convert_error_t::TreeOutOfBounds);
+                auto out = w.reserve(d.size);
+                out[0] = store_type(type,flags,to.big);
+                if(!convert_delta(parent,out+d.parent) || !convert_delta(prev,out+d.prev))return fail(convert_error_t::Overflow);
+                if(!convert_sv(node+s.value,out+d.value))return fail(convert_error_t::Overflow);
+                offset+=s.size;
+            }
+            else return fail(convert_error_t::TreeOutOfBounds);
+        }
+        return {};
+    }
+};
+
+}
+
+std::expected<binary_layout_t, convert_error_t> binary_layout(std::span<const uint8_t> region){
+    auto header = load_header(region);
+    if(!header.has_value())return std::unexpected(header.error());
+    return binary_layout_t{(uint8_t)header->layout,header->big?binary_header_t::endianess_t::BIG:binary_header_t::endianess_t::LITTLE};
+}
+
+std::expected<size_t, convert_error_t> convert_binary(std::span<const uint8_t> region, std::ostream& out, binary_layout_t target){
+    auto fail = [](convert_error_t::Code code){return std::unexpected(convert_error_t{code});};
+    if(target.layout>=std::size(layouts))return fail(convert_error_t::UnknownLayout);
+
+    auto from = load_header(region);
+    if(!from.has_value())return std::unexpected(from.error());
+
+    //Only the extensions which do not depend on the layout are kept.
+    struct extension_t{
+        uint32_t                    doc;
+        uint16_t                    flags;
+        std::span<const uint8_t>    payload;
+    };
+    std::vector<extension_t> kept;
+    for(size_t i=0;i<from->extensions_count;i++){
+        auto entry = region.data()+region.size_bytes()-sizeof(binary_header_t::extension_t)*(from->extensions_count-i);
+        uint16_t kind = load(entry,2,from->big);
+        if(kind!=(uint16_t)extension_kind_t::ARCHIVE_NAMES)continue;
+        uint64_t base = load(entry+8,8,from->big), length = load(entry+16,8,from->big);
+        if(base>region.size_bytes() || length>region.size_bytes()-base || length%4!=0)return fail(convert_error_t::TruncatedSpan);
+        kept.push_back({(uint32_t)load(entry+4,4,from->big),(uint16_t)load(entry+2,2,from->big),region.subspan(base,length)});
+    }
+
+    header_info_t to = *from;
+    to.layout = target.layout;
+    to.big = target.endianess==binary_header_t::endianess_t::BIG;
+    to.extensions_count = kept.size();
+    auto& src = from->info();
+    auto& dst = to.info();
+
+    auto data = region.subspan(from->start_data());
+    size_t data_length = data.size_bytes()-sizeof(binary_header_t::extension_t)*from->extensions_count;
+
+    writer_t w(out);
+    converter_t converter{data,*from,to,w};
+
+    //Sections are measured first, as the header comes before them.
+    std::vector<uint8_t> header(to.size());
+    uint64_t offset = 0;
+    for(size_t i=0;i<from->docs_count;i++){
+        auto in = region.data()+header_size+src.section_size*i;
+        int64_t base = load_signed(in+src.delta+src.count,src.delta,from->big);
+        uint64_t length = load(in+2*src.delta+src.count,src.count,from->big);
+        if(base<0 || (uint64_t)base>data_length || length>data_length-base)return fail(convert_error_t::TreeOutOfBounds);
+        auto size = converter.measure(base,length);
+        if(!size.has_value())return std::unexpected(size.error());
+
+        auto section = header.data()+header_size+dst.section_size*i;
+        if(!converter.convert_sv(in,section))return fail(convert_error_t::Overflow);
+        if(!fits_signed(offset,dst.delta) || !fits(*size,dst.count))return fail(convert_error_t::Overflow);
+        store(section+dst.delta+dst.count,dst.delta,to.big,offset);
+        store(section+2*dst.delta+dst.count,dst.count,to.big,*size);
+        offset+=*size;
+    }
+    store_header(header.data(),to);
+    w.write(header.data(),header.size());
+
+    w.write(region.data()+from->size(),from->length_of_symbols);
+    w.pad(to.start_data()-to.size()-to.length_of_symbols);
+
+    for(size_t i=0;i<from->docs_count;i++){
+        auto in = region.data()+header_size+src.section_size*i;
+        int64_t base = load_signed(in+src.delta+src.count,src.delta,from->big);
+        uint64_t length = load(in+2*src.delta+src.count,src.count,from->big);
+        if(auto ret = converter.convert(base,length); !ret.has_value())return std::unexpected(ret.error());
+        if(w.error!=convert_error_t::OK)return fail(w.error);
+    }
+
+    //Same placement as details::save_extensions.
+    if(kept.size()!=0){
+        std::vector<uint8_t> table(sizeof(binary_header_t::extension_t)*kept.size());
+        for(size_t i=0;i<kept.size();i++){
+            w.pad(w.tell()%16==0?0:16-w.tell()%16);
+            auto entry = table.data()+i*sizeof(binary_header_t::extension_t);
+            store(entry,2,to.big,(uint16_t)extension_kind_t::ARCHIVE_NAMES);
+            store(entry+2,2,to.big,kept[i].flags);
+            store(entry+4,4,to.big,kept[i].doc);
+            store(entry+8,8,to.big,w.tell());
+            store(entry+16,8,to.big,kept[i].payload.size_bytes());
+            for(size_t j=0;j<kept[i].payload.size_bytes();j+=4){
+                store(w.reserve(4),4,to.big,load(kept[i].payload.data()+j,4,from->big));
+            }
+        }
+        w.pad(w.tell()%16==0?0:16-w.tell()%16);
+        w.write(table.data(),table.size());
+    }
+
+    w.flush();
+    out.flush();
+    if(w.error!=convert_error_t::OK)return fail(w.error);
+    if(!out.good())return fail(convert_error_t::WriteFailed);
+    return w.tell();
+}
+
+}
@@ -0,0 +1,257 @@
+#include <array>
+#include <bit>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE4_2__) || ((defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__))
+#include <nmmintrin.h>
+#define VS_XML_CRC32C_X86
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#include <vs-xml/checksum.hpp>
+#include <vs-xml/executor.hpp>
+
+namespace VS_XML_NS{
+
+namespace{
+
+constexpr uint32_t poly = 0x82f63b78;   //Castagnoli, reflected
+
+//Tables for slicing by 8, only used without hardware support.
+constexpr auto tables = []{
+    std::array<std::array<uint32_t,256>,8> ret{};
+    for(uint32_t i=0;i<256;i++){
+        uint32_t crc = i;
+        for(int j=0;j<8;j++)crc = (crc&1)?(crc>>1)^poly:crc>>1;
+        ret[0][i] = crc;
+    }
+    for(size_t t=1;t<8;t++)
+        for(uint32_t i=0;i<256;i++)ret[t][i] = (ret[t-1][i]>>8)^ret[0][ret[t-1][i]&0xff];
+    return ret;
+}();
+
+uint32_t crc32c_sw(uint32_t crc, const uint8_t* data, size_t length){
+    if constexpr(std::endian::native==std::endian::little){
+        for(;length>=8;length-=8,data+=8){
+            uint64_t word;
+            std::memcpy(&word,data,8);
+            word ^= crc;
+            crc =   tables[7][word&0xff] ^ tables[6][(word>>8)&0xff] ^ tables[5][(word>>16)&0xff] ^ tables[4][(word>>24)&0xff] ^
+                    tables[3][(word>>32)&0xff] ^ tables[2][(word>>40)&0xff] ^ tables[1][(word>>48)&0xff] ^ tables[0][word>>56];
+        }
+    }
+    for(;length>0;length--,data++)crc = (crc>>8)^tables[0][(crc^*data)&0xff];
+    return crc;
+}
+
+#if defined(VS_XML_CRC32C_X86)
+
+#if !defined(__SSE4_2__)
+__attribute__((target("sse4.2")))
+#endif
+uint32_t crc32c_hw(uint32_t crc, const uint8_t* data, size_t length){
+#if defined(__x86_64__)
+    uint64_t crc64 = crc;
+    for(;length>=8;length-=8,data+=8){
+        uint64_t word;
+        std::memcpy(&word,data,8);
+        crc64 = _mm_crc32_u64(crc64,word);
+    }
+    crc = (uint32_t)crc64;
+#endif
+    for(;length>=4;length-=4,data+=4){
+        uint32_t word;
+        std::memcpy(&word,data,4);
+        crc = _mm_crc32_u32(crc,word);
+    }
+    for(;length>0;length--,data++)crc = _mm_crc32_u8(crc,*data);
+    return crc;
+}
+
+inline bool has_hw(){
+#if defined(__SSE4_2__)
+    return true;
+#else
+    static const bool ret = __builtin_cpu_supports("sse4.2");
+    return ret;
+#endif
+}
+
+#elif defined(__ARM_FEATURE_CRC32)
+
+uint32_t crc32c_hw(uint32_t crc, const uint8_t* data, size_t length){
+    for(;length>=8;length-=8,data+=8){
+        uint64_t word;
+        std::memcpy(&word,data,8);
+        crc = __crc32cd(crc,word);
+    }
+    for(;length>0;length--,data++)crc = __crc32cb(crc,*data);
+    return crc;
+}
+
+constexpr bool has_hw(){return true;}
+
+#else
+
+inline uint32_t crc32c_hw(uint32_t crc, const uint8_t* data, size_t length){return crc32c_sw(crc,data,length);}
+
+constexpr bool has_hw(){return false;}
+
+#endif
+
+//Product of two polynomials modulo the generator, bits reflected.
+constexpr uint32_t multmodp(uint32_t a, uint32_t b){
+    uint32_t p = 0;
+    for(uint32_t m = 1u<<31;m!=0;m>>=1){
+        if(a&m)p ^= b;
+        b = (b&1)?(b>>1)^poly:b>>1;
+    }
+    return p;
+}
+
+//x^(2^n) modulo the generator.
+constexpr auto x2n = []{
+    std::array<uint32_t,32> ret{};
+    uint32_t p = 1u<<30;    //x^1
+    for(size_t n=0;n<32;n++){
+        ret[n] = p;
+        p = multmodp(p,p);
+    }
+    return ret;
+}();
+
+//Checksum of the concatenation of two blocks, given their checksums and the length of the second one.
+uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, uint64_t length2){
+    uint32_t p = 1u<<31;    //x^0
+    for(size_t k=3;length2!=0;length2>>=1,k++)
+        if(length2&1)p = multmodp(x2n[k&31],p);
+    return multmodp(p,crc1)^crc2;
+}
+
+//Large sections are checked in chunks of this size, so that a single document is also split across threads.
+constexpr size_t chunk_size = 4<<20;
+
+struct layout_t{
+    std::span<const uint8_t>    header;
+    std::span<const uint8_t>    symbols;
+    std::span<const uint8_t>    data;
+    const binary_header_t*      head;
+    std::vector<uint32_t>       sums;       //Header, symbols and then each document
+
+    std::span<const uint8_t> document(size_t i) const{
+        auto section = head->region(i);
+        return data.subspan(section.base,section.length);
+    }
+};
+
+//Only the header is read, the checksums are what tells whether the rest is fine.
+std::expected<layout_t, checksum_error_t> locate(std::span<const uint8_t> region){
+    if(region.size_bytes()<sizeof(binary_header_t))return std::unexpected(checksum_error_t{checksum_error_t::Malformed});
+    const binary_header_t& header = *(const binary_header_t*)region.data();
+    auto endianess = std::endian::native==std::endian::little?binary_header_t::endianess_t::LITTLE:binary_header_t::endianess_t::BIG;
+    if  (
+            std::memcmp(header.magic,"$XML",4)!=0 || header.endianess!=endianess ||
+            header.size__delta_ptr!=sizeof(delta_ptr_t) || header.size__xml_count!=sizeof(xml_count_t) ||
+            header.size__xml_enum_size!=sizeof(xml_enum_size_t) || header.size__xml_size!=sizeof(xml_size_t)
+        ) return std::unexpected(checksum_error_t{checksum_error_t::Malformed});
+    if(region.size_bytes()<header.size() || header.length_of_symbols>region.size_bytes() ||
+       region.size_bytes()<header.start_data()+sizeof(binary_header_t::extension_t)*header.extensions_count)
+        return std::unexpected(checksum_error_t{checksum_error_t::Malformed});
+
+    layout_t ret{
+        region.first(header.size()),
+        region.subspan(header.size(),header.length_of_symbols),
+        region.subspan(header.start_data()),
+        &header,
+        {}
+    };
+    for(size_t i=0;i<header.docs_count;i++){
+        auto section = header.region(i);
+        if(section.base<0 || (uint64_t)section.base>ret.data.size() || (uint64_t)section.length>ret.data.size()-section.base)
+            return std::unexpected(checksum_error_t{checksum_error_t::Malformed});
+    }
+
+    auto payload = binary_extension(region,extension_kind_t::CHECKSUMS,0);
+    if(!payload.has_value())return std::unexpected(checksum_error_t{checksum_error_t::Missing});
+    if(payload->size_bytes()!=sizeof(uint32_t)*(2+header.docs_count))return std::unexpected(checksum_error_t{checksum_error_t::Malformed});
+    ret.sums.resize(2+header.docs_count);
+    std::memcpy(ret.sums.data(),payload->data(),payload->size_bytes());
+    return ret;
+}
+
+checksum_error_t mismatch(size_t entry){
+    if(entry==0)return {checksum_error_t::Header};
+    if(entry==1)return {checksum_error_t::Symbols};
+    return {checksum_error_t::Document,entry-2};
+}
+
+}
+
+uint32_t crc32c(std::span<const uint8_t> data, uint32_t crc){
+    crc = ~crc;
+    if(has_hw())crc = crc32c_hw(crc,data.data(),data.size_bytes());
+    else crc = crc32c_sw(crc,data.data(),data.size_bytes());
+    return ~crc;
+}
+
+std::expected<void, checksum_error_t> verify_checksums(std::span<const uint8_t> region, Executor* executor){
+    auto layout = locate(region);
+    if(!layout.has_value())return std::unexpected(layout.error());
+
+    std::vector<std::span<const uint8_t>> entries;
+    entries.reserve(layout->sums.size());
+    entries.push_back(layout->header);
+    entries.push_back(layout->symbols);
+    for(size_t i=0;i<layout->head->docs_count;i++)entries.push_back(layout->document(i));
+
+    if(executor==nullptr){
+        for(size_t i=0;i<entries.size();i++)
+            if(crc32c(entries[i])!=layout->sums[i])return std::unexpected(mismatch(i));
+        return {};
+    }
+
+    //Entries are split in chunks checked in parallel, whose checksums are then combined.
+    struct chunk_t{
+        std::span<const uint8_t>    bytes;
+        uint32_t                    crc = 0;
+    };
+    struct ctx_t{
+        std::vector<chunk_t>    chunks;
+    } ctx;
+    std::vector<size_t> firsts(entries.size()+1);
+    for(size_t i=0;i<entries.size();i++){
+        firsts[i] = ctx.chunks.size();
+        auto bytes = entries[i];
+        do{
+            auto length = std::min(bytes.size(),chunk_size);
+            ctx.chunks.push_back({bytes.first(length)});
+            bytes = bytes.subspan(length);
+        }while(bytes.size()!=0);
+    }
+    firsts.back() = ctx.chunks.size();
+
+    auto task = +[](void* ptr, size_t begin, size_t end){
+        auto& ctx = *(ctx_t*)ptr;
+        for(size_t i=begin;i<end;i++)ctx.chunks[i].crc = crc32c(ctx.chunks[i].bytes);
+    };
+    executor->parallel_for(ctx.chunks.size(),task,&ctx);
+
+    for(size_t i=0;i<entries.size();i++){
+        uint32_t crc = ctx.chunks[firsts[i]].crc;
+        for(size_t j=firsts[i]+1;j<firsts[i+1];j++)crc = crc32c_combine(crc,ctx.chunks[j].crc,ctx.chunks[j].bytes.size());
+        if(crc!=layout->sums[i])return std::unexpected(mismatch(i));
+    }
+    return {};
+}
+
+std::expected<void, checksum_error_t> verify_checksum(std::span<const uint8_t> region, size_t doc){
+    auto layout = locate(region);
+    if(!layout.has_value())return std::unexpected(layout.error());
+    if(doc>=layout->head->docs_count)return std::unexpected(checksum_error_t{checksum_error_t::Malformed});
+    if(crc32c(layout->document(doc))!=layout->sums[2+doc])return std::unexpected(mismatch(2+doc));
+    return {};
+}
+
+}
@@ -0,0 +1,146 @@
+#include <vs-xml/executor.hpp>
+
+namespace VS_XML_NS{
+
+namespace{
+    //Executor and queue the current thread is working for, if any.
+    thread_local const Executor* current_executor = nullptr;
+    thread_local size_t current_queue = 0;
+
+    struct split_ctx_t{
+        Executor*           executor;
+        Executor::group_t*  group;
+        Executor::fn_t      fn;
+        void*               ctx;
+        size_t              grain;
+    };
+
+    void split(void* ptr, size_t begin, size_t end){
+        auto& task = *(split_ctx_t*)ptr;
+        //Keep halving, leaving the upper half to be stolen.
+        while(end-begin>task.grain){
+            size_t mid = begin+(end-begin)/2;
+            task.executor->spawn(*task.group,split,ptr,mid,end);
+            end = mid;
+        }
+        task.fn(task.ctx,begin,end);
+    }
+
+    size_t default_threads(size_t threads){
+        if(threads!=0)return threads;
+        auto hw = std::thread::hardware_concurrency();
+        return hw>1?hw-1:0;
+    }
+}
+
+Executor::Executor(size_t threads):queues(default_threads(threads)+1){
+    workers.reserve(queues.size()-1);
+    for(size_t i=0;i<queues.size()-1;i++){
+        workers.emplace_back([this,i]{loop(i);});
+    }
+}
+
+Executor::~Executor(){
+    {
+        std::lock_guard guard(idle_lock);
+        stop = true;
+    }
+    idle.notify_all();
+    for(auto& worker : workers)worker.join();
+}
+
+size_t Executor::self() const{
+    return current_executor==this?current_queue:queues.size()-1;
+}
+
+void Executor::spawn(group_t& group, fn_t fn, void* ctx, size_t begin, size_t end){
+    group.pending.fetch_add(1,std::memory_order_relaxed);
+    {
+        auto& queue = queues[self()];
+        std::lock_guard guard(queue.lock);
+        queue.tasks.push_back({fn,ctx,begin,end,&group});
+    }
+    //Published under idle_lock, so that sleeping threads cannot miss it between their check and their wait.
+    {
+        std::lock_guard guard(idle_lock);
+        queued.fetch_add(1,std::memory_order_release);
+    }
+    idle.notify_one();
+}
+
+bool Executor::try_run(size_t self){
+    task_t task;
+    bool found = false;
+
+    //Newest task from the own queue, for locality.
+    {
+        auto& queue = queues[self];
+        std::lock_guard guard(queue.lock);
+        if(!queue.tasks.empty()){
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+            found = true;
+        }
+    }
+
+    //Else steal the oldest task from someone else.
+    for(size_t i=1;!found && i<queues.size();i++){
+        auto& queue = queues[(self+i)%queues.size()];
+        std::lock_guard guard(queue.lock);
+        if(!queue.tasks.empty()){
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+            found = true;
+        }
+    }
+
+    if(!found)return false;
+    queued.fetch_sub(1,std::memory_order_relaxed);
+    task.fn(task.ctx,task.begin,task.end);
+    //Wake up the thread waiting on the group, if this was its last task.
+    if(task.group->pending.fetch_sub(1,std::memory_order_acq_rel)==1){
+        std::lock_guard guard(idle_lock);
+        idle.notify_all();
+    }
+    return true;
+}
+
+void Executor::loop(size_t self){
+    current_executor = this;
+    current_queue = self;
+    while(true){
+        if(try_run(self))continue;
+        std::unique_lock guard(idle_lock);
+        idle.wait(guard,[this]{return stop.load() || queued.load(std::memory_order_acquire)>0;});
+        if(stop)return;
+    }
+}
+
+void Executor::wait(group_t& group){
+    //External threads run tasks as if they were a worker with the shared queue.
+    auto previous_executor = current_executor;
+    auto previous_queue = current_queue;
+    auto me = self();
+    current_executor = this;
+    current_queue = me;
+
+    while(group.pending.load(std::memory_order_acquire)>0){
+        if(try_run(me))continue;
+        //Sleep until the group is completed or new tasks can be helped with.
+        std::unique_lock guard(idle_lock);
+        idle.wait(guard,[&]{return group.pending.load(std::memory_order_acquire)==0 || queued.load(std::memory_order_acquire)>0;});
+    }
+
+    current_executor = previous_executor;
+    current_queue = previous_queue;
+}
+
+void Executor::parallel_for(size_t n, fn_t fn, void* ctx, size_t grain){
+    if(n==0)return;
+    group_t group;
+    split_ctx_t task{this,&group,fn,ctx,grain==0?1:grain};
+    spawn(group,split,&task,0,n);
+    wait(group);
+}
+
+}
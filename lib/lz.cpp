@@ -0,0 +1,131 @@
+#include <cstring>
+
+#include <vs-xml/lz.hpp>
+
+namespace VS_XML_NS{
+namespace lz{
+
+namespace{
+
+constexpr size_t min_match = 4;
+constexpr size_t hash_bits = 12;
+constexpr size_t max_distance = 65535;
+//Matches are not searched at the very end, so that reads of 4 bytes are never out of bounds.
+constexpr size_t tail = 12;
+
+inline uint32_t read32(const uint8_t* ptr){
+    uint32_t ret;
+    std::memcpy(&ret,ptr,sizeof(ret));
+    return ret;
+}
+
+inline uint32_t hash(uint32_t sequence){return (sequence*2654435761u)>>(32-hash_bits);}
+
+struct writer_t{
+    uint8_t*    ptr;
+    uint8_t*    end;
+
+    inline bool length(size_t value){
+        for(;value>=255;value-=255){
+            if(ptr==end)return false;
+            *ptr++=255;
+        }
+        if(ptr==end)return false;
+        *ptr++=value;
+        return true;
+    }
+
+    inline bool sequence(const uint8_t* literals, size_t count, size_t distance, size_t match){
+        if(ptr==end)return false;
+        uint8_t& token = *ptr++;
+        token = (count>=15?15:count)<<4;
+        if(count>=15 && !length(count-15))return false;
+        if((size_t)(end-ptr)<count)return false;
+        std::memcpy(ptr,literals,count);
+        ptr+=count;
+        if(match==0)return true;
+
+        if(end-ptr<2)return false;
+        *ptr++=distance&0xff;
+        *ptr++=distance>>8;
+        match-=min_match;
+        token|=match>=15?15:match;
+        return match<15 || length(match-15);
+    }
+};
+
+}
+
+size_t compress(std::span<const uint8_t> src, std::span<uint8_t> dst){
+    const uint8_t* base = src.data();
+    size_t length = src.size();
+    writer_t out{dst.data(),dst.data()+dst.size()};
+
+    uint32_t table[1<<hash_bits];
+    std::memset(table,0xff,sizeof(table));
+
+    size_t anchor = 0, pos = 0;
+    while(length>=tail && pos<length-tail){
+        uint32_t sequence = read32(base+pos);
+        auto& slot = table[hash(sequence)];
+        size_t candidate = slot;
+        slot = pos;
+        if(candidate==0xffffffff || pos-candidate>max_distance || read32(base+candidate)!=sequence){
+            //Skip faster through data which does not compress.
+            pos+=1+((pos-anchor)>>6);
+            continue;
+        }
+
+        size_t match = min_match;
+        while(pos+match<length-tail/2 && base[candidate+match]==base[pos+match])match++;
+        if(!out.sequence(base+anchor,pos-anchor,pos-candidate,match))return 0;
+        pos+=match;
+        anchor=pos;
+        if(pos>=2 && pos<length-tail)table[hash(read32(base+pos-2))]=pos-2;
+    }
+    if(!out.sequence(base+anchor,length-anchor,0,0))return 0;
+    return out.ptr-dst.data();
+}
+
+bool decompress(std::span<const uint8_t> src, std::span<uint8_t> dst){
+    const uint8_t* in = src.data();
+    const uint8_t* in_end = in+src.size();
+    uint8_t* out = dst.data();
+    uint8_t* out_end = out+dst.size();
+
+    auto length = [&](size_t& value)->bool{
+        for(;;){
+            if(in==in_end)return false;
+            uint8_t byte = *in++;
+            value+=byte;
+            if(byte!=255)return true;
+        }
+    };
+
+    while(in<in_end){
+        uint8_t token = *in++;
+        size_t count = token>>4;
+        if(count==15 && !length(count))return false;
+        if((size_t)(in_end-in)<count || (size_t)(out_end-out)<count)return false;
+        std::memcpy(out,in,count);
+        in+=count;
+        out+=count;
+        if(in==in_end)break;
+
+        if(in_end-in<2)return false;
+        size_t distance = in[0]|(in[1]<<8);
+        in+=2;
+        size_t match = token&15;
+        if(match==15 && !length(match))return false;
+        match+=min_match;
+        if(distance==0 || distance>(size_t)(out-dst.data()) || (size_t)(out_end-out)<match)return false;
+        const uint8_t* from = out-distance;
+        if(distance>=match)std::memcpy(out,from,match);
+        else for(size_t i=0;i<match;i++)out[i]=from[i];
+        out+=match;
+    }
+    return out==out_end;
+}
+
+}
+}
@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <utility>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define VS_XML_HAS_MMAN
+#endif
+
+#include <vs-xml/mapped.hpp>
+
+namespace VS_XML_NS{
+
+namespace{
+
+#if defined(VS_XML_HAS_MMAN)
+
+const size_t page_size = sysconf(_SC_PAGESIZE);
+
+//madvise wants ranges starting on page boundaries.
+void madvise_range(const uint8_t* data, size_t length, size_t offset, size_t size, int advice){
+    if(data==nullptr || offset>=length)return;
+    size = std::min(size,length-offset);
+    size_t begin = offset/page_size*page_size;
+    ::madvise((void*)(data+begin),offset+size-begin,advice);
+}
+
+int advice_for(access_t access){
+    switch(access){
+        case access_t::RANDOM:      return MADV_RANDOM;
+        case access_t::SEQUENTIAL:  return MADV_SEQUENTIAL;
+        default:                    return MADV_NORMAL;
+    }
+}
+
+#endif
+
+//Prefetch what is needed to locate the documents of a binary, checking it is large enough to read its header.
+std::expected<MappedRegion, mapped_error_t> prepare_binary(std::expected<MappedRegion, mapped_error_t>&& map){
+    if(!map.has_value())return std::unexpected(map.error());
+    auto region = map->bytes();
+    if(region.size_bytes()<sizeof(binary_header_t))
+        return std::unexpected(mapped_error_t{mapped_error_t::Binary,{TreeRaw::from_binary_error_t::HeaderTooSmall}});
+
+    const binary_header_t& header = *(const binary_header_t*)region.data();
+    if(region.size_bytes()>=header.size()){
+        map->prefetch(0,header.start_data());
+        size_t table = sizeof(binary_header_t::extension_t)*header.extensions_count;
+        if(table<=region.size_bytes())map->prefetch(region.size_bytes()-table,table);
+    }
+    return std::move(map);
+}
+
+}
+
+std::expected<MappedRegion, mapped_error_t> MappedRegion::open(const std::filesystem::path& path, access_t access){
+#if defined(VS_XML_HAS_MMAN)
+    int fd = ::open(path.c_str(),O_RDONLY|O_CLOEXEC);
+    if(fd<0)return std::unexpected(mapped_error_t{mapped_error_t::OpenFailed});
+    auto ret = open(fd,access);
+    ::close(fd);     //The mapping keeps the file alive.
+    return ret;
+#else
+    return std::unexpected(mapped_error_t{mapped_error_t::NotSupported});
+#endif
+}
+
+std::expected<MappedRegion, mapped_error_t> MappedRegion::open(int fd, access_t access){
+#if defined(VS_XML_HAS_MMAN)
+    struct stat info;
+    if(::fstat(fd,&info)!=0)return std::unexpected(mapped_error_t{mapped_error_t::OpenFailed});
+
+    MappedRegion ret;
+    ret.length = info.st_size;
+    if(ret.length!=0){
+        void* ptr = ::mmap(nullptr,ret.length,PROT_READ,MAP_SHARED,fd,0);
+        if(ptr==MAP_FAILED)return std::unexpected(mapped_error_t{mapped_error_t::MapFailed});
+        ret.data = (const uint8_t*)ptr;
+    }
+    ret.advise(0,ret.length,access);
+    return ret;
+#else
+    return std::unexpected(mapped_error_t{mapped_error_t::NotSupported});
+#endif
+}
+
+MappedRegion::MappedRegion(MappedRegion&& other) noexcept:data(std::exchange(other.data,nullptr)),length(std::exchange(other.length,0)){}
+
+MappedRegion& MappedRegion::operator=(MappedRegion&& other) noexcept{
+    if(this!=&other){
+        this->~MappedRegion();
+        data = std::exchange(other.data,nullptr);
+        length = std::exchange(other.length,0);
+    }
+    return *this;
+}
+
+MappedRegion::~MappedRegion(){
+#if defined(VS_XML_HAS_MMAN)
+    if(data!=nullptr)::munmap((void*)data,length);
+#endif
+    data = nullptr;
+    length = 0;
+}
+
+void MappedRegion::prefetch(size_t offset, size_t size) const{
+#if defined(VS_XML_HAS_MMAN)
+    madvise_range(data,length,offset,size,MADV_WILLNEED);
+#endif
+}
+
+void MappedRegion::advise(size_t offset, size_t size, access_t access) const{
+#if defined(VS_XML_HAS_MMAN)
+    madvise_range(data,length,offset,size,advice_for(access));
+#endif
+}
+
+std::expected<MappedDocument, mapped_error_t> MappedDocument::open(const std::filesystem::path& path, access_t access){
+    auto map = prepare_binary(MappedRegion::open(path,access));
+    if(!map.has_value())return std::unexpected(map.error());
+    auto doc = DocumentRaw::from_binary(map->bytes());
+    if(!doc.has_value())return std::unexpected(mapped_error_t{mapped_error_t::Binary,doc.error()});
+    return MappedDocument(std::move(*map),Document(std::move(*doc)));
+}
+
+std::expected<MappedArchive, mapped_error_t> MappedArchive::open(const std::filesystem::path& path, access_t access, ArchiveRaw::verify_t verify, Executor* executor){
+    auto map = MappedRegion::open(path,access);
+    if(!map.has_value())return std::unexpected(map.error());
+    return open(std::move(*map),verify,executor);
+}
+
+std::expected<MappedArchive, mapped_error_t> MappedArchive::open(MappedRegion&& region, ArchiveRaw::verify_t verify, Executor* executor){
+    auto map = prepare_binary(std::move(region));
+    if(!map.has_value())return std::unexpected(map.error());
+    auto arch = Archive::from_binary(map->bytes(),verify,executor);
+    if(!arch.has_value())return std::unexpected(mapped_error_t{mapped_error_t::Binary,arch.error()});
+    return MappedArchive(std::move(*map),Archive(*arch));
+}
+
+std::optional<const Document> MappedArchive::get(size_t idx) const{
+    //Before getting it, as lazy verification already visits the whole document.
+    if(idx<arch.items() && !prefetched[idx].load(std::memory_order_relaxed) && !prefetched[idx].exchange(true,std::memory_order_relaxed))prefetch(idx);
+    return arch.get(idx);
+}
+
+void MappedArchive::prefetch(size_t idx) const{
+    if(idx>=arch.items())return;
+    const binary_header_t& header = *(const binary_header_t*)map.bytes().data();
+    auto section = header.region(idx);
+    map.prefetch(header.start_data()+section.base,section.length);
+}
+
+}
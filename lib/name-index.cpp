@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <cstring>
+
+#include <vs-xml/fwd/unordered_map.hpp>
+#include <vs-xml/name-index.hpp>
+#include <vs-xml/node.hpp>
+
+namespace VS_XML_NS{
+
+NameIndex NameIndex::build(const TreeRaw& tree){
+    const uint8_t* base = (const uint8_t*)&tree.root();
+    const unknown_t* end = tree.root().next();
+
+    //First pass: assign an id to each label and count its elements.
+    VS_XML_NS::unordered_map<details::label_key_t,uint32_t,details::label_hash_t> ids;
+    std::vector<label_t> labels;
+    std::vector<uint32_t> sequence;     //Label id of each element, in document order.
+    std::vector<uint64_t> offsets;
+    for(auto current = &tree.root(); current<end;){
+        if(current->type()==type_t::ELEMENT){
+            auto ns = *current->ns(), name = *current->name();
+            auto [it,inserted] = ids.try_emplace(details::label_key_t{tree.rsv(ns),tree.rsv(name)},(uint32_t)labels.size());
+            if(inserted)labels.push_back({ns.base,name.base,(uint32_t)ns.length,(uint32_t)name.length,0,0});
+            labels[it->second].count++;
+            sequence.push_back(it->second);
+            offsets.push_back((const uint8_t*)current-base);
+            current=current->children_range()->first;
+        }
+        else current=current->next();
+    }
+
+    //Sort labels by name and namespace, so that lookups can bisect.
+    std::vector<uint32_t> order(labels.size());
+    for(size_t i=0;i<order.size();i++)order[i]=i;
+    std::sort(order.begin(),order.end(),[&](uint32_t a, uint32_t b){return details::label_less(tree,labels[a],labels[b]);});
+    std::vector<uint32_t> rank(labels.size());
+    std::vector<label_t> sorted(labels.size());
+    uint64_t first = 0;
+    for(size_t i=0;i<order.size();i++){
+        rank[order[i]]=i;
+        sorted[i]=labels[order[i]];
+        sorted[i].first=first;
+        first+=sorted[i].count;
+    }
+
+    header_t header;
+    header.width = postings_t::width_for(tree);
+    header.labels = sorted.size();
+    header.postings = offsets.size();
+
+    std::vector<uint8_t> data(sizeof(header_t)+sizeof(label_t)*sorted.size()+header.width*offsets.size());
+    std::memcpy(data.data(),&header,sizeof(header));
+    std::memcpy(data.data()+sizeof(header),sorted.data(),sizeof(label_t)*sorted.size());
+
+    //Second pass on the recorded sequence, filling each posting list through its cursor.
+    uint8_t* postings = data.data()+sizeof(header)+sizeof(label_t)*sorted.size();
+    std::vector<uint64_t> cursor(sorted.size());
+    for(size_t i=0;i<sorted.size();i++)cursor[i]=sorted[i].first;
+    for(size_t i=0;i<sequence.size();i++){
+        postings_t::store(postings,header.width,cursor[rank[sequence[i]]]++,offsets[i]);
+    }
+
+    return NameIndex(std::move(data));
+}
+
+std::expected<NameIndex,NameIndex::from_binary_error_t> NameIndex::from_binary(std::span<const uint8_t> region, uint32_t doc){
+    if(region.size_bytes()<sizeof(binary_header_t))return std::unexpected(from_binary_error_t::Missing);
+    auto payload = binary_extension(region,extension_kind_t::NAME_INDEX,doc);
+    if(!payload.has_value())return std::unexpected(from_binary_error_t::Missing);
+
+    if(payload->size_bytes()<sizeof(header_t))return std::unexpected(from_binary_error_t::HeaderTooSmall);
+    header_t header;
+    std::memcpy(&header,payload->data(),sizeof(header));
+    if(std::memcmp(header.magic,"$XNI",4)!=0 || (header.width!=4 && header.width!=8))return std::unexpected(from_binary_error_t::MagicMismatch);
+    //Counts are bounded before multiplying, so that crafted ones cannot wrap around.
+    uint64_t available = payload->size_bytes()-sizeof(header_t);
+    if(header.labels>available/sizeof(label_t))return std::unexpected(from_binary_error_t::TruncatedSpan);
+    available-=sizeof(label_t)*header.labels;
+    if(header.postings>available/header.width || available!=header.width*header.postings)
+        return std::unexpected(from_binary_error_t::TruncatedSpan);
+
+    //Postings are offsets within the document the index belongs to.
+    const binary_header_t& bin = *(const binary_header_t*)region.data();
+    if(doc>=bin.docs_count)return std::unexpected(from_binary_error_t::OutOfBounds);
+    uint64_t limit = bin.sections[doc].length;
+
+    NameIndex ret(*payload);
+    for(auto& label : ret.labels()){
+        if(label.first>header.postings || label.count>header.postings-label.first)return std::unexpected(from_binary_error_t::OutOfBounds);
+        if(!ret.postings().valid(label.first,label.count,limit))return std::unexpected(from_binary_error_t::OutOfBounds);
+        if(!details::in_symbols(label.ns_base,label.ns_length,bin.length_of_symbols) || !details::in_symbols(label.name_base,label.name_length,bin.length_of_symbols))
+            return std::unexpected(from_binary_error_t::OutOfBounds);
+    }
+    return ret;
+}
+
+std::pair<size_t,size_t> NameIndex::find(const TreeRaw& tree, std::string_view name) const{
+    return details::find_label(tree,labels(),name);
+}
+
+std::optional<size_t> NameIndex::find(const TreeRaw& tree, std::string_view ns, std::string_view name) const{
+    return details::find_label(tree,labels(),ns,name);
+}
+
+}
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <bit>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <vs-xml/node-set.hpp>
+
+namespace VS_XML_NS{
+namespace query{
+namespace details{
+
+namespace{
+
+//Operands this many times larger than the other one are searched by bisection instead of being merged.
+constexpr size_t gallop_ratio = 32;
+
+template<typename T>
+void intersect_skewed(std::span<const T> small, std::span<const T> large, std::vector<T>& dst){
+    auto it = large.begin();
+    for(auto v : small){
+        it = std::lower_bound(it,large.end(),v);
+        if(it==large.end())return;
+        if(*it==v)dst.push_back(v);
+    }
+}
+
+}
+
+template<typename T>
+void set_union(std::span<const T> a, std::span<const T> b, std::vector<T>& dst){
+    size_t at = dst.size();
+    dst.resize(at+a.size()+b.size());
+    T* out = dst.data()+at;
+    size_t i=0, j=0;
+    //Branchless merge, as the outcome of comparisons on interleaved sets is hard to predict.
+    while(i<a.size() && j<b.size()){
+        T x = a[i], y = b[j];
+        *out++ = x<y?x:y;
+        i+=x<=y;
+        j+=y<=x;
+    }
+    out = std::copy(a.begin()+i,a.end(),out);
+    out = std::copy(b.begin()+j,b.end(),out);
+    dst.resize(out-dst.data());
+}
+
+template<typename T>
+void set_intersection(std::span<const T> a, std::span<const T> b, std::vector<T>& dst){
+    if(a.size()*gallop_ratio<b.size())return intersect_skewed(a,b,dst);
+    if(b.size()*gallop_ratio<a.size())return intersect_skewed(b,a,dst);
+
+    size_t at = dst.size();
+    dst.resize(at+std::min(a.size(),b.size()));
+    T* out = dst.data()+at;
+    size_t i=0, j=0;
+#if defined(__SSE2__)
+    if constexpr(sizeof(T)==4){
+        //Blocks of 4 from each side are compared all against all, by rotating one of them.
+        while(i+4<=a.size() && j+4<=b.size()){
+            __m128i va = _mm_loadu_si128((const __m128i*)(a.data()+i));
+            __m128i vb = _mm_loadu_si128((const __m128i*)(b.data()+j));
+            __m128i m = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi32(va,vb),_mm_cmpeq_epi32(va,_mm_shuffle_epi32(vb,_MM_SHUFFLE(0,3,2,1)))),
+                _mm_or_si128(_mm_cmpeq_epi32(va,_mm_shuffle_epi32(vb,_MM_SHUFFLE(1,0,3,2))),_mm_cmpeq_epi32(va,_mm_shuffle_epi32(vb,_MM_SHUFFLE(2,1,0,3))))
+            );
+            unsigned mask = _mm_movemask_ps(_mm_castsi128_ps(m));
+            while(mask!=0){
+                *out++ = a[i+std::countr_zero(mask)];
+                mask&=mask-1;
+            }
+            T amax = a[i+3], bmax = b[j+3];
+            i+=(amax<=bmax)*4;
+            j+=(bmax<=amax)*4;
+        }
+    }
+#endif
+    while(i<a.size() && j<b.size()){
+        T x = a[i], y = b[j];
+        *out = x;
+        out+=x==y;
+        i+=x<=y;
+        j+=y<=x;
+    }
+    dst.resize(out-dst.data());
+}
+
+template<typename T>
+void set_difference(std::span<const T> a, std::span<const T> b, std::vector<T>& dst){
+    size_t at = dst.size();
+    dst.resize(at+a.size());
+    T* out = dst.data()+at;
+    size_t i=0, j=0;
+    if(b.size()*gallop_ratio<a.size()){
+        //Few elements to remove: copy the runs in between.
+        for(auto v : b){
+            auto it = std::lower_bound(a.begin()+i,a.end(),v);
+            out = std::copy(a.begin()+i,it,out);
+            i = it-a.begin()+(it!=a.end() && *it==v);
+        }
+    }
+    else{
+        while(i<a.size() && j<b.size()){
+            T x = a[i], y = b[j];
+            *out = x;
+            out+=x<y;
+            i+=x<=y;
+            j+=y<=x;
+        }
+    }
+    out = std::copy(a.begin()+i,a.end(),out);
+    dst.resize(out-dst.data());
+}
+
+template void set_union<uint32_t>(std::span<const uint32_t>, std::span<const uint32_t>, std::vector<uint32_t>&);
+template void set_union<uint64_t>(std::span<const uint64_t>, std::span<const uint64_t>, std::vector<uint64_t>&);
+template void set_intersection<uint32_t>(std::span<const uint32_t>, std::span<const uint32_t>, std::vector<uint32_t>&);
+template void set_intersection<uint64_t>(std::span<const uint64_t>, std::span<const uint64_t>, std::vector<uint64_t>&);
+template void set_difference<uint32_t>(std::span<const uint32_t>, std::span<const uint32_t>, std::vector<uint32_t>&);
+template void set_difference<uint64_t>(std::span<const uint64_t>, std::span<const uint64_t>, std::vector<uint64_t>&);
+
+}
+}
+}
@@ -1,22 +1,186 @@
+#include <cstring>
+#include <limits>
+
 #include <vs-xml/query-builder.hpp>
 
 namespace VS_XML_NS{
 namespace query{
 
-QueryBuilder::error_t QueryBuilder::begin_frame(std::string_view name, Type type){return error_t::NOT_IMPLEMENTED;}
-QueryBuilder::error_t QueryBuilder::end_frame(){return error_t::NOT_IMPLEMENTED;}
+std::expected<cell_t::operand_t,QueryBuilder::error_t> QueryBuilder::operand(std::string_view src){
+    if(symbols.size()+src.size()>std::numeric_limits<uint32_t>::max())return std::unexpected(error_t::TOO_LARGE);
+    cell_t::operand_t ret{(uint32_t)symbols.size(),(uint32_t)src.size()};
+    symbols.insert(symbols.end(),src.begin(),src.end());
+    return ret;
+}
+
+std::expected<cell_t::operand_t,QueryBuilder::error_t> QueryBuilder::operand(const Token::operand_t& src, uint8_t& flags, size_t i){
+    if(std::holds_alternative<std::monostate>(src))return cell_t::operand_t{0,0};
+    else if(std::holds_alternative<std::string_view>(src)){
+        flags|=1<<i;
+        return operand(std::get<std::string_view>(src));
+    }
+    //Lambdas have no binary representation.
+    return std::unexpected(error_t::NOT_SERIALIZABLE);
+}
+
+QueryBuilder::error_t QueryBuilder::push(const cell_t& cell){
+    if(stack.size()==0)return error_t::FRAME_CLOSED;
+    //Matching operations must come before any nested step of the same block.
+    if(cell.op!=op_t::BEGIN && cells.back().op==op_t::END)return error_t::MISFORMED;
+    if(cells.size()>=std::numeric_limits<uint32_t>::max())return error_t::TOO_LARGE;
+    cells.push_back(cell);
+    return error_t::OK;
+}
+
+QueryBuilder::error_t QueryBuilder::open(op_t op, uint8_t mode, std::string_view capture){
+    if(auto ret = push({.op=op,.mode=mode}); ret!=error_t::OK)return ret;
+    stack.push_back(cells.size()-1);
+    if(capture.size()!=0){
+        auto tmp = operand(capture);
+        if(!tmp.has_value())return tmp.error();
+        return push({.op=op_t::CAPTURE,.flags=1,.operands={*tmp}});
+    }
+    return error_t::OK;
+}
+
+QueryBuilder::error_t QueryBuilder::begin_frame(std::string_view name, Type type){
+    if(stack.size()!=0)return error_t::FRAME_OPEN;
+    if(frames>=std::numeric_limits<uint16_t>::max())return error_t::TOO_LARGE;
+    auto tmp = operand(name);
+    if(!tmp.has_value())return tmp.error();
+    cells.push_back({.op=op_t::BEGIN,.mode=(uint8_t)(type==CHILD_IS?frame_t::CHILD_IS:type==IS?frame_t::IS:frame_t::HAS),.flags=1,.operands={*tmp}});
+    stack.push_back(cells.size()-1);
+    frames++;
+    return error_t::OK;
+}
+
+QueryBuilder::error_t QueryBuilder::end_frame(){
+    if(stack.size()==0)return error_t::FRAME_CLOSED;
+    if(stack.size()!=1)return error_t::MISFORMED;
+    return end();
+}
+
+QueryBuilder::error_t QueryBuilder::any(std::string_view capture){return open(op_t::BEGIN,(uint8_t)axis_t::DESCENDANT,capture);}
+
+QueryBuilder::error_t QueryBuilder::begin(std::string_view capture){return open(op_t::BEGIN,(uint8_t)axis_t::CHILD,capture);}
+
+QueryBuilder::error_t QueryBuilder::end(){
+    if(stack.size()==0)return error_t::STACK_EMPTY;
+    auto start = stack.back();
+    stack.pop_back();
+    cells.push_back({.op=op_t::END,.skip=(uint32_t)(cells.size()-start)});
+    cells[start].skip=cells.size()-1-start;
+    return error_t::OK;
+}
+
+QueryBuilder::error_t QueryBuilder::match_type(Token::type_filter_t<Token::type_t::MATCH_TYPE> expr){
+    uint8_t mask =
+        (expr.is_element?TYPE_ELEMENT:0) |
+        (expr.is_comment?TYPE_COMMENT:0) |
+        (expr.is_proc?TYPE_PROC:0) |
+        (expr.is_text?TYPE_TEXT:0) |
+        (expr.is_cdata?TYPE_CDATA:0) |
+        (expr.is_marker?TYPE_MARKER:0);
+    return push({.op=op_t::MATCH_TYPE,.mode=mask});
+}
+
+#define SINGLE(OP) \
+    cell_t cell{.op=op_t::OP};\
+    auto tmp = operand(expr,cell.flags,0);\
+    if(!tmp.has_value())return tmp.error();\
+    cell.operands[0]=*tmp;\
+    return push(cell);
+
+QueryBuilder::error_t QueryBuilder::match_ns(Token::single_t<Token::type_t::MATCH_NS> expr){SINGLE(MATCH_NS)}
+QueryBuilder::error_t QueryBuilder::match_name(Token::single_t<Token::type_t::MATCH_NAME> expr){SINGLE(MATCH_NAME)}
+QueryBuilder::error_t QueryBuilder::match_value(Token::single_t<Token::type_t::MATCH_VALUE> expr){SINGLE(MATCH_VALUE)}
+
+#undef SINGLE
+
+QueryBuilder::error_t QueryBuilder::match_all_text(Token::single_t<Token::type_t::MATCH_ALL_TEXT> expr, text_mode_t mode){
+    cell_t cell{.op=op_t::MATCH_ALL_TEXT,.mode=(uint8_t)mode};
+    auto tmp = operand(expr,cell.flags,0);
+    if(!tmp.has_value())return tmp.error();
+    cell.operands[0]=*tmp;
+    return push(cell);
+}
+
+QueryBuilder::error_t QueryBuilder::match_attr(Token::attr_t<Token::type_t::MATCH_ATTR> expr, std::string_view capture){
+    cell_t cell{.op=op_t::MATCH_ATTR};
+    {
+        auto tmp = operand(expr.ns,cell.flags,0);
+        if(!tmp.has_value())return tmp.error();
+        cell.operands[0]=*tmp;
+    }
+    {
+        auto tmp = operand(expr.name,cell.flags,1);
+        if(!tmp.has_value())return tmp.error();
+        cell.operands[1]=*tmp;
+    }
+    {
+        auto tmp = operand(expr.value,cell.flags,2);
+        if(!tmp.has_value())return tmp.error();
+        cell.operands[2]=*tmp;
+    }
+    if(auto ret = push(cell); ret!=error_t::OK)return ret;
+    if(capture.size()!=0){
+        auto tmp = operand(capture);
+        if(!tmp.has_value())return tmp.error();
+        return push({.op=op_t::CAPTURE,.flags=1,.operands={*tmp}});
+    }
+    return error_t::OK;
+}
+
+QueryBuilder::error_t QueryBuilder::match_position(uint32_t position){
+    if(position==0)return error_t::MISFORMED;
+    return push({.op=op_t::MATCH_POSITION,.skip=position});
+}
+
+QueryBuilder::error_t QueryBuilder::inject(const Query& query){
+    if(stack.size()==0)return error_t::FRAME_CLOSED;
+    auto start = query.frame(0);
+    if(!start.has_value())return error_t::OK;
+
+    auto src = query.cells();
+    auto offset = symbols.size();
+    if(offset+query.symbols().size()>std::numeric_limits<uint32_t>::max())return error_t::TOO_LARGE;
+
+    //Skip the frame BEGIN, which also holds its name, and copy everything up to its END.
+    size_t i = *start+1;
+    size_t last = *start+src[*start].skip;
+    if(cells.size()+(last-i)>=std::numeric_limits<uint32_t>::max())return error_t::TOO_LARGE;
+    if(i<last && src[i].op!=op_t::BEGIN && cells.back().op==op_t::END)return error_t::MISFORMED;
+
+    for(;i<last;i++){
+        cell_t cell = src[i];
+        for(size_t j=0;j<3;j++)if(cell.has(j))cell.operands[j].base+=offset;
+        cells.push_back(cell);
+    }
+    //skip fields are relative, so they are preserved by the copy.
+    symbols.insert(symbols.end(),query.symbols().begin(),query.symbols().end());
+    return error_t::OK;
+}
 
-QueryBuilder::error_t QueryBuilder::any(std::string_view capture){return error_t::NOT_IMPLEMENTED;}
+std::expected<Query,QueryBuilder::error_t> QueryBuilder::close(){
+    if(stack.size()!=0)return std::unexpected(error_t::FRAME_OPEN);
+    cells.push_back({.op=op_t::EOQ});
 
-QueryBuilder::error_t QueryBuilder::begin(std::string_view capture){return error_t::NOT_IMPLEMENTED;}
-QueryBuilder::error_t QueryBuilder::end(){return error_t::NOT_IMPLEMENTED;}
+    Query::header_t header;
+    header.frames=frames;
+    header.cells=cells.size();
+    header.length_of_symbols=symbols.size();
 
-QueryBuilder::error_t QueryBuilder::match_type(Token::type_filter_t<Token::type_t::MATCH_TYPE> expr){return error_t::NOT_IMPLEMENTED;}
-QueryBuilder::error_t QueryBuilder::match_ns(Token::single_t<Token::type_t::MATCH_NS> expr){return error_t::NOT_IMPLEMENTED;}
-QueryBuilder::error_t QueryBuilder::match_name(Token::single_t<Token::type_t::MATCH_NAME> expr){return error_t::NOT_IMPLEMENTED;}
-QueryBuilder::error_t QueryBuilder::match_value(Token::single_t<Token::type_t::MATCH_VALUE> expr){return error_t::NOT_IMPLEMENTED;}
-QueryBuilder::error_t QueryBuilder::match_all_text(Token::single_t<Token::type_t::MATCH_ALL_TEXT> expr){return error_t::NOT_IMPLEMENTED;}
-QueryBuilder::error_t QueryBuilder::match_attr(Token::attr_t<Token::type_t::MATCH_ATTR> expr, std::string_view capture){return error_t::NOT_IMPLEMENTED;}
+    std::vector<uint8_t> data(sizeof(header)+sizeof(cell_t)*cells.size()+symbols.size());
+    std::memcpy(data.data(),&header,sizeof(header));
+    std::memcpy(data.data()+sizeof(header),cells.data(),sizeof(cell_t)*cells.size());
+    std::memcpy(data.data()+sizeof(header)+sizeof(cell_t)*cells.size(),symbols.data(),symbols.size());
 
+    cells.clear();
+    symbols.clear();
+    frames=0;
+
+    return Query(std::move(data));
+}
+
+}
 }
-}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#include <vs-xml/query-cache.hpp>
+
+namespace VS_XML_NS{
+namespace query{
+
+const plan_t& QueryCache::get(const Query& query, const TreeRaw& tree, const indexes_t& indexes){
+    return *plans.get(query.hash(),
+        [&](const plan_t& plan){return plan.valid_for(query,tree,indexes);},
+        //Compiled outside the lock, as it requires a full visit of the tree.
+        [&]{return std::make_unique<plan_t>(compile(query,tree,indexes));}
+    );
+}
+
+}
+}
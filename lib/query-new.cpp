@@ -0,0 +1,684 @@
+#include <algorithm>
+#include <cstring>
+
+#include <vs-xml/attr-index.hpp>
+#include <vs-xml/fwd/unordered_map.hpp>
+#include <vs-xml/name-index.hpp>
+#include <vs-xml/query-new.hpp>
+#include <vs-xml/subtree-stats.hpp>
+#include <vs-xml/wrp-node.hpp>
+
+namespace VS_XML_NS{
+namespace query{
+
+std::optional<size_t> Query::frame(size_t idx) const{
+    auto c = cells();
+    for(size_t i=0;c[i].op==op_t::BEGIN;i+=c[i].skip+1){
+        if(idx==0)return i;
+        idx--;
+    }
+    return {};
+}
+
+std::optional<size_t> Query::frame(std::string_view name) const{
+    auto c = cells();
+    for(size_t i=0;c[i].op==op_t::BEGIN;i+=c[i].skip+1){
+        if(rsv(c[i].operands[0])==name)return i;
+    }
+    return {};
+}
+
+uint64_t Query::hash() const{
+    return fnv1a({(const char*)data.data(),data.size()});
+}
+
+std::expected<Query,Query::from_binary_error_t> Query::from_binary(std::span<const uint8_t> region){
+    if(region.size_bytes()<sizeof(header_t))return std::unexpected(from_binary_error_t::HeaderTooSmall);
+
+    header_t header;
+    std::memcpy(&header,region.data(),sizeof(header_t));
+    if(std::memcmp(header.magic,"$XQB",4)!=0)return std::unexpected(from_binary_error_t::MagicMismatch);
+    if(header.format_major!=0 || header.format_minor>1)return std::unexpected(from_binary_error_t::VersionMismatch);
+    if(header.cells==0 || region.size_bytes()!=sizeof(header_t)+sizeof(cell_t)*(size_t)header.cells+header.length_of_symbols)
+        return std::unexpected(from_binary_error_t::TruncatedSpan);
+
+    Query ret(std::vector<uint8_t>(region.begin(),region.end()));
+
+    //Structural validation, so that the interpreter never has to bound check.
+    auto c = ret.cells();
+    std::vector<size_t> stack;
+    size_t frames = 0;
+    for(size_t i=0;i<c.size();i++){
+        for(size_t j=0;j<3;j++){
+            if(c[i].has(j) && (size_t)c[i].operands[j].base+c[i].operands[j].length>header.length_of_symbols)
+                return std::unexpected(from_binary_error_t::OperandOutOfBounds);
+        }
+        switch(c[i].op){
+            case op_t::BEGIN:
+                if(stack.size()==0)frames++;
+                if(i+c[i].skip>=c.size() || c[i+c[i].skip].op!=op_t::END)return std::unexpected(from_binary_error_t::Misformed);
+                stack.push_back(i);
+                break;
+            case op_t::END:
+                if(stack.size()==0 || stack.back()+c[i].skip!=i || c[stack.back()].skip!=c[i].skip)return std::unexpected(from_binary_error_t::Misformed);
+                stack.pop_back();
+                break;
+            case op_t::EOQ:
+                if(i!=c.size()-1 || stack.size()!=0)return std::unexpected(from_binary_error_t::Misformed);
+                break;
+            case op_t::MATCH_ALL_TEXT:
+                if(c[i].mode>(uint8_t)text_mode_t::CONTAINS)return std::unexpected(from_binary_error_t::Misformed);
+                [[fallthrough]];
+            case op_t::MATCH_POSITION:
+                if(c[i].op==op_t::MATCH_POSITION && (c[i].skip==0 || header.format_minor<1))return std::unexpected(from_binary_error_t::Misformed);
+                [[fallthrough]];
+            case op_t::CAPTURE:
+            case op_t::MATCH_TYPE:
+            case op_t::MATCH_NS:
+            case op_t::MATCH_NAME:
+            case op_t::MATCH_VALUE:
+            case op_t::MATCH_ATTR:
+                if(stack.size()==0)return std::unexpected(from_binary_error_t::Misformed);
+                break;
+            default:
+                return std::unexpected(from_binary_error_t::Misformed);
+        }
+    }
+    if(c.back().op!=op_t::EOQ || frames!=header.frames)return std::unexpected(from_binary_error_t::Misformed);
+
+    return ret;
+}
+
+
+namespace{
+
+//Streaming matcher for text_mode_t, fed one character at a time.
+struct text_matcher_t{
+    enum state_t{PENDING, MATCHED, FAILED};
+
+    std::string_view   pattern;
+    text_mode_t        mode;
+    size_t             pos = 0;
+    const uint32_t*    fail = nullptr;     //KMP failure function, only for CONTAINS.
+
+    inline state_t feed(char c){
+        switch(mode){
+            case text_mode_t::EXACT:
+                if(pos>=pattern.size() || pattern[pos]!=c)return FAILED;
+                pos++;
+                return PENDING;
+            case text_mode_t::PREFIX:
+                if(pattern[pos]!=c)return FAILED;
+                pos++;
+                return pos==pattern.size()?MATCHED:PENDING;
+            case text_mode_t::CONTAINS:
+                while(pos>0 && pattern[pos]!=c)pos=fail[pos-1];
+                if(pattern[pos]==c)pos++;
+                return pos==pattern.size()?MATCHED:PENDING;
+            default:
+                return FAILED;
+        }
+    }
+
+    //Result once the text is over.
+    inline bool finish() const{return mode==text_mode_t::EXACT && pos==pattern.size();}
+};
+
+}
+
+bool match_all_text(const TreeRaw& tree, const unknown_t* node, std::string_view pattern, text_mode_t mode){
+    if(node->type()!=type_t::ELEMENT)return false;
+    if(pattern.size()==0 && mode!=text_mode_t::EXACT)return true;
+
+    //Failure function for CONTAINS, on stack unless the pattern is long.
+    uint32_t local[64];
+    std::vector<uint32_t> heap;
+    uint32_t* fail = local;
+    if(mode==text_mode_t::CONTAINS){
+        if(pattern.size()>64){heap.resize(pattern.size());fail=heap.data();}
+        fail[0]=0;
+        for(size_t i=1, k=0;i<pattern.size();i++){
+            while(k>0 && pattern[i]!=pattern[k])k=fail[k-1];
+            if(pattern[i]==pattern[k])k++;
+            fail[i]=k;
+        }
+    }
+
+    text_matcher_t matcher{pattern,mode,0,fail};
+    for(auto& child : node->children()){
+        if(child.type()!=type_t::TEXT && child.type()!=type_t::CDATA)continue;
+        auto chunk = tree.rsv(*child.value());
+        if(tree.config().raw_strings){
+            for(auto c : serialize::unescaped_view(chunk)){
+                auto state = matcher.feed(c);
+                if(state!=text_matcher_t::PENDING)return state==text_matcher_t::MATCHED;
+            }
+        }
+        else if(mode==text_mode_t::EXACT){
+            //No escaping, so whole frames can be compared at once.
+            if(chunk.size()>pattern.size()-matcher.pos || pattern.substr(matcher.pos,chunk.size())!=chunk)return false;
+            matcher.pos+=chunk.size();
+        }
+        else{
+            for(auto c : chunk){
+                auto state = matcher.feed(c);
+                if(state!=text_matcher_t::PENDING)return state==text_matcher_t::MATCHED;
+            }
+        }
+    }
+    return matcher.finish();
+}
+
+namespace{
+
+//Pre-order visit of all nodes in [first,last).
+template<typename Fn>
+inline void for_each_node(const unknown_t* first, const unknown_t* last, Fn&& fn){
+    for(auto current = first; current<last;){
+        fn(current);
+        if(current->type()==type_t::ELEMENT)current=current->children_range()->first;
+        else current=current->next();
+    }
+}
+
+//Address of the symbol table of a tree, used as its identity.
+inline const void* symbols_of(const TreeRaw& tree){return tree.rsv(sv((std::ptrdiff_t)0,(size_t)0)).data();}
+
+struct interpreter_t{
+    const Query&    query;
+    const TreeRaw&  tree;
+    const cell_t*   cells;
+    const plan_t*   plan;
+    sink_t          sink;
+    void*           ctx;
+
+    inline bool match_sv(size_t idx, size_t i, std::expected<sv,feature_t> check) const{
+        const auto& cell = cells[idx];
+        if(!cell.has(i))return true;
+        if(!check.has_value())return false;
+        if(plan!=nullptr){
+            const auto& r = plan->cells[idx];
+            if(r.state[i]==plan_t::SV)return check->base==r.svs[i].base && check->length==r.svs[i].length;
+            else if(r.state[i]==plan_t::ABSENT)return false;
+        }
+        return wrp::sv(tree,*check)==query.rsv(cell.operands[i]);
+    }
+
+    bool test(size_t idx, const unknown_t* node) const{
+        const auto& cell = cells[idx];
+        switch(cell.op){
+            case op_t::CAPTURE:
+                return true;
+            case op_t::MATCH_TYPE:
+                switch(node->type()){
+                    case type_t::ELEMENT: return cell.mode&TYPE_ELEMENT;
+                    case type_t::TEXT: return cell.mode&TYPE_TEXT;
+                    case type_t::CDATA: return cell.mode&TYPE_CDATA;
+                    case type_t::COMMENT: return cell.mode&TYPE_COMMENT;
+                    case type_t::PROC: return cell.mode&TYPE_PROC;
+                    case type_t::MARKER: return cell.mode&TYPE_MARKER;
+                    default: return false;
+                }
+            case op_t::MATCH_NS:
+                return match_sv(idx,0,node->ns());
+            case op_t::MATCH_NAME:
+                return match_sv(idx,0,node->name());
+            case op_t::MATCH_VALUE:
+                return match_sv(idx,0,node->value());
+            case op_t::MATCH_ALL_TEXT:
+                return !cell.has(0) || VS_XML_NS::query::match_all_text(tree,node,query.rsv(cell.operands[0]),(text_mode_t)cell.mode);
+            case op_t::MATCH_ATTR:
+                if(node->type()!=type_t::ELEMENT)return false;
+                for(auto& attr: node->attrs()){
+                    if(match_sv(idx,0,attr.ns()) && match_sv(idx,1,attr.name()) && match_sv(idx,2,attr.value()))return true;
+                }
+                return false;
+            case op_t::MATCH_POSITION:{
+                if(!node->has_parent())return cell.skip==1;
+                //Count the preceding siblings passing the filters before this cell, in their original order.
+                size_t pc = idx;
+                while(cells[pc].op!=op_t::BEGIN)pc--;
+                uint32_t position = 1;
+                for(auto current = node->parent()->children_range()->first; current!=node; current=current->next()){
+                    bool pass = true;
+                    for(size_t j=pc+1;j<idx && pass;j++){
+                        if(cells[j].op!=op_t::CAPTURE)pass=test(j,current);
+                    }
+                    if(pass && ++position>cell.skip)return false;
+                }
+                return position==cell.skip;
+            }
+            default:
+                return false;
+        }
+    }
+
+    //Evaluate the block starting at `pc` on `node`. Returns false if the sink requested to stop.
+    bool block(size_t pc, const unknown_t* node) const{
+        size_t i;
+        if(plan!=nullptr){
+            const auto& r = plan->cells[pc];
+            if(r.dead)return true;
+            for(size_t j=0;j<r.filters_count;j++){
+                if(!test(plan->order[r.filters+j],node))return true;
+            }
+            i = r.body;
+        }
+        else{
+            for(i=pc+1;cells[i].op!=op_t::BEGIN && cells[i].op!=op_t::END;i++){
+                if(!test(i,node))return true;
+            }
+        }
+
+        //Leaf blocks accept.
+        if(cells[i].op==op_t::END)return sink(node,ctx);
+
+        if(node->type()!=type_t::ELEMENT)return true;
+
+        std::optional<SubtreeStats::summary_t> summary;
+        if(plan!=nullptr && plan->indexes.stats!=nullptr){
+            summary = plan->indexes.stats->find(tree,node);
+            if(summary.has_value() && summary->depth()<plan->cells[pc].min_depth)return true;
+        }
+
+        for(;cells[i].op==op_t::BEGIN;i+=cells[i].skip+1){
+            if(plan!=nullptr && plan->cells[i].dead)continue;
+            if(summary.has_value() && plan->cells[i].prune && !summary->may_contain(plan->cells[i].label))continue;
+            auto [first,last] = *node->children_range();
+            if((axis_t)cells[i].mode==axis_t::CHILD){
+                for(auto current = first; current!=last; current=current->next()){
+                    if(!block(i,current))return false;
+                }
+            }
+            else if(plan!=nullptr && plan->cells[i].source!=plan_t::SCAN){
+                //Only the elements in the posting lists can pass the filters, and indices already have them in document order.
+                const auto& r = plan->cells[i];
+                std::span<const uint32_t> keys{plan->keys.data()+r.keys,r.keys_count};
+                auto fn = [&](const unknown_t* current){return block(i,current);};
+                if(r.source==plan_t::NAMES && !plan->indexes.names->visit(tree,keys,first,last,fn))return false;
+                else if(r.source==plan_t::ATTRS && !plan->indexes.attrs->visit(tree,keys,first,last,fn))return false;
+            }
+            else{
+                //Nodes are laid out in pre-order, so all descendants are found in [first,last).
+                const SubtreeStats* stats = (plan!=nullptr && plan->cells[i].prune)?plan->indexes.stats:nullptr;
+                for(auto current = first; current<last;){
+                    if(!block(i,current))return false;
+                    if(current->type()==type_t::ELEMENT){
+                        //Jump over subtrees whose summary excludes the label of this step.
+                        if(stats!=nullptr){
+                            if(auto s = stats->find(tree,current); s.has_value() && !s->may_contain(plan->cells[i].label)){
+                                current=current->next();
+                                continue;
+                            }
+                        }
+                        current=current->children_range()->first;
+                    }
+                    else current=current->next();
+                }
+            }
+        }
+        return true;
+    }
+};
+
+bool run_h(const interpreter_t& interpreter, size_t pc, const unknown_t* root){
+    const auto& cell = interpreter.cells[pc];
+
+    switch((frame_t)cell.mode){
+        case frame_t::IS:
+            return interpreter.block(pc,root);
+        case frame_t::CHILD_IS:
+            if(root->type()!=type_t::ELEMENT)return true;
+            for(auto& child: root->children()){
+                if(!interpreter.block(pc,&child))return false;
+            }
+            return true;
+        case frame_t::HAS:{
+            bool found = false;
+            interpreter_t probe{interpreter.query,interpreter.tree,interpreter.cells,interpreter.plan,+[](const unknown_t*, void* ctx){*(bool*)ctx=true;return false;},&found};
+            probe.block(pc,root);
+            if(found)return interpreter.sink(root,interpreter.ctx);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+//Occurrences of a string in one category of symbols of a tree.
+struct occurrence_t{
+    sv          first;
+    uint32_t    count = 0;
+    bool        shared = true;      //All occurrences have the same offset.
+};
+
+typedef VS_XML_NS::unordered_map<std::string_view,occurrence_t> histogram_t;
+
+inline void account(histogram_t& histogram, const TreeRaw& tree, std::expected<sv,feature_t> s){
+    if(!s.has_value())return;
+    auto [it,inserted] = histogram.try_emplace(tree.rsv(*s),occurrence_t{*s});
+    auto& entry = it->second;
+    if(entry.count!=UINT32_MAX)entry.count++;
+    if(entry.first.base!=s->base || entry.first.length!=s->length)entry.shared=false;
+}
+
+//Resolve an operand against one category of symbols, returning its hits.
+uint32_t resolve(const histogram_t& histogram, const TreeRaw& tree, std::string_view operand, plan_t::state_t& state, sv& s){
+    const occurrence_t* found = nullptr;
+    size_t matches = 0;
+    uint64_t hits = 0;
+
+    auto add = [&](const occurrence_t& entry){
+        found=&entry;
+        matches++;
+        hits+=entry.count;
+    };
+
+    if(!tree.config().raw_strings){
+        if(auto it = histogram.find(operand); it!=histogram.end())add(it->second);
+    }
+    else{
+        //Escaped symbols, so different entries might still match the same operand.
+        for(auto& [key,entry] : histogram){
+            if(wrp::sv(tree,entry.first)==operand)add(entry);
+        }
+    }
+
+    if(matches==0){state=plan_t::ABSENT;return 0;}
+    else if(matches==1 && found->shared){state=plan_t::SV;s=found->first;}
+    else state=plan_t::STRING;
+    return std::min<uint64_t>(hits,UINT32_MAX);
+}
+
+//Relative cost of evaluating a filter, used to break ties between equally selective ones.
+inline int cost(const cell_t& cell, const plan_t::resolved_t& r){
+    switch(cell.op){
+        case op_t::MATCH_TYPE: return 0;
+        case op_t::MATCH_NS:
+        case op_t::MATCH_NAME:
+        case op_t::MATCH_VALUE: return r.state[0]==plan_t::SV?0:1;
+        case op_t::MATCH_ATTR: return 2;
+        default: return 3;
+    }
+}
+
+//Pick the index with fewer candidates for a descendant step, selecting its posting lists.
+void select_source(plan_t& plan, const TreeRaw& tree, size_t pc){
+    auto c = plan.query.cells();
+    auto& r = plan.cells[pc];
+    const cell_t* name = nullptr;
+    const cell_t* ns = nullptr;
+    const cell_t* attr = nullptr;
+    for(size_t i=pc+1;c[i].op!=op_t::BEGIN && c[i].op!=op_t::END;i++){
+        if(c[i].op==op_t::MATCH_NAME && c[i].has(0))name=&c[i];
+        else if(c[i].op==op_t::MATCH_NS && c[i].has(0))ns=&c[i];
+        else if(c[i].op==op_t::MATCH_ATTR && c[i].has(1) && c[i].has(2))attr=&c[i];
+    }
+
+    auto rsv = [&](const cell_t* cell, size_t i){return plan.query.rsv(cell->operands[i]);};
+    std::vector<uint32_t> keys;
+    uint64_t best = UINT64_MAX;
+
+    if(name!=nullptr && plan.indexes.names!=nullptr){
+        auto& index = *plan.indexes.names;
+        std::vector<uint32_t> tmp;
+        if(ns!=nullptr){
+            if(auto l = index.find(tree,rsv(ns,0),rsv(name,0)); l.has_value())tmp.push_back(*l);
+        }
+        else{
+            auto [a,b] = index.find(tree,rsv(name,0));
+            for(;a<b;a++)tmp.push_back(a);
+        }
+        uint64_t count = 0;
+        for(auto l : tmp)count+=index.labels()[l].count;
+        best = count;
+        r.source = plan_t::NAMES;
+        keys = std::move(tmp);
+    }
+
+    if(attr!=nullptr && plan.indexes.attrs!=nullptr){
+        auto& index = *plan.indexes.attrs;
+        std::vector<uint32_t> tmp;
+        auto add = [&](size_t label){
+            if(auto v = index.find_value(tree,label,rsv(attr,2)); v.has_value())tmp.push_back(*v);
+        };
+        std::optional<std::string_view> attr_ns;
+        if(attr->has(0)){
+            attr_ns = rsv(attr,0);
+            if(auto l = index.find(tree,*attr_ns,rsv(attr,1)); l.has_value())add(*l);
+        }
+        else{
+            auto [a,b] = index.find(tree,rsv(attr,1));
+            for(;a<b;a++)add(a);
+        }
+        //Attributes which were not selected at build time are not in the index, so their absence proves nothing.
+        bool covered = index.covers(tree,attr_ns,rsv(attr,1));
+        if(covered){
+            uint64_t count = 0;
+            for(auto v : tmp)count+=index.values()[v].count;
+            if(count<best){
+                best = count;
+                r.source = plan_t::ATTRS;
+                keys = std::move(tmp);
+            }
+        }
+    }
+
+    if(r.source==plan_t::SCAN)return;
+    r.keys = plan.keys.size();
+    r.keys_count = keys.size();
+    plan.keys.insert(plan.keys.end(),keys.begin(),keys.end());
+}
+
+//Key of the label required by a step, used to prune subtrees via their summaries.
+void select_label(plan_t& plan, size_t pc){
+    auto c = plan.query.cells();
+    auto& r = plan.cells[pc];
+    const cell_t* name = nullptr;
+    const cell_t* ns = nullptr;
+    for(size_t i=pc+1;c[i].op!=op_t::BEGIN && c[i].op!=op_t::END;i++){
+        if(c[i].op==op_t::MATCH_NAME && c[i].has(0))name=&c[i];
+        else if(c[i].op==op_t::MATCH_NS && c[i].has(0))ns=&c[i];
+    }
+    if(name==nullptr)return;
+    r.prune = true;
+    r.label = ns!=nullptr?SubtreeStats::key(plan.query.rsv(ns->operands[0]),plan.query.rsv(name->operands[0])):SubtreeStats::key(plan.query.rsv(name->operands[0]));
+}
+
+//Fill filters, body and dead for the block starting at pc. Returns true if the block is dead.
+bool analyze(plan_t& plan, const TreeRaw& tree, size_t pc, bool step){
+    auto c = plan.query.cells();
+    auto& r = plan.cells[pc];
+
+    size_t i = pc+1;
+    r.filters = plan.order.size();
+    bool dead = false;
+    for(;c[i].op!=op_t::BEGIN && c[i].op!=op_t::END;i++){
+        if(c[i].op==op_t::CAPTURE)continue;
+        plan.order.push_back(i);
+        if(plan.cells[i].hits==0)dead=true;
+    }
+    r.filters_count = plan.order.size()-r.filters;
+    r.body = i;
+    std::stable_sort(plan.order.begin()+r.filters,plan.order.end(),[&](uint32_t a, uint32_t b){
+        if(plan.cells[a].hits!=plan.cells[b].hits)return plan.cells[a].hits<plan.cells[b].hits;
+        return cost(c[a],plan.cells[a])<cost(c[b],plan.cells[b]);
+    });
+
+    if(step && (axis_t)c[pc].mode==axis_t::DESCENDANT){
+        select_source(plan,tree,pc);
+        if(r.source!=plan_t::SCAN && r.keys_count==0)dead=true;
+    }
+    if(step && plan.indexes.stats!=nullptr)select_label(plan,pc);
+
+    if(c[i].op==op_t::BEGIN){
+        bool all_dead = true;
+        uint32_t min_depth = UINT32_MAX;
+        for(;c[i].op==op_t::BEGIN;i+=c[i].skip+1){
+            bool nested = analyze(plan,tree,i,true);
+            all_dead&=nested;
+            if(!nested)min_depth=std::min(min_depth,plan.cells[i].min_depth+1);
+        }
+        dead|=all_dead;
+        if(!all_dead)r.min_depth=min_depth;
+    }
+
+    r.dead = dead;
+    return dead;
+}
+
+}
+
+bool run(const Query& query, const TreeRaw& tree, const unknown_t* root, sink_t sink, void* ctx, size_t frame){
+    auto pc = query.frame(frame);
+    if(!pc.has_value())return false;
+    if(root==nullptr)root=&tree.root();
+
+    interpreter_t interpreter{query,tree,query.cells().data(),nullptr,sink,ctx};
+    return run_h(interpreter,*pc,root);
+}
+
+bool run(const plan_t& plan, const TreeRaw& tree, const unknown_t* root, sink_t sink, void* ctx, size_t frame){
+    xml_assert(plan.root==&tree.root() && plan.symbols==symbols_of(tree), "Plan used on a different tree");
+    auto pc = plan.query.frame(frame);
+    if(!pc.has_value())return false;
+    if(root==nullptr)root=&tree.root();
+    if(plan.cells[*pc].dead)return true;
+
+    interpreter_t interpreter{plan.query,tree,plan.query.cells().data(),&plan,sink,ctx};
+    return run_h(interpreter,*pc,root);
+}
+
+namespace{
+
+struct page_t{
+    std::vector<const unknown_t*>   nodes;
+    size_t                          n;
+    size_t                          skip;
+};
+
+bool count_sink(const unknown_t*, void* ctx){(*(size_t*)ctx)++;return true;}
+bool exists_sink(const unknown_t*, void* ctx){*(bool*)ctx=true;return false;}
+bool page_sink(const unknown_t* node, void* ctx){
+    auto& page = *(page_t*)ctx;
+    if(page.skip!=0){page.skip--;return true;}
+    page.nodes.push_back(node);
+    return page.nodes.size()<page.n;
+}
+
+}
+
+size_t count(const Query& query, const TreeRaw& tree, const unknown_t* root, size_t frame){
+    size_t ret = 0;
+    run(query,tree,root,count_sink,&ret,frame);
+    return ret;
+}
+
+size_t count(const plan_t& plan, const TreeRaw& tree, const unknown_t* root, size_t frame){
+    size_t ret = 0;
+    run(plan,tree,root,count_sink,&ret,frame);
+    return ret;
+}
+
+bool exists(const Query& query, const TreeRaw& tree, const unknown_t* root, size_t frame){
+    bool found = false;
+    run(query,tree,root,exists_sink,&found,frame);
+    return found;
+}
+
+bool exists(const plan_t& plan, const TreeRaw& tree, const unknown_t* root, size_t frame){
+    bool found = false;
+    run(plan,tree,root,exists_sink,&found,frame);
+    return found;
+}
+
+std::vector<const unknown_t*> first_n(const Query& query, const TreeRaw& tree, size_t n, size_t skip, const unknown_t* root, size_t frame){
+    page_t page{{},n,skip};
+    if(n!=0)run(query,tree,root,page_sink,&page,frame);
+    return std::move(page.nodes);
+}
+
+std::vector<const unknown_t*> first_n(const plan_t& plan, const TreeRaw& tree, size_t n, size_t skip, const unknown_t* root, size_t frame){
+    page_t page{{},n,skip};
+    if(n!=0)run(plan,tree,root,page_sink,&page,frame);
+    return std::move(page.nodes);
+}
+
+bool plan_t::valid_for(const Query& q, const TreeRaw& tree, const indexes_t& idx) const{
+    return root==&tree.root() && symbols==symbols_of(tree) && indexes==idx && query==q;
+}
+
+plan_t compile(const Query& query, const TreeRaw& tree, const indexes_t& indexes){
+    plan_t plan{query,&tree.root(),symbols_of(tree),std::vector<plan_t::resolved_t>(query.cells().size()),{},indexes,{}};
+    auto c = query.cells();
+
+    //Only collect categories which are used by the query.
+    enum {EL_NS, EL_NAME, VALUE, ATTR_NS, ATTR_NAME, ATTR_VALUE, CATEGORIES};
+    bool needed[CATEGORIES] = {};
+    for(auto& cell : c){
+        if(cell.op==op_t::MATCH_NS && cell.has(0))needed[EL_NS]=true;
+        else if(cell.op==op_t::MATCH_NAME && cell.has(0))needed[EL_NAME]=true;
+        else if(cell.op==op_t::MATCH_VALUE && cell.has(0))needed[VALUE]=true;
+        else if(cell.op==op_t::MATCH_ATTR){
+            needed[ATTR_NS]|=cell.has(0);
+            needed[ATTR_NAME]|=cell.has(1);
+            needed[ATTR_VALUE]|=cell.has(2);
+        }
+    }
+
+    histogram_t histograms[CATEGORIES];
+    uint64_t types[8] = {};
+    for_each_node(&tree.root(),tree.root().next(),[&](const unknown_t* node){
+        types[(size_t)node->type()&7]++;
+        if(node->type()==type_t::ELEMENT){
+            if(needed[EL_NS])account(histograms[EL_NS],tree,node->ns());
+            if(needed[EL_NAME])account(histograms[EL_NAME],tree,node->name());
+            if(needed[ATTR_NS] || needed[ATTR_NAME] || needed[ATTR_VALUE]){
+                for(auto& attr: node->attrs()){
+                    if(needed[ATTR_NS])account(histograms[ATTR_NS],tree,attr.ns());
+                    if(needed[ATTR_NAME])account(histograms[ATTR_NAME],tree,attr.name());
+                    if(needed[ATTR_VALUE])account(histograms[ATTR_VALUE],tree,attr.value());
+                }
+            }
+        }
+        else if(needed[VALUE])account(histograms[VALUE],tree,node->value());
+    });
+
+    for(size_t i=0;i<c.size();i++){
+        auto& r = plan.cells[i];
+        auto single = [&](size_t category){
+            if(c[i].has(0))r.hits=resolve(histograms[category],tree,query.rsv(c[i].operands[0]),r.state[0],r.svs[0]);
+        };
+        switch(c[i].op){
+            case op_t::MATCH_TYPE:{
+                uint64_t hits = 0;
+                if(c[i].mode&TYPE_ELEMENT)hits+=types[(size_t)type_t::ELEMENT&7];
+                if(c[i].mode&TYPE_TEXT)hits+=types[(size_t)type_t::TEXT&7];
+                if(c[i].mode&TYPE_CDATA)hits+=types[(size_t)type_t::CDATA&7];
+                if(c[i].mode&TYPE_COMMENT)hits+=types[(size_t)type_t::COMMENT&7];
+                if(c[i].mode&TYPE_PROC)hits+=types[(size_t)type_t::PROC&7];
+                if(c[i].mode&TYPE_MARKER)hits+=types[(size_t)type_t::MARKER&7];
+                r.hits=std::min<uint64_t>(hits,UINT32_MAX);
+                break;
+            }
+            case op_t::MATCH_NS: single(EL_NS); break;
+            case op_t::MATCH_NAME: single(EL_NAME); break;
+            case op_t::MATCH_VALUE: single(VALUE); break;
+            case op_t::MATCH_ATTR:
+                for(size_t j=0;j<3;j++){
+                    if(!c[i].has(j))continue;
+                    r.hits=std::min(r.hits,resolve(histograms[ATTR_NS+j],tree,query.rsv(c[i].operands[j]),r.state[j],r.svs[j]));
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    for(size_t i=0;c[i].op==op_t::BEGIN;i+=c[i].skip+1)analyze(plan,tree,i,false);
+
+    return plan;
+}
+
+}
+}
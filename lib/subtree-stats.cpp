@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cstring>
+
+#include <vs-xml/subtree-stats.hpp>
+
+namespace VS_XML_NS{
+
+SubtreeStats SubtreeStats::build(const TreeRaw& tree, size_t min_extent, uint8_t words){
+    xml_assert(words>=1 && words<=8, "Bloom filters must be between 1 and 8 words");
+    const uint8_t* base = (const uint8_t*)&tree.root();
+    const unknown_t* end = tree.root().next();
+    size_t stride = sizeof(entry_t)+8*words;
+
+    //Elements whose subtree is still being visited.
+    struct open_t{
+        const unknown_t*    node;
+        const unknown_t*    end;
+        uint64_t            nodes = 0;
+        uint32_t            depth = 0;
+        uint8_t             bloom[64] = {};
+    };
+    std::vector<open_t> stack;
+    std::vector<uint8_t> entries;
+    uint64_t count = 0;
+
+    auto set = [&](uint8_t* bloom, uint64_t key){
+        for(size_t i=0;i<3;i++){
+            auto b = bit(key,i,words);
+            bloom[b/8]|=1<<(b%8);
+        }
+    };
+
+    //Fold the innermost open element into its parent, emitting its summary if large enough.
+    auto close = [&](){
+        auto& top = stack.back();
+        if((uint64_t)((const uint8_t*)top.end-(const uint8_t*)top.node)>=min_extent){
+            entry_t entry{(uint64_t)((const uint8_t*)top.node-base),top.nodes,top.depth};
+            auto at = entries.size();
+            entries.resize(at+stride);
+            std::memcpy(entries.data()+at,&entry,sizeof(entry));
+            std::memcpy(entries.data()+at+sizeof(entry),top.bloom,8*words);
+            count++;
+        }
+        if(stack.size()>1){
+            auto& parent = stack[stack.size()-2];
+            parent.nodes+=top.nodes+1;
+            parent.depth=std::max(parent.depth,top.depth+1);
+            for(size_t i=0;i<8*words;i++)parent.bloom[i]|=top.bloom[i];
+            set(parent.bloom,key(tree.rsv(*top.node->name())));
+            set(parent.bloom,key(tree.rsv(*top.node->ns()),tree.rsv(*top.node->name())));
+        }
+        stack.pop_back();
+    };
+
+    for(auto current = &tree.root(); current<end;){
+        while(stack.size()!=0 && stack.back().end<=current)close();
+        if(current->type()==type_t::ELEMENT){
+            stack.push_back({current,current->next()});
+            current=current->children_range()->first;
+        }
+        else{
+            if(stack.size()!=0){
+                stack.back().nodes++;
+                stack.back().depth=std::max<uint32_t>(stack.back().depth,1);
+            }
+            current=current->next();
+        }
+    }
+    while(stack.size()!=0)close();
+
+    //Summaries were emitted in post-order, while lookups need them sorted by offset.
+    std::vector<uint32_t> order(count);
+    for(size_t i=0;i<count;i++)order[i]=i;
+    auto offset = [&](uint32_t i){uint64_t v;std::memcpy(&v,entries.data()+stride*i,8);return v;};
+    std::sort(order.begin(),order.end(),[&](uint32_t a, uint32_t b){return offset(a)<offset(b);});
+
+    header_t header;
+    header.words = words;
+    header.entries = count;
+    header.min_extent = min_extent;
+
+    std::vector<uint8_t> data(sizeof(header_t)+stride*count);
+    std::memcpy(data.data(),&header,sizeof(header));
+    for(size_t i=0;i<count;i++)std::memcpy(data.data()+sizeof(header_t)+stride*i,entries.data()+stride*order[i],stride);
+
+    return SubtreeStats(std::move(data));
+}
+
+std::expected<SubtreeStats,SubtreeStats::from_binary_error_t> SubtreeStats::from_binary(std::span<const uint8_t> region, uint32_t doc){
+    if(region.size_bytes()<sizeof(binary_header_t))return std::unexpected(from_binary_error_t::Missing);
+    auto payload = binary_extension(region,extension_kind_t::SUBTREE_STATS,doc);
+    if(!payload.has_value())return std::unexpected(from_binary_error_t::Missing);
+
+    if(payload->size_bytes()<sizeof(header_t))return std::unexpected(from_binary_error_t::HeaderTooSmall);
+    header_t header;
+    std::memcpy(&header,payload->data(),sizeof(header));
+    if(std::memcmp(header.magic,"$XSS",4)!=0 || header.words<1 || header.words>8)return std::unexpected(from_binary_error_t::MagicMismatch);
+    uint64_t stride = sizeof(entry_t)+8*header.words;
+    if(header.entries>(payload->size_bytes()-sizeof(header_t))/stride || payload->size_bytes()!=sizeof(header_t)+stride*header.entries)
+        return std::unexpected(from_binary_error_t::TruncatedSpan);
+
+    const binary_header_t& bin = *(const binary_header_t*)region.data();
+    if(doc>=bin.docs_count)return std::unexpected(from_binary_error_t::OutOfBounds);
+    uint64_t limit = bin.sections[doc].length;
+
+    //Entries are bisected by offset, and no subtree can hold more nodes (or be deeper) than the bytes of its document.
+    SubtreeStats ret(*payload);
+    for(size_t i=0;i<ret.size();i++){
+        auto& entry = *ret.at(i).entry;
+        if(entry.offset>=limit || (i!=0 && entry.offset<=ret.at(i-1).entry->offset))return std::unexpected(from_binary_error_t::OutOfBounds);
+        if(entry.nodes>=limit-entry.offset || entry.depth>entry.nodes)return std::unexpected(from_binary_error_t::OutOfBounds);
+    }
+    return ret;
+}
+
+}
@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include <vs-xml/topology.hpp>
+
+namespace VS_XML_NS{
+
+Topology Topology::build(const TreeRaw& tree){
+    const uint8_t* base = (const uint8_t*)&tree.root();
+    const unknown_t* end = tree.root().next();
+
+    //Elements whose subtree is still being visited.
+    struct open_t{
+        uint64_t            id;
+        const unknown_t*    end;
+    };
+    std::vector<open_t> stack;
+    std::vector<uint64_t> offsets, ends, depths;
+    uint64_t alignment = 0;
+    uint32_t max_depth = 0;
+
+    for(auto current = &tree.root(); current<end;){
+        while(stack.size()!=0 && stack.back().end<=current){
+            ends[stack.back().id]=offsets.size();
+            stack.pop_back();
+        }
+        uint64_t offset = (const uint8_t*)current-base;
+        alignment|=offset;
+        max_depth=std::max<uint32_t>(max_depth,stack.size());
+        offsets.push_back(offset);
+        ends.push_back(offsets.size());
+        depths.push_back(stack.size());
+        if(current->type()==type_t::ELEMENT){
+            stack.push_back({offsets.size()-1,current->next()});
+            current=current->children_range()->first;
+        }
+        else current=current->next();
+    }
+    while(stack.size()!=0){
+        ends[stack.back().id]=offsets.size();
+        stack.pop_back();
+    }
+
+    header_t header;
+    header.width = (offsets.size()==0 || offsets.back()<=UINT32_MAX)?4:8;
+    header.depth_width = max_depth<=UINT16_MAX?2:4;
+    header.granule = alignment==0?3:std::min<uint8_t>(3,std::countr_zero(alignment));
+    header.max_depth = max_depth;
+    header.nodes = offsets.size();
+    header.words = offsets.size()==0?0:((offsets.back()>>header.granule)/64+1);
+
+    size_t samples = (header.words+7)/8;
+    size_t head = sizeof(header_t)+8*(header.words+samples+max_depth+2);
+    size_t n = offsets.size();
+    std::vector<uint8_t> data(head+(3*header.width+header.depth_width)*n);
+    std::memcpy(data.data(),&header,sizeof(header));
+
+    //Bitvector of node starts, and the rank of each block of 8 words.
+    std::vector<uint64_t> words(header.words+samples+max_depth+2);
+    for(auto offset : offsets){
+        auto slot = offset>>header.granule;
+        words[slot/64]|=1ull<<(slot%64);
+    }
+    uint64_t rank = 0;
+    for(size_t i=0;i<header.words;i++){
+        if(i%8==0)words[header.words+i/8]=rank;
+        rank+=std::popcount(words[i]);
+    }
+
+    //Nodes are grouped by depth with a counting sort, which keeps them in pre-order within each level.
+    uint64_t* first = words.data()+header.words+samples;
+    for(auto d : depths)first[d+1]++;
+    for(size_t d=0;d<max_depth+1;d++)first[d+1]+=first[d];
+    std::vector<uint64_t> cursor(first,first+max_depth+1);
+    std::memcpy(data.data()+sizeof(header_t),words.data(),8*words.size());
+
+    uint8_t* arrays = data.data()+head;
+    for(size_t i=0;i<n;i++){
+        postings_t::store(arrays,header.width,i,offsets[i]);
+        postings_t::store(arrays+header.width*n,header.width,i,ends[i]);
+        if(header.depth_width==2){uint16_t v=depths[i];std::memcpy(arrays+2*header.width*n+2*i,&v,2);}
+        else{uint32_t v=depths[i];std::memcpy(arrays+2*header.width*n+4*i,&v,4);}
+        postings_t::store(arrays+(2*header.width+header.depth_width)*n,header.width,cursor[depths[i]]++,i);
+    }
+
+    return Topology(std::move(data));
+}
+
+std::expected<Topology,Topology::from_binary_error_t> Topology::from_binary(std::span<const uint8_t> region, uint32_t doc){
+    if(region.size_bytes()<sizeof(binary_header_t))return std::unexpected(from_binary_error_t::Missing);
+    auto payload = binary_extension(region,extension_kind_t::TOPOLOGY,doc);
+    if(!payload.has_value())return std::unexpected(from_binary_error_t::Missing);
+
+    if(payload->size_bytes()<sizeof(header_t))return std::unexpected(from_binary_error_t::HeaderTooSmall);
+    header_t header;
+    std::memcpy(&header,payload->data(),sizeof(header));
+    if(std::memcmp(header.magic,"$XTP",4)!=0 || (header.width!=4 && header.width!=8) || (header.depth_width!=2 && header.depth_width!=4) || header.granule>3)
+        return std::unexpected(from_binary_error_t::MagicMismatch);
+    if(header.words>payload->size_bytes()/8 || header.nodes>payload->size_bytes())return std::unexpected(from_binary_error_t::TruncatedSpan);
+    if(payload->size_bytes()!=sizeof(header_t)+8*(header.words+(header.words+7)/8+(uint64_t)header.max_depth+2)+(3*header.width+header.depth_width)*header.nodes)
+        return std::unexpected(from_binary_error_t::TruncatedSpan);
+
+    const binary_header_t& bin = *(const binary_header_t*)region.data();
+    if(doc>=bin.docs_count)return std::unexpected(from_binary_error_t::OutOfBounds);
+    uint64_t limit = bin.sections[doc].length;
+
+    //Lookups trust the arrays, so all the invariants they depend on are checked once here.
+    Topology ret(*payload);
+    auto fail = std::unexpected(from_binary_error_t::OutOfBounds);
+
+    //Offsets are sorted, start from the root, and match the bits set in `starts` and the rank samples, so that `id` stays within the arrays.
+    if(!ret.offsets().valid(0,header.nodes,limit) || (header.nodes!=0 && ret.offsets()[0]!=0))return fail;
+    uint64_t rank = 0;
+    for(size_t i=0;i<header.words;i++){
+        if(i%8==0 && ret.sample(i/8)!=rank)return fail;
+        rank+=std::popcount(ret.word(i));
+    }
+    if(rank!=header.nodes)return fail;
+    for(size_t i=0;i<header.nodes;i++){
+        uint64_t offset = ret.offsets()[i];
+        uint64_t slot = offset>>header.granule;
+        if((offset&((1ull<<header.granule)-1))!=0 || slot>=header.words*64 || !((ret.word(slot/64)>>(slot%64))&1))return fail;
+    }
+
+    //Depths only grow one level at a time in pre-order, so every node has an ancestor at each level above it.
+    for(size_t i=0;i<header.nodes;i++){
+        if(ret.end(i)<=i || ret.end(i)>header.nodes || ret.depth(i)>header.max_depth)return fail;
+        if(i==0?ret.depth(i)!=0:ret.depth(i)>ret.depth(i-1)+1)return fail;
+    }
+
+    //Levels hold every node once, as ids sorted within each level and with the depth of that level.
+    if(ret.level_first(0)!=0 || ret.level_first(header.max_depth+1)!=header.nodes)return fail;
+    for(size_t d=0;d<=header.max_depth;d++){
+        if(ret.level_first(d)>ret.level_first(d+1))return fail;
+    }
+    for(size_t d=0;d<=header.max_depth;d++){
+        auto first = ret.level_first(d), last = ret.level_first(d+1);
+        if(!ret.levels().valid(first,last-first,header.nodes))return fail;
+        for(auto i=first;i<last;i++){
+            if(ret.depth(ret.levels()[i])!=d)return fail;
+        }
+    }
+    return ret;
+}
+
+}
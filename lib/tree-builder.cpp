@@ -1,3 +1,6 @@
+#include <cstring>
+#include <utility>
+
 #include <vs-xml/commons.hpp>
 #include <vs-xml/tree.hpp>
 #include <vs-xml/tree-builder.hpp>
@@ -7,6 +10,21 @@ namespace VS_XML_NS{
 
 namespace details{
 
+void node_buffer_t::make_sparse(size_t reserve){
+    SparseArena tmp(reserve);
+    tmp.resize(size());
+    if(size()!=0)std::memcpy(tmp.data(),data(),size());
+    vector = {};
+    arena = std::move(tmp);
+}
+
+std::vector<uint8_t> node_buffer_t::take_vector(){
+    if(!arena.has_value())return std::exchange(vector,{});
+    std::vector<uint8_t> ret(arena->begin(),arena->end());
+    arena.reset();
+    return ret;
+}
+
 template<typename T>
 BuilderBase::error_t BuilderBase::leaf(std::string_view value){
     if(open==false)return error_t::TREE_CLOSED;
@@ -148,6 +166,41 @@ sv Symbols<builder_config_t::symbols_t::COMPRESS_LABELS>::symbol(std::string_vie
 
 //TODO: Add symbol2 for COMPRESS_ALL which does not compress it.
 
+bool BuilderBase::remap_symbols(std::span<uint8_t> frame, void(*fn)(sv& ref, void* ctx), void* ctx){
+    //Nodes are contiguous, so the frame can be walked linearly without following links.
+    uint8_t* current = frame.data();
+    uint8_t* end = frame.data()+frame.size();
+    while(current<end){
+        switch(((unknown_t*)current)->type()){
+            case type_t::ELEMENT:{
+                auto& node = *(element_t*)current;
+                fn(node._ns,ctx);
+                fn(node._name,ctx);
+                for(xml_count_t i=0;i<node.attrs_count;i++){
+                    auto& attr = node.get_attr(i);
+                    fn(attr._ns,ctx);
+                    fn(attr._name,ctx);
+                    fn(attr._value,ctx);
+                }
+                current+=sizeof(element_t)+sizeof(attr_t)*node.attrs_count;
+                break;
+            }
+            case type_t::TEXT:
+            case type_t::CDATA:
+            case type_t::COMMENT:
+            case type_t::PROC:
+            case type_t::MARKER:
+                //All leaves share the same layout.
+                fn(((leaf_t<text_t>*)current)->_value,ctx);
+                current+=sizeof(text_t);
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
 BuilderBase::error_t BuilderBase::inject(const TreeRaw& tree, const unknown_t* base, bool include_root){
     if(base==nullptr)base=(const unknown_t*)&tree.root();
     //If the symbol offset for tree and BuilderBase is the same, we are good and memcopy is possible.
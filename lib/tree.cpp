@@ -1,3 +1,5 @@
+#include <array>
+#include <atomic>
 #include <cstring>
 #include <algorithm>
 #include <string_view>
@@ -7,6 +9,8 @@
 #include <vs-xml/node.hpp>
 #include <vs-xml/wrp-node.hpp>
 #include <vs-xml/serializer.hpp>
+#include <vs-xml/executor.hpp>
+#include <vs-xml/checksum.hpp>
 
 #include <vs-xml/fwd/print.hpp>
 #include <vs-xml/private/visit.hpp>
@@ -332,11 +336,41 @@ TreeRaw TreeRaw::clone(const element_t* ref, bool reduce) const{
 }
 
 
-bool TreeRaw::save_binary(std::ostream& out)const{
+namespace details{
+
+void save_extensions(std::ostream& out, size_t offset, std::span<const binary_extension_t> extensions){
+    if(extensions.size()==0)return;
+    char tmp[16]{};
+    std::vector<binary_header_t::extension_t> table;
+    table.reserve(extensions.size());
+    for(auto& extension : extensions){
+        if(offset%16!=0){out.write(tmp,16-offset%16);offset+=16-offset%16;}
+        table.push_back({(uint16_t)extension.kind,extension.flags,extension.doc,offset,extension.payload.size_bytes()});
+        out.write((const char*)extension.payload.data(),extension.payload.size_bytes());
+        offset+=extension.payload.size_bytes();
+    }
+    if(offset%16!=0)out.write(tmp,16-offset%16);
+    out.write((const char*)table.data(),sizeof(binary_header_t::extension_t)*table.size());
+}
+
+}
+
+bool TreeRaw::save_binary(std::ostream& out, std::span<const binary_extension_t> extensions, bool checksums)const{
     if(configs.symbols==builder_config_t::EXTERN_ABS)return false; //Symbols not relocatable.
+    if(extensions.size()+checksums>UINT16_MAX)return false;
+
+    //Header, symbols and data, filled in while writing them.
+    std::array<uint32_t,3> sums{};
+    std::vector<binary_extension_t> all;
+    if(checksums){
+        all.assign(extensions.begin(),extensions.end());
+        all.push_back({extension_kind_t::CHECKSUMS,0,{(const uint8_t*)sums.data(),sizeof(sums)}});
+        extensions = all;
+    }
 
     binary_header_t header{};
     header.configs = configs;
+    header.extensions_count = extensions.size();
     if(header.configs.symbols==builder_config_t::EXTERN_REL)header.configs.symbols=builder_config_t::OWNED; //Symbols are copied even if the where shared, so they are now owned.
 
     size_t align_symbols = (header.size()+symbols.size_bytes()%16==0)?0:(16-(header.size()+symbols.size_bytes())%16);
@@ -350,6 +384,12 @@ bool TreeRaw::save_binary(std::ostream& out)const{
         out.write(tmp, align_symbols);
     }
     out.write((const char*)buffer.data(), buffer.size_bytes());
+    if(checksums){
+        sums[0] = crc32c({(const uint8_t*)&section,sizeof(section)},crc32c({(const uint8_t*)&header,sizeof(header)}));
+        sums[1] = crc32c({(const uint8_t*)symbols.data(),symbols.size_bytes()});
+        sums[2] = crc32c({(const uint8_t*)buffer.data(),buffer.size_bytes()});
+    }
+    details::save_extensions(out, header.start_data()+buffer.size_bytes(), extensions);
     out.flush();
     return true;
 }
@@ -382,7 +422,14 @@ std::expected<TreeRaw, TreeRaw::from_binary_error_t> TreeRaw::from_binary(std::s
     auto endianess = std::endian::native==std::endian::little?binary_header_t::endianess_t::LITTLE:binary_header_t::endianess_t::BIG;
     if(header.endianess!=endianess) return std::unexpected(from_binary_error_t{from_binary_error_t::TypeMismatch});
 
-    //TODO: Restore bounds checks (?) on sections?
+    if(region.size_bytes() < header.start_data()+sizeof(binary_header_t::extension_t)*header.extensions_count)
+        return std::unexpected(from_binary_error_t{from_binary_error_t::TruncatedSpan});
+
+    {
+        auto section = header.region(0);
+        if(section.base<0 || (uint64_t)section.base+section.length>region.size_bytes()-header.start_data())
+            return std::unexpected(from_binary_error_t{from_binary_error_t::TreeOutOfBounds});
+    }
 
     return TreeRaw(header.configs,
         std::span<uint8_t>{region.data()+header.start_data()+header.region(0).base, header.region(0).length},
@@ -395,6 +442,167 @@ std::expected<const TreeRaw, TreeRaw::from_binary_error_t>  TreeRaw::from_binary
     return from_binary(std::span<uint8_t>{(uint8_t*)region.data(),(uint8_t*)region.data()+region.size_bytes()});
 }
 
+namespace{
+
+using from_binary_error_t = TreeRaw::from_binary_error_t;
+
+//Checks run by `TreeRaw::verify`, all offsets being relative to the beginning of the buffer.
+struct verifier_t{
+    std::span<const uint8_t>    buffer;
+    std::span<const uint8_t>    symbols;
+    std::atomic<int>            failure = from_binary_error_t::OK;
+
+    static constexpr size_t none = -1;
+
+    //A run of sibling subtrees, with the parent they must point to and the sibling preceding the first one.
+    struct range_t{
+        size_t  begin;
+        size_t  end;
+        size_t  parent;
+        size_t  prev;
+    };
+
+    inline bool fail(from_binary_error_t::Code code){
+        int expected = from_binary_error_t::OK;
+        failure.compare_exchange_strong(expected,code);
+        return false;
+    }
+
+    inline bool check_sv(sv s){
+        if(s.length==0)return true;
+        if(s.base<0 || (uint64_t)s.base+s.length>symbols.size())return fail(from_binary_error_t::SymbolsOutOfBounds);
+        return true;
+    }
+
+    inline const uint8_t* at(size_t offset) const{return offset==none?nullptr:buffer.data()+offset;}
+
+    /**
+     * Check the node at `offset`, without its children, given its expected parent and previous sibling.
+     * Returns the end of its subtree and, for elements, the beginning of its children. `limit` is the end of the parent.
+     */
+    bool node(size_t offset, size_t parent, size_t prev, size_t limit, size_t& end, size_t& children){
+        if(offset+sizeof(base_t<unknown_t>)>limit)return fail(from_binary_error_t::TreeOutOfBounds);
+        auto& n = *(const unknown_t*)(buffer.data()+offset);
+        switch(n.type()){
+            case type_t::ELEMENT:{
+                if(offset+sizeof(element_t)>limit)return fail(from_binary_error_t::TreeOutOfBounds);
+                auto& e = (const element_t&)n;
+                auto [attrs_begin,attrs_end] = *e.attrs_range();
+                children = (const uint8_t*)attrs_end-buffer.data();
+                if(children>limit || (const uint8_t*)e.next()<(const uint8_t*)attrs_end || (size_t)((const uint8_t*)e.next()-buffer.data())>limit)
+                    return fail(from_binary_error_t::TreeOutOfBounds);
+                end = (const uint8_t*)e.next()-buffer.data();
+                //Visitors trust the flag to step to a sibling, so it must be set exactly when one follows within the parent.
+                if(e.has_next()!=(end<limit))return fail(from_binary_error_t::TreeOutOfBounds);
+                if((const uint8_t*)e.parent()!=(parent==none?nullptr:at(parent)) || (const uint8_t*)e.prev()!=at(prev))
+                    return fail(from_binary_error_t::TreeOutOfBounds);
+                if(!check_sv(*e.ns()) || !check_sv(*e.name()))return false;
+                for(auto attr = attrs_begin;attr<attrs_end;attr++){
+                    if(!check_sv(*attr->ns()) || !check_sv(*attr->name()) || !check_sv(*attr->value()))return false;
+                }
+                return true;
+            }
+            case type_t::TEXT:
+            case type_t::CDATA:
+            case type_t::COMMENT:
+            case type_t::PROC:
+            case type_t::MARKER:{
+                //All leaves share the same layout.
+                if(offset+sizeof(text_t)>limit)return fail(from_binary_error_t::TreeOutOfBounds);
+                auto& l = (const text_t&)n;
+                end = offset+sizeof(text_t);
+                children = end;
+                if((l.has_parent()?(const uint8_t*)l.parent():nullptr)!=(parent==none?nullptr:at(parent)) || (l.has_prev()?(const uint8_t*)l.prev():nullptr)!=at(prev))
+                    return fail(from_binary_error_t::TreeOutOfBounds);
+                return check_sv(*l.value());
+            }
+            default:
+                return fail(from_binary_error_t::TreeOutOfBounds);
+        }
+    }
+
+    //Check all subtrees in a range, without recursion.
+    bool subtrees(range_t range){
+        struct open_t{
+            size_t  offset;
+            size_t  end;
+            size_t  last;
+        };
+        std::vector<open_t> stack;
+        stack.push_back({range.parent,range.end,range.prev});
+        size_t offset = range.begin;
+        for(;;){
+            if(failure!=from_binary_error_t::OK)return false;
+            while(stack.size()>1 && offset==stack.back().end)stack.pop_back();
+            if(stack.size()==1 && offset==range.end)return true;
+            auto& top = stack.back();
+            size_t end, children;
+            if(!node(offset,top.offset,top.last,top.end,end,children))return false;
+            top.last = offset;
+            if(((const unknown_t*)(buffer.data()+offset))->type()==type_t::ELEMENT){
+                stack.push_back({offset,end,none});
+                offset = children;
+            }
+            else offset = end;
+        }
+    }
+
+    //Check the nodes of a range, but not their children. Elements with children are appended to `next` as new ranges.
+    bool split(range_t range, std::vector<range_t>& next){
+        size_t prev = range.prev;
+        for(size_t offset = range.begin;offset<range.end;){
+            size_t end, children;
+            if(!node(offset,range.parent,prev,range.end,end,children))return false;
+            if(children<end)next.push_back({children,end,offset,none});
+            prev = offset;
+            offset = end;
+        }
+        return true;
+    }
+};
+
+}
+
+std::expected<void, TreeRaw::from_binary_error_t> TreeRaw::verify(Executor* executor) const{
+    verifier_t ctx{buffer,symbols};
+    auto error = [&](){return std::unexpected(from_binary_error_t{(from_binary_error_t::Code)ctx.failure.load()});};
+    if(buffer.size()==0)return std::unexpected(from_binary_error_t{from_binary_error_t::TreeOutOfBounds});
+
+    size_t end, children;
+    if(!ctx.node(0,verifier_t::none,verifier_t::none,buffer.size(),end,children))return error();
+
+    std::vector<verifier_t::range_t> ranges;
+    if(children<end)ranges.push_back({children,end,0,verifier_t::none});
+
+    //Split the tree level by level, until there are enough subtrees to keep all threads busy.
+    if(executor!=nullptr){
+        size_t target = 4*executor->concurrency();
+        for(size_t depth=0;depth<8 && ranges.size()!=0 && ranges.size()<target;depth++){
+            std::vector<verifier_t::range_t> next;
+            for(auto& range : ranges){
+                if(!ctx.split(range,next))return error();
+            }
+            ranges = std::move(next);
+        }
+    }
+
+    struct job_t{
+        verifier_t& ctx;
+        std::span<const verifier_t::range_t> ranges;
+    } job{ctx,ranges};
+    auto task = +[](void* ptr, size_t begin, size_t end){
+        auto& job = *(job_t*)ptr;
+        for(size_t i=begin;i<end;i++){
+            if(!job.ctx.subtrees(job.ranges[i]))return;
+        }
+    };
+    if(executor!=nullptr && ranges.size()>1)executor->parallel_for(ranges.size(),task,&job);
+    else task(&job,0,ranges.size());
+
+    if(ctx.failure!=from_binary_error_t::OK)return error();
+    return {};
+}
+
 std::string_view TreeRaw::from_binary_error_t::msg() {
     switch(code) {
         case OK:                  return "OK";
@@ -0,0 +1,252 @@
+#include <vs-xml/xpath.hpp>
+
+namespace VS_XML_NS{
+namespace query{
+
+namespace{
+
+struct xpath_parser_t{
+    QueryBuilder&       bld;
+    std::string_view    expr;
+    size_t              pos = 0;
+
+    using result_t = std::expected<void,xpath_error_t>;
+
+    inline std::unexpected<xpath_error_t> fail(xpath_error_t::ErrorCode code) const{return std::unexpected(xpath_error_t{code,pos});}
+
+    inline result_t check(QueryBuilder::error_t err) const{
+        if(err!=QueryBuilder::error_t::OK)return std::unexpected(xpath_error_t{xpath_error_t::BUILDER,pos,err});
+        return {};
+    }
+
+    inline void skip_whitespace(){
+        while(pos<expr.size() && (expr[pos]==' ' || expr[pos]=='\t' || expr[pos]=='\n' || expr[pos]=='\r'))pos++;
+    }
+
+    inline bool consume(std::string_view token){
+        skip_whitespace();
+        if(expr.substr(pos).starts_with(token)){pos+=token.size();return true;}
+        return false;
+    }
+
+    static inline bool name_start(char c){return (c>='a' && c<='z') || (c>='A' && c<='Z') || c=='_' || (uint8_t)c>=0x80;}
+    static inline bool name_char(char c){return name_start(c) || (c>='0' && c<='9') || c=='-' || c=='.';}
+
+    //NCName, empty if none.
+    inline std::string_view name(){
+        skip_whitespace();
+        size_t start = pos;
+        if(pos<expr.size() && name_start(expr[pos])){
+            pos++;
+            while(pos<expr.size() && name_char(expr[pos]))pos++;
+        }
+        return expr.substr(start,pos-start);
+    }
+
+    //A qualified name or a wildcard, as {prefix, local}. An empty local name stands for `*`.
+    std::expected<std::pair<std::string_view,std::string_view>,xpath_error_t> qname(){
+        skip_whitespace();
+        if(consume("*"))return std::pair<std::string_view,std::string_view>{};
+        auto first = name();
+        if(first.size()==0)return fail(xpath_error_t::BAD_NAME);
+        if(pos<expr.size() && expr[pos]==':' && !expr.substr(pos).starts_with("::")){
+            pos++;
+            if(pos<expr.size() && expr[pos]=='*'){pos++;return std::pair{first,std::string_view{}};}
+            auto second = name();
+            if(second.size()==0)return fail(xpath_error_t::BAD_NAME);
+            return std::pair{first,second};
+        }
+        return std::pair<std::string_view,std::string_view>{{},first};
+    }
+
+    std::expected<std::string_view,xpath_error_t> literal(){
+        skip_whitespace();
+        if(pos>=expr.size())return fail(xpath_error_t::UNEXPECTED_END);
+        char quote = expr[pos];
+        if(quote!='\'' && quote!='"')return fail(xpath_error_t::UNEXPECTED_TOKEN);
+        auto end = expr.find(quote,pos+1);
+        if(end==expr.npos)return fail(xpath_error_t::BAD_LITERAL);
+        auto ret = expr.substr(pos+1,end-pos-1);
+        pos = end+1;
+        return ret;
+    }
+
+    //`text()` or `.`, as the first argument of string functions and in comparisons.
+    inline bool context_text(){return consume("text()") || consume(".");}
+
+    result_t text_function(text_mode_t mode){
+        if(!consume("("))return fail(xpath_error_t::UNEXPECTED_TOKEN);
+        if(!context_text())return fail(xpath_error_t::UNSUPPORTED);
+        if(!consume(","))return fail(xpath_error_t::UNEXPECTED_TOKEN);
+        auto value = literal();
+        if(!value.has_value())return std::unexpected(value.error());
+        if(!consume(")"))return fail(xpath_error_t::UNEXPECTED_TOKEN);
+        return check(bld.match_all_text({*value},mode));
+    }
+
+    result_t condition(){
+        skip_whitespace();
+        if(pos>=expr.size())return fail(xpath_error_t::UNEXPECTED_END);
+
+        if(expr[pos]>='0' && expr[pos]<='9'){
+            uint64_t position = 0;
+            while(pos<expr.size() && expr[pos]>='0' && expr[pos]<='9'){
+                position = position*10+(expr[pos]-'0');
+                if(position>UINT32_MAX)return fail(xpath_error_t::BAD_POSITION);
+                pos++;
+            }
+            if(position==0)return fail(xpath_error_t::BAD_POSITION);
+            return check(bld.match_position(position));
+        }
+        if(consume("@")){
+            auto label = qname();
+            if(!label.has_value())return std::unexpected(label.error());
+            Token::attr_t<Token::type_t::MATCH_ATTR> attr;
+            if(label->second.size()!=0)attr.name=label->second;
+            if(label->first.size()!=0)attr.ns=label->first;
+            if(consume("=")){
+                auto value = literal();
+                if(!value.has_value())return std::unexpected(value.error());
+                attr.value=*value;
+            }
+            return check(bld.match_attr(attr));
+        }
+        if(consume("contains"))return text_function(text_mode_t::CONTAINS);
+        if(consume("starts-with"))return text_function(text_mode_t::PREFIX);
+        if(context_text()){
+            if(!consume("="))return fail(xpath_error_t::UNSUPPORTED);
+            auto value = literal();
+            if(!value.has_value())return std::unexpected(value.error());
+            return check(bld.match_all_text({*value}));
+        }
+        return fail(xpath_error_t::UNSUPPORTED);
+    }
+
+    result_t predicates(){
+        while(consume("[")){
+            do{
+                if(auto ret = condition(); !ret.has_value())return ret;
+            }while(consume("and"));
+            if(!consume("]"))return fail(xpath_error_t::UNEXPECTED_TOKEN);
+        }
+        return {};
+    }
+
+    //Filters of a step: its node test and predicates.
+    result_t node_test(){
+        skip_whitespace();
+        if(pos>=expr.size())return fail(xpath_error_t::UNEXPECTED_END);
+        if(expr[pos]=='@')return fail(xpath_error_t::UNSUPPORTED);
+
+        if(consume("text()")){
+            if(auto ret = check(bld.match_type({.is_text=true,.is_cdata=true})); !ret.has_value())return ret;
+        }
+        else if(consume("comment()")){
+            if(auto ret = check(bld.match_type({.is_comment=true})); !ret.has_value())return ret;
+        }
+        else if(consume("processing-instruction()")){
+            if(auto ret = check(bld.match_type({.is_proc=true})); !ret.has_value())return ret;
+        }
+        else if(consume("node()")){}
+        else{
+            auto label = qname();
+            if(!label.has_value())return std::unexpected(label.error());
+            if(auto ret = check(bld.match_type({.is_element=true})); !ret.has_value())return ret;
+            if(label->first.size()!=0){
+                if(auto ret = check(bld.match_ns({label->first})); !ret.has_value())return ret;
+            }
+            if(label->second.size()!=0){
+                if(auto ret = check(bld.match_name({label->second})); !ret.has_value())return ret;
+            }
+        }
+        return predicates();
+    }
+
+    //Axis specifier of a step, overriding the one implied by the separator.
+    std::expected<axis_t,xpath_error_t> axis(axis_t implied){
+        skip_whitespace();
+        size_t start = pos;
+        auto word = name();
+        if(consume("::")){
+            if(word=="child")return implied;
+            if(word=="descendant")return axis_t::DESCENDANT;
+            pos = start;
+            return fail(xpath_error_t::UNSUPPORTED);
+        }
+        pos = start;
+        return implied;
+    }
+
+    result_t parse(std::string_view frame){
+        if(auto ret = check(bld.begin_frame(frame,QueryBuilder::IS)); !ret.has_value())return ret;
+        size_t depth = 0;
+
+        //The root element is the context: absolute paths match it with their first step, relative ones start from its children.
+        skip_whitespace();
+        std::optional<axis_t> next;
+        if(consume("//"))next = axis_t::DESCENDANT;
+        else if(consume("/")){
+            if(auto ret = node_test(); !ret.has_value())return ret;
+        }
+        else if(consume(".//"))next = axis_t::DESCENDANT;
+        else if(consume("./"))next = axis_t::CHILD;
+        else next = axis_t::CHILD;
+
+        for(;;){
+            if(next.has_value()){
+                auto a = axis(*next);
+                if(!a.has_value())return std::unexpected(a.error());
+                auto opened = *a==axis_t::CHILD?bld.begin():bld.any();
+                if(auto ret = check(opened); !ret.has_value())return ret;
+                depth++;
+                if(auto ret = node_test(); !ret.has_value())return ret;
+            }
+            skip_whitespace();
+            if(pos==expr.size())break;
+            if(consume("//"))next = axis_t::DESCENDANT;
+            else if(consume("/"))next = axis_t::CHILD;
+            else if(expr[pos]=='|')return fail(xpath_error_t::UNSUPPORTED);
+            else return fail(xpath_error_t::UNEXPECTED_TOKEN);
+        }
+
+        for(size_t i=0;i<depth;i++){
+            if(auto ret = check(bld.end()); !ret.has_value())return ret;
+        }
+        return check(bld.end_frame());
+    }
+};
+
+}
+
+std::expected<void,xpath_error_t> xpath(QueryBuilder& bld, std::string_view expr, std::string_view name){
+    xpath_parser_t parser{bld,expr};
+    return parser.parse(name.size()==0?expr:name);
+}
+
+std::expected<Query,xpath_error_t> xpath(std::string_view expr){
+    QueryBuilder bld;
+    if(auto ret = xpath(bld,expr); !ret.has_value())return std::unexpected(ret.error());
+    auto ret = bld.close();
+    if(!ret.has_value())return std::unexpected(xpath_error_t{xpath_error_t::BUILDER,expr.size(),ret.error()});
+    return std::move(*ret);
+}
+
+std::expected<const Query*,xpath_error_t> XPathCache::get(std::string_view expr){
+    std::optional<xpath_error_t> error;
+    auto entry = queries.get(fnv1a(expr),
+        [&](const entry_t& e){return e.text==expr;},
+        [&]()->std::unique_ptr<entry_t>{
+            auto compiled = xpath(expr);
+            if(!compiled.has_value()){
+                error = compiled.error();
+                return nullptr;
+            }
+            return std::make_unique<entry_t>(std::string(expr),std::move(*compiled));
+        }
+    );
+    if(entry==nullptr)return std::unexpected(*error);
+    return &entry->query;
+}
+
+}
+}
@@ -0,0 +1,472 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <vs-xml/archive-builder.hpp>
+#include <vs-xml/archive-compressed.hpp>
+#include <vs-xml/archive-segments.hpp>
+#include <vs-xml/archive-shared.hpp>
+#include <vs-xml/binary-convert.hpp>
+#include <vs-xml/checksum.hpp>
+#include <vs-xml/lz.hpp>
+#include <vs-xml/mapped.hpp>
+#include <vs-xml/query-archive.hpp>
+
+using namespace xml;
+
+auto mk_archive(size_t docs){
+    ArchiveBuilder<{.symbols=builder_config_t::COMPRESS_ALL}> bld;
+    std::vector<std::string> names;
+    for(size_t i=0;i<docs;i++)names.push_back("doc-"+std::to_string(i));
+
+    for(size_t i=0;i<docs;i++){
+        auto t = bld.document(names[i], [&](auto& bld){
+            bld.begin("root");
+                for(size_t j=0;j<i%7;j++){
+                    bld.begin("item");
+                        bld.attr("even",(j%2==0)?"yes":"no");
+                    bld.end();
+                }
+            bld.end();
+        });
+        assert(t==details::BuilderBase::error_t::OK);
+    }
+    return *bld.close();
+}
+
+//The same documents as `mk_archive`, split across the parts of a parallel builder.
+template<builder_config_t cfg>
+auto mk_parallel_archive(size_t docs, size_t parts, Executor* executor){
+    ParallelArchiveBuilder<cfg> bld(parts);
+    struct ctx_t{
+        ParallelArchiveBuilder<cfg>& bld;
+        size_t docs;
+        std::atomic<bool> ok = true;
+    } ctx{bld,docs};
+
+    Executor local(2);
+    local.parallel_for(parts,+[](void* ptr, size_t begin, size_t end){
+        auto& ctx = *(ctx_t*)ptr;
+        for(size_t part=begin;part<end;part++){
+            for(size_t i=part*ctx.docs/ctx.bld.parts();i<(part+1)*ctx.docs/ctx.bld.parts();i++){
+                auto t = ctx.bld.document(part,"doc-"+std::to_string(i),[&](auto& bld){
+                    bld.begin("root");
+                        for(size_t j=0;j<i%7;j++){
+                            bld.begin("item");
+                                bld.attr("even",(j%2==0)?"yes":"no");
+                            bld.end();
+                        }
+                    bld.end();
+                });
+                if(t!=details::BuilderBase::error_t::OK)ctx.ok=false;
+            }
+        }
+    },&ctx);
+    assert(ctx.ok);
+    return *bld.close(executor);
+}
+
+std::string print(const ArchiveRaw& archive, size_t idx){
+    std::stringstream out;
+    archive.get(idx)->print(out);
+    return out.str();
+}
+
+int main(){
+    auto archive = mk_archive(500);
+    assert(archive.items()==500);
+
+    auto query = query::query_t{}/"root"/"item"*query::match_attr({"even","yes"})*query::accept();
+
+    std::vector<std::pair<size_t,const unknown_t*>> expected;
+    for(size_t i=0;i<archive.items();i++){
+        Document doc(std::move(*archive.downgrade().get(i)));
+        for(auto node : query::is(doc.root(),query))expected.emplace_back(i,(const unknown_t*)node);
+    }
+    assert(expected.size()>500);
+
+    Executor executor(4);
+
+    //Parallel queries, ordered as the sequential ones.
+    {
+        std::vector<std::pair<size_t,const unknown_t*>> results;
+        assert(query::is(archive,query,executor,+[](size_t doc, wrp::base_t<unknown_t> node, void* ctx){
+            ((std::vector<std::pair<size_t,const unknown_t*>>*)ctx)->emplace_back(doc,(const unknown_t*)node);
+            return true;
+        },&results));
+        assert(results==expected);
+    }
+
+    //Unordered, same matches.
+    {
+        std::vector<std::pair<size_t,const unknown_t*>> results;
+        assert(query::is(archive,query,executor,+[](size_t doc, wrp::base_t<unknown_t> node, void* ctx){
+            ((std::vector<std::pair<size_t,const unknown_t*>>*)ctx)->emplace_back(doc,(const unknown_t*)node);
+            return true;
+        },&results,query::order_t::UNORDERED));
+        std::sort(results.begin(),results.end());
+        assert(results==expected);
+    }
+
+    //Stopped by the sink.
+    {
+        size_t count = 0;
+        assert(!query::is(archive,query,executor,+[](size_t, wrp::base_t<unknown_t>, void* ctx){
+            return ++*(size_t*)ctx<10;
+        },&count));
+        assert(count==10);
+    }
+
+    //Lookups by name, in memory and after a round trip through the binary format.
+    {
+        assert(!archive.get(archive.items()).has_value());
+        assert(archive.downgrade().find("doc-137")==137);
+        assert(!archive.downgrade().find("doc-500").has_value());
+        assert(!archive.downgrade().find("").has_value());
+
+        std::stringstream out;
+        assert(archive.save_binary(out));
+        std::string bin = out.str();
+        auto loaded = Archive::from_binary(std::span<const uint8_t>{(const uint8_t*)bin.data(),bin.size()});
+        assert(loaded.has_value());
+        assert(binary_extension({(const uint8_t*)bin.data(),bin.size()},extension_kind_t::ARCHIVE_NAMES).has_value());
+        for(size_t i=0;i<loaded->items();i+=17){
+            assert(loaded->downgrade().find("doc-"+std::to_string(i))==i);
+            assert(loaded->get("doc-"+std::to_string(i)).has_value());
+        }
+        assert(!loaded->downgrade().find("doc-").has_value());
+        assert(!loaded->downgrade().find("doc-9999").has_value());
+    }
+
+    //Converted to another layout and back, keeping the name index.
+    {
+        std::stringstream out, converted, back;
+        assert(archive.save_binary(out));
+        std::string bin = out.str();
+        assert(convert_binary(std::span<const uint8_t>{(const uint8_t*)bin.data(),bin.size()},converted,{1,binary_header_t::endianess_t::BIG}).has_value());
+        std::string other = converted.str();
+        assert(binary_layout(std::span<const uint8_t>{(const uint8_t*)other.data(),other.size()})->layout==1);
+        assert(convert_binary(std::span<const uint8_t>{(const uint8_t*)other.data(),other.size()},back).has_value());
+        std::string restored = back.str();
+        std::span<const uint8_t> region{(const uint8_t*)restored.data(),restored.size()};
+        assert(binary_extension(region,extension_kind_t::ARCHIVE_NAMES).has_value());
+        auto loaded = Archive::from_binary(region,ArchiveRaw::verify_t::EAGER);
+        assert(loaded.has_value() && loaded->items()==archive.items());
+        assert(loaded->find("doc-42")==archive.find("doc-42"));
+    }
+
+    //Codec round trips, including data which does not compress and malformed input.
+    {
+        std::vector<std::vector<uint8_t>> samples(4);
+        for(size_t i=0;i<100000;i++)samples[1].push_back("abcabcabd"[i%9]);
+        uint32_t seed = 7;
+        for(size_t i=0;i<5000;i++){seed=seed*1103515245+12345;samples[2].push_back(seed>>16);}
+        samples[3] = {1,2,3};
+        for(auto& sample : samples){
+            std::vector<uint8_t> compressed(lz::bound(sample.size())), restored(sample.size());
+            size_t length = lz::compress(sample,compressed);
+            assert(length!=0 && lz::decompress({compressed.data(),length},restored) && restored==sample);
+            if(sample.size()>0)assert(!lz::decompress({compressed.data(),length-1},restored));
+        }
+        std::vector<uint8_t> compressed(lz::bound(samples[1].size()));
+        assert(lz::compress(samples[1],compressed)<samples[1].size()/20);
+        uint8_t bad[] = {0x04,'a',0x10,0x00};   //Distance beyond the beginning of the output
+        std::vector<uint8_t> out(9);
+        assert(!lz::decompress(bad,out));
+    }
+
+    //Compressed in blocks, with documents decompressed on demand.
+    {
+        std::stringstream out, compressed;
+        assert(archive.save_binary(out));
+        std::string bin = out.str();
+        std::span<const uint8_t> original{(const uint8_t*)bin.data(),bin.size()};
+        assert(compress_binary(original,compressed,4096,&executor));
+        std::string packed = compressed.str();
+        std::span<const uint8_t> region{(const uint8_t*)packed.data(),packed.size()};
+        assert(packed.size()*3<bin.size());
+
+        auto restored = decompress_binary(region,&executor);
+        assert(restored.has_value() && std::string(restored->begin(),restored->end())==bin);
+
+        auto loaded = CompressedArchive::from_binary(region,4,true);
+        assert(loaded.has_value() && loaded->items()==archive.items() && loaded->size()==bin.size());
+        for(size_t i=0;i<archive.items();i++){
+            auto doc = loaded->get(i);
+            assert(doc!=nullptr);
+            std::stringstream printed;
+            doc->print(printed);
+            assert(printed.str()==print(archive,i));
+        }
+        assert(loaded->stats().hits>0 && loaded->stats().misses>0);
+        assert(loaded->find("doc-42")==42 && loaded->get("doc-499")!=nullptr && loaded->get("missing")==nullptr && loaded->get(500)==nullptr);
+
+        std::vector<uint8_t> range(1000);
+        assert(loaded->read(bin.size()-1000,range) && std::string(range.begin(),range.end())==bin.substr(bin.size()-1000));
+        assert(!loaded->read(bin.size()-999,range));
+
+        //Corrupted blocks are detected when decoded.
+        auto& header = *(const compressed_header_t*)packed.data();
+        auto offsets = (const uint64_t*)(packed.data()+sizeof(compressed_header_t));
+        auto& binary_header = *(const binary_header_t*)bin.data();
+        size_t block = (binary_header.start_data()+binary_header.sections[250].base)/header.block_size;
+        assert(offsets[block+1]-offsets[block]<header.block_size);
+        std::fill(packed.begin()+offsets[block],packed.begin()+offsets[block+1],'\xff');
+        assert(!decompress_binary(region).has_value());
+        auto corrupted = CompressedArchive::from_binary(region,4,true);
+        assert(corrupted.has_value() && corrupted->get(0)!=nullptr && corrupted->get(499)!=nullptr);
+        assert(corrupted->get(250)==nullptr);
+    }
+
+    //Verification when loading, eager or on first access.
+    {
+        std::stringstream out;
+        assert(archive.save_binary(out));
+        std::string bin = out.str();
+        std::span<const uint8_t> region{(const uint8_t*)bin.data(),bin.size()};
+        assert(Archive::from_binary(region,ArchiveRaw::verify_t::EAGER).has_value());
+        assert(Archive::from_binary(region,ArchiveRaw::verify_t::EAGER,&executor).has_value());
+
+        auto& header = *(const binary_header_t*)bin.data();
+        auto& type = bin[header.start_data()+header.sections[42].base];
+        type = (type&0xf0)|(uint8_t)type_t::ATTR;
+        assert(Archive::from_binary(region).has_value());
+        assert(Archive::from_binary(region,ArchiveRaw::verify_t::EAGER,&executor).error().code==ArchiveRaw::from_binary_error_t::TreeOutOfBounds);
+        auto lazy = Archive::from_binary(region,ArchiveRaw::verify_t::LAZY);
+        assert(lazy.has_value());
+        for(size_t i=0;i<lazy->items();i++)assert(lazy->get(i).has_value()==(i!=42));
+        assert(!lazy->get("doc-42").has_value() && lazy->get("doc-43").has_value());
+
+        //Parallel queries skip the corrupted document, and report the others as usual.
+        std::vector<size_t> docs, expected_docs;
+        for(auto [doc,node] : expected){
+            if(doc!=42)expected_docs.push_back(doc);
+        }
+        assert(query::is(*lazy,query,executor,+[](size_t doc, wrp::base_t<unknown_t>, void* ctx){
+            ((std::vector<size_t>*)ctx)->push_back(doc);
+            return true;
+        },&docs));
+        assert(docs==expected_docs);
+
+        //Sections outside of the region are always rejected.
+        std::string truncated = bin.substr(0,header.start_data()+header.sections[499].base);
+        assert(!Archive::from_binary(std::span<const uint8_t>{(const uint8_t*)truncated.data(),truncated.size()}).has_value());
+    }
+
+    //Checksums of each section, checked without loading.
+    {
+        std::stringstream out;
+        assert(archive.save_binary(out,{},true));
+        std::string bin = out.str();
+        std::span<const uint8_t> region{(const uint8_t*)bin.data(),bin.size()};
+        assert(verify_checksums(region).has_value() && verify_checksums(region,&executor).has_value());
+        assert(Archive::from_binary(region,ArchiveRaw::verify_t::EAGER).has_value());
+
+        std::stringstream plain;
+        assert(archive.save_binary(plain));
+        std::string plain_bin = plain.str();
+        assert(verify_checksums({(const uint8_t*)plain_bin.data(),plain_bin.size()}).error().code==checksum_error_t::Missing);
+
+        auto& header = *(const binary_header_t*)bin.data();
+        bin[header.start_data()+header.sections[42].base+header.sections[42].length-1]^=0x10;
+        assert(verify_checksum(region,41).has_value());
+        assert(verify_checksum(region,42).error().code==checksum_error_t::Document);
+        for(auto result : {verify_checksums(region),verify_checksums(region,&executor)}){
+            assert(result.error().code==checksum_error_t::Document && result.error().doc==42);
+        }
+        bin[header.size()+1]^=0x01;
+        assert(verify_checksums(region,&executor).error().code==checksum_error_t::Symbols);
+        assert(verify_checksum(region,43).has_value());
+    }
+
+    //Archives and documents mapped read-only from files.
+    {
+        auto path = std::filesystem::temp_directory_path()/"vs-xml-archive-mapped.bin";
+        {
+            std::ofstream out(path,std::ios::binary);
+            assert(archive.save_binary(out));
+        }
+        auto mapped = MappedArchive::open(path);
+        assert(mapped.has_value() && mapped->items()==500);
+        auto moved = std::move(*mapped);
+        auto region = moved.region();
+        for(size_t i : {0,137,499,137}){
+            auto doc = moved.get("doc-"+std::to_string(i));
+            std::stringstream printed, expected;
+            assert(doc.has_value() && doc->print(printed) && archive.get(i)->print(expected));
+            assert(printed.str()==expected.str());
+            auto root = (const uint8_t*)&doc->downgrade().root();
+            assert(root>=region.data() && root<region.data()+region.size());
+        }
+        moved.prefetch(42);
+        assert(!moved.get(500).has_value());
+
+        {
+            std::ofstream out(path,std::ios::binary);
+            assert(archive.get(3)->save_binary(out));
+        }
+        auto doc = MappedDocument::open(path,access_t::RANDOM);
+        assert(doc.has_value() && (const uint8_t*)&doc->document().downgrade().root()>=doc->region().data());
+        std::stringstream printed, expected;
+        assert(doc->document().print(printed) && archive.get(3)->print(expected));
+        assert(printed.str()==expected.str());
+
+        {
+            std::ofstream out(path,std::ios::binary);
+            out.write("$XML",4);
+        }
+        assert(MappedDocument::open(path).error().code==mapped_error_t::Binary);
+        std::filesystem::remove(path);
+        assert(MappedArchive::open(path).error().code==mapped_error_t::OpenFailed);
+    }
+
+    //Archives published in shared memory and attached without copies.
+    {
+        auto name = "vs-xml-test-"+std::to_string(getpid());
+        assert(publish_archive(name,archive).has_value());
+        assert(publish_archive(name,archive).error().code==mapped_error_t::CreateFailed);
+        auto attached = attach_archive(name);
+        assert(attached.has_value() && attached->items()==500);
+        auto region = attached->region();
+        for(size_t i : {0,250,499}){
+            auto doc = attached->get(i);
+            std::stringstream printed, expected;
+            assert(doc.has_value() && doc->print(printed) && archive.get(i)->print(expected));
+            assert(printed.str()==expected.str());
+            auto root = (const uint8_t*)&doc->downgrade().root();
+            assert(root>=region.data() && root<region.data()+region.size());
+        }
+        //Attached archives stay valid once the name is gone.
+        assert(unpublish_archive(name));
+        assert(!unpublish_archive(name));
+        assert(attach_archive(name).error().code==mapped_error_t::OpenFailed);
+        assert(attached->get(42).has_value());
+
+        std::vector<uint8_t> bin(region.begin(),region.end());
+        assert(publish_binary(name+"-copy",bin).has_value());
+        auto copy = attach_archive("/"+name+"-copy");
+        assert(copy.has_value() && copy->items()==500 && std::ranges::equal(copy->region(),bin));
+        assert(unpublish_archive(name+"-copy"));
+        bin[0]='#';
+        assert(publish_binary(name+"-bad",bin).error().code==mapped_error_t::Binary);
+        assert(attach_archive(name+"-bad").error().code==mapped_error_t::OpenFailed);
+
+        auto fd = publish_archive_fd(archive);
+        assert(fd.has_value());
+        auto sealed = attach_archive(*fd);
+        assert(sealed.has_value() && sealed->items()==500 && std::ranges::equal(sealed->region(),region));
+        assert(::write(*fd,"x",1)<0);
+        ::close(*fd);
+        assert(sealed->get("doc-7").has_value());
+    }
+
+    //With repeated names the first document is found.
+    {
+        ArchiveBuilder<{.symbols=builder_config_t::COMPRESS_ALL}> bld;
+        for(auto name : {"b","a","b","c","a"}){
+            assert(bld.document(name,[](auto& bld){bld.begin("root");bld.end();})==details::BuilderBase::error_t::OK);
+        }
+        auto dups = *bld.close();
+        assert(dups.downgrade().find("a")==1);
+        assert(dups.downgrade().find("b")==0);
+        assert(dups.downgrade().find("c")==3);
+    }
+
+    //Parallel builders produce the same documents, with a merged table of symbols.
+    {
+        auto merged = mk_parallel_archive<{.symbols=builder_config_t::COMPRESS_ALL}>(500,7,&executor);
+        auto owned = mk_parallel_archive<{.symbols=builder_config_t::OWNED}>(500,3,nullptr);
+        assert(merged.items()==500 && owned.items()==500);
+        for(size_t i=0;i<500;i++)assert(merged.get(i)->downgrade().verify().has_value());
+        for(size_t i=0;i<500;i++){
+            auto ref = print(archive,i);
+            assert(print(merged,i)==ref);
+            assert(print(owned,i)==ref);
+        }
+        assert(merged.downgrade().find("doc-321")==321);
+        assert(owned.downgrade().find("doc-321")==321);
+
+        std::stringstream a, b;
+        assert(archive.save_binary(a) && merged.save_binary(b));
+        assert(b.str().size()==a.str().size());
+
+        auto single = mk_parallel_archive<{.symbols=builder_config_t::COMPRESS_ALL}>(10,1,nullptr);
+        auto empty = mk_parallel_archive<{.symbols=builder_config_t::COMPRESS_ALL}>(0,4,&executor);
+        assert(single.items()==10 && empty.items()==0);
+
+        //Failed documents are dropped without affecting the next ones.
+        ParallelArchiveBuilder<{.symbols=builder_config_t::COMPRESS_ALL}> bld(2);
+        assert(bld.try_document(0,"bad",[](auto& bld){bld.begin("open");bld.text("partial");return false;})==details::BuilderBase::error_t::SKIP);
+        assert(bld.document(0,"unbalanced",[](auto& bld){bld.begin("a");bld.begin("b");})!=details::BuilderBase::error_t::OK);
+        assert(bld.try_document(1,"good",[](auto& bld){bld.begin("root");bld.text("x");bld.end();return true;})==details::BuilderBase::error_t::OK);
+        assert(bld.document(0,"after",[](auto& bld){bld.begin("root");bld.end();})==details::BuilderBase::error_t::OK);
+        auto mixed = *bld.close();
+        assert(mixed.items()==2);
+        assert(mixed.downgrade().find("after")==0 && mixed.downgrade().find("good")==1 && !mixed.downgrade().find("bad").has_value());
+        assert(print(mixed,1).find("<root>x</root>")!=std::string::npos);
+
+        //More documents than an archive can index are rejected, instead of truncating its header.
+        ParallelArchiveBuilder<{.symbols=builder_config_t::COMPRESS_ALL}> many(2);
+        for(size_t i=0;i<=UINT16_MAX;i++){
+            assert(many.document(i%2,"d",[](auto& bld){bld.begin("r");bld.end();})==details::BuilderBase::error_t::OK);
+        }
+        assert(many.close().error()==details::BuilderBase::error_t::TOO_LARGE);
+    }
+
+    //Segmented archives, grown by appending to a file.
+    {
+        auto path = std::filesystem::temp_directory_path()/"vs-xml-archive-segments.bin";
+        int fd = open(path.c_str(),O_WRONLY|O_CREAT|O_TRUNC|O_APPEND,0644);
+        assert(fd>=0);
+        auto read_all = [&](){
+            std::ifstream in(path,std::ios::binary);
+            return std::string(std::istreambuf_iterator<char>(in),{});
+        };
+        auto load = [](const std::string& bin){return SegmentedArchive::from_binary({(const uint8_t*)bin.data(),bin.size()});};
+
+        auto empty = load("");
+        assert(empty.has_value() && empty->items()==0 && !empty->get(0).has_value());
+
+        assert(SegmentedArchive::append(fd,archive));
+        std::string first = read_all();
+        assert(first.size()%16==0);
+
+        auto second_part = mk_archive(20);
+        assert(SegmentedArchive::append(fd,second_part));
+        close(fd);
+        std::string both = read_all();
+        assert(both.starts_with(first));
+
+        //Older snapshots stay valid.
+        auto old = load(first);
+        assert(old.has_value() && old->segments()==1 && old->items()==500);
+
+        auto all = load(both);
+        assert(all.has_value() && all->segments()==2 && all->items()==520);
+        assert((all->locate(505)==std::pair<size_t,size_t>{1,5}));
+        assert(!all->locate(520).has_value());
+        assert(all->find("doc-7")==7);
+        assert(all->find("doc-499")==499);
+        assert(!all->find("doc-500").has_value());
+        assert(all->get(505).has_value() && &all->get(505)->root()==&all->segment(1).get(5)->root());
+
+        //Streams in append mode work the same way.
+        std::stringstream out;
+        assert(SegmentedArchive::append(out,archive));
+        assert(out.str()==first);
+
+        assert(!load(both.substr(0,both.size()-16)).has_value());
+        assert(!load(both.substr(0,both.size()-1)).has_value());
+        std::filesystem::remove(path);
+    }
+
+    return 0;
+}
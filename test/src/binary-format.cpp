@@ -3,9 +3,483 @@
  * @author karurochari
  * @brief test to verify binary to memory, and memory to binary is correct.
  * @date 2025-05-31
- * 
+ *
  * @copyright Copyright (c) 2025
- * 
+ *
  */
 
- int main(){}
\ No newline at end of file
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <vs-xml/arena.hpp>
+#include <vs-xml/attr-index.hpp>
+#include <vs-xml/binary-convert.hpp>
+#include <vs-xml/document-builder.hpp>
+#include <vs-xml/checksum.hpp>
+#include <vs-xml/executor.hpp>
+#include <vs-xml/name-index.hpp>
+#include <vs-xml/query-builder.hpp>
+#include <vs-xml/subtree-stats.hpp>
+#include <vs-xml/topology.hpp>
+#include <vs-xml/tree-builder.hpp>
+
+static bool collect(const xml::unknown_t* node, void* ctx){
+    ((std::vector<const xml::unknown_t*>*)ctx)->push_back(node);
+    return true;
+}
+
+//The tree shared by most of the tests below.
+static void fill(auto& bld){
+    bld.begin("root");
+    for(size_t i=0;i<50;i++){
+        bld.x("group",{},[&]{
+            bld.x("item",{{"idx",std::to_string(i)},{"kind",i%2?"odd":"even"}});
+            bld.x("a","item",{});
+            bld.x("other",{},[&]{
+                bld.x("item",{});
+            });
+        });
+    }
+    bld.end();
+}
+
+static std::string save(const auto& tree, std::span<const xml::binary_extension_t> extensions = {}, bool checksums = false){
+    std::stringstream out;
+    assert(tree.save_binary(out,extensions,checksums));
+    return out.str();
+}
+
+static std::span<const uint8_t> as_span(const std::string& bytes){
+    return {(const uint8_t*)bytes.data(),bytes.size()};
+}
+
+//All nodes in document order.
+static std::vector<const xml::unknown_t*> preorder(const xml::TreeRaw& tree){
+    std::vector<const xml::unknown_t*> nodes;
+    for(auto current = &tree.root(); current<tree.root().next();){
+        nodes.push_back(current);
+        current = current->type()==xml::type_t::ELEMENT?current->children_range()->first:current->next();
+    }
+    return nodes;
+}
+
+int main(){
+    using namespace xml::query;
+
+    xml::TreeBuilder<{.symbols=xml::builder_config_t::COMPRESS_ALL}> build;
+    fill(build);
+    auto tree = *build.close();
+
+    //Roundtrip with the indices as side sections.
+    auto index = xml::NameIndex::build(tree.downgrade());
+    assert(index.labels().size()==5);
+    xml::AttrIndex::selector_t selected[] = {{{},"idx"}};
+    auto attrs = xml::AttrIndex::build(tree.downgrade(),selected);
+    assert(attrs.labels().size()==1 && attrs.values().size()==50);
+    xml::binary_extension_t extensions[] = {index.extension(),attrs.extension()};
+    std::string bytes = save(tree,extensions);
+    auto region = as_span(bytes);
+
+    auto loaded = xml::TreeRaw::from_binary(region);
+    assert(loaded.has_value());
+    auto names = xml::NameIndex::from_binary(region);
+    assert(names.has_value());
+    assert(names->bytes().size()==index.bytes().size());
+    assert(!xml::NameIndex::from_binary(region,1).has_value());
+
+    auto [a,b] = names->find(*loaded,"item");
+    assert(b-a==2);
+    assert(names->find(*loaded,"a","item").has_value());
+    {
+        //Postings out of order are rejected, as lookups bisect on them.
+        std::string copy = bytes;
+        auto postings = (uint8_t*)copy.data()+(names->postings().data-(const uint8_t*)bytes.data());
+        size_t width = names->header().width, first = names->labels()[a].first;
+        std::memcpy(postings+width*(first+1),postings+width*first,width);
+        assert(xml::NameIndex::from_binary(as_span(copy)).error()==xml::NameIndex::from_binary_error_t::OutOfBounds);
+
+        //Counts whose size wraps around to the real one, and symbols before the table.
+        copy = bytes;
+        auto header = (xml::NameIndex::header_t*)(copy.data()+((const uint8_t*)&names->header()-(const uint8_t*)bytes.data()));
+        header->postings+=(uint64_t)1<<(header->width==4?62:61);
+        assert(xml::NameIndex::from_binary(as_span(copy)).error()==xml::NameIndex::from_binary_error_t::TruncatedSpan);
+        copy = bytes;
+        auto& label = ((xml::NameIndex::label_t*)(header+1))[a];
+        label.name_base = -(int64_t)label.name_length;
+        assert(xml::NameIndex::from_binary(as_span(copy)).error()==xml::NameIndex::from_binary_error_t::OutOfBounds);
+    }
+
+    size_t count = 0;
+    names->descendants(*loaded,&loaded->root(),"item",{},[&](const xml::unknown_t* node){
+        assert(loaded->rsv(*node->name())=="item");
+        count++;
+        return true;
+    });
+    assert(count==150);
+
+    //Plans using the index return the same nodes, in the same order.
+    for(auto ns : {std::optional<std::string_view>{},std::optional<std::string_view>{""}}){
+        QueryBuilder bld;
+        bld.begin_frame("items",QueryBuilder::IS);
+        bld.any();
+            if(ns.has_value())bld.match_ns({*ns});
+            bld.match_name({"other"});
+            bld.any();
+                bld.match_name({"item"});
+            bld.end();
+        bld.end();
+        bld.end_frame();
+        auto query = *bld.close();
+
+        auto plain = compile(query,*loaded);
+        auto indexed = compile(query,*loaded,{.names=&*names});
+        assert(plain.cells[1].source==plan_t::SCAN);
+        assert(indexed.cells[1].source==plan_t::NAMES);
+
+        std::vector<const xml::unknown_t*> reference, results;
+        run(query,*loaded,nullptr,collect,&reference);
+        run(indexed,*loaded,nullptr,collect,&results);
+        assert(reference.size()==50);
+        assert(reference==results);
+    }
+
+    //Attribute lookups.
+    auto values = xml::AttrIndex::from_binary(region);
+    assert(values.has_value());
+    assert(values->covers(*loaded,{},"idx") && values->covers(*loaded,"","idx"));
+    assert(!values->covers(*loaded,{},"kind"));
+    assert(values->header().flags==0 && values->labels()[0].flags==xml::AttrIndex::ALL_NS);
+    assert(xml::AttrIndex::build(tree.downgrade()).header().flags==xml::AttrIndex::COMPLETE);
+    {
+        //As for names, wrapping counts and values before the symbols are rejected.
+        std::string copy = bytes;
+        auto header = (xml::AttrIndex::header_t*)(copy.data()+((const uint8_t*)&values->header()-(const uint8_t*)bytes.data()));
+        header->values+=(uint64_t)1<<61;
+        assert(xml::AttrIndex::from_binary(as_span(copy)).error()==xml::AttrIndex::from_binary_error_t::TruncatedSpan);
+        copy = bytes;
+        auto& value = ((xml::AttrIndex::value_t*)((xml::AttrIndex::label_t*)(header+1)+header->labels))[0];
+        value.base = -(int64_t)value.length;
+        assert(xml::AttrIndex::from_binary(as_span(copy)).error()==xml::AttrIndex::from_binary_error_t::OutOfBounds);
+    }
+    count = 0;
+    values->descendants(*loaded,&loaded->root(),"idx",{},"17",[&](const xml::unknown_t* node){
+        assert(loaded->rsv(*node->attrs().begin()->value())=="17");
+        count++;
+        return true;
+    });
+    assert(count==1);
+
+    for(auto [name,value,expected,source] : {
+        std::tuple{"idx","17",1,plan_t::ATTRS},
+        std::tuple{"idx","170",0,plan_t::ATTRS},
+        std::tuple{"kind","odd",25,plan_t::NAMES},
+    }){
+        QueryBuilder bld;
+        bld.begin_frame("items",QueryBuilder::IS);
+        bld.any();
+            bld.match_name({"item"});
+            bld.match_attr({name,value});
+        bld.end();
+        bld.end_frame();
+        auto query = *bld.close();
+
+        auto indexed = compile(query,*loaded,{.names=&*names,.attrs=&*values});
+        assert(indexed.cells[1].source==source);
+
+        std::vector<const xml::unknown_t*> reference, results;
+        run(query,*loaded,nullptr,collect,&reference);
+        run(indexed,*loaded,nullptr,collect,&results);
+        assert(reference.size()==(size_t)expected);
+        assert(reference==results);
+    }
+
+    //Subtree summaries, small enough to have one for each group.
+    {
+        auto stats = xml::SubtreeStats::build(tree.downgrade(),64);
+        auto root = stats.find(tree.downgrade(),&tree.downgrade().root());
+        assert(root.has_value());
+        assert(root->depth()==3);
+        assert(root->nodes()==50*5);
+        assert(root->may_contain(xml::SubtreeStats::key("other")));
+        assert(root->may_contain(xml::SubtreeStats::key("a","item")));
+        assert(!root->may_contain(xml::SubtreeStats::key("missing")));
+
+        xml::binary_extension_t extensions[] = {stats.extension()};
+        std::string bytes = save(tree,extensions);
+        auto region = as_span(bytes);
+        auto loaded = xml::TreeRaw::from_binary(region);
+        auto summaries = xml::SubtreeStats::from_binary(region);
+        assert(summaries.has_value() && summaries->size()==stats.size());
+        {
+            //Entries out of order are rejected, as lookups bisect on them.
+            std::string copy = bytes;
+            auto entry = (uint8_t*)copy.data()+((const uint8_t*)summaries->at(1).entry-(const uint8_t*)bytes.data());
+            std::memcpy(entry,summaries->at(0).entry,sizeof(uint64_t));
+            assert(xml::SubtreeStats::from_binary(as_span(copy)).error()==xml::SubtreeStats::from_binary_error_t::OutOfBounds);
+
+            //A count whose size wraps around to the real one.
+            copy = bytes;
+            auto header = (xml::SubtreeStats::header_t*)(copy.data()+((const uint8_t*)&summaries->header()-(const uint8_t*)bytes.data()));
+            header->entries+=(uint64_t)1<<63;
+            assert(xml::SubtreeStats::from_binary(as_span(copy)).error()==xml::SubtreeStats::from_binary_error_t::TruncatedSpan);
+        }
+
+        for(auto [name,depth,expected] : {std::tuple{"other",0,50},std::tuple{"missing",0,0},std::tuple{"item",1,50}}){
+            QueryBuilder bld;
+            bld.begin_frame("items",QueryBuilder::IS);
+            bld.any();
+                bld.match_name({"group"});
+                for(int i=0;i<depth;i++)bld.begin();
+                bld.any();
+                    bld.match_name({name});
+                bld.end();
+                for(int i=0;i<depth;i++)bld.end();
+            bld.end();
+            bld.end_frame();
+            auto query = *bld.close();
+
+            auto plan = compile(query,*loaded,{.stats=&*summaries});
+            assert(plan.cells[1].dead || plan.cells[1].min_depth==(uint32_t)depth+1);
+
+            std::vector<const xml::unknown_t*> reference, results;
+            run(query,*loaded,nullptr,collect,&reference);
+            run(plan,*loaded,nullptr,collect,&results);
+            assert(reference.size()==(size_t)expected);
+            assert(reference==results);
+        }
+    }
+
+    //Pre-order positions, checked against the pointer structure of the tree.
+    {
+        auto topology = xml::Topology::build(tree.downgrade());
+        xml::binary_extension_t extensions[] = {topology.extension()};
+        std::string bytes = save(tree,extensions);
+        auto region = as_span(bytes);
+        auto loaded = xml::TreeRaw::from_binary(region);
+        auto topo = xml::Topology::from_binary(region);
+        assert(loaded.has_value() && topo.has_value());
+        assert(topo->size()==1+50*5 && topo->header().max_depth==3);
+
+        auto nodes = preorder(*loaded);
+        assert(nodes.size()==topo->size());
+        for(size_t i=0;i<nodes.size();i++){
+            assert(topo->id(*loaded,nodes[i])==i && topo->node(*loaded,i)==nodes[i]);
+            uint32_t depth = 0;
+            for(auto p = nodes[i]->parent(); p!=nullptr; p=p->parent())depth++;
+            assert(topo->depth(i)==depth);
+            assert(topo->ancestor(*loaded,nodes[i],depth)==nodes[i]);
+            assert(topo->ancestor(*loaded,nodes[i],depth+1)==nullptr);
+            if(depth>0)assert(topo->ancestor(*loaded,nodes[i],depth-1)==(const xml::unknown_t*)nodes[i]->parent());
+            assert(topo->ancestor(i,0)==0);
+        }
+        for(size_t i=0;i<nodes.size();i+=7){
+            for(size_t j=0;j<nodes.size();j+=3){
+                bool expected = nodes[i]<nodes[j] && nodes[j]<nodes[i]->next();
+                assert(topo->is_ancestor(i,j)==expected);
+            }
+        }
+        auto misaligned = (const xml::unknown_t*)((const uint8_t*)nodes[1]+1);
+        assert(topo->id(*loaded,misaligned)==xml::Topology::npos);
+        assert(!topo->depth(*loaded,misaligned).has_value() && topo->depth(*loaded,nodes[5])==topo->depth(5));
+        assert(!topo->is_ancestor(*loaded,nodes[0],misaligned) && !topo->is_ancestor(*loaded,misaligned,nodes[5]));
+        assert(topo->ancestor(*loaded,misaligned,0)==nullptr && topo->ancestor(topo->size(),0)==xml::Topology::npos);
+
+        //Levels not matching the depths are rejected, as level ancestors rely on them.
+        std::string copy = bytes;
+        auto depths = (uint8_t*)copy.data()+((const uint8_t*)topo->bytes().data()-(const uint8_t*)bytes.data())+topo->bytes().size()-topo->header().width*topo->size()-topo->header().depth_width*topo->size();
+        depths[topo->header().depth_width*2]^=1;
+        assert(xml::Topology::from_binary(as_span(copy)).error()==xml::Topology::from_binary_error_t::OutOfBounds);
+    }
+
+    //Verification of untrusted content.
+    {
+        xml::Executor executor(3);
+        std::string copy = bytes;
+        std::span<uint8_t> region((uint8_t*)copy.data(),copy.size());
+        auto loaded = xml::TreeRaw::from_binary(region);
+        assert(loaded.has_value());
+        assert(loaded->verify().has_value() && loaded->verify(&executor).has_value());
+
+        std::span<uint8_t> buffer((uint8_t*)&loaded->root(),(uint8_t*)loaded->root().next());
+        auto& header = *(const xml::binary_header_t*)copy.data();
+        std::span<uint8_t> symbols((uint8_t*)copy.data()+header.size(),header.length_of_symbols);
+
+        auto truncated = xml::TreeRaw(loaded->config(),buffer.first(buffer.size()-1),symbols);
+        assert(truncated.verify().error().code==xml::TreeRaw::from_binary_error_t::TreeOutOfBounds);
+        auto few_symbols = xml::TreeRaw(loaded->config(),buffer,symbols.first(symbols.size()-1));
+        assert(few_symbols.verify(&executor).error().code==xml::TreeRaw::from_binary_error_t::SymbolsOutOfBounds);
+
+        //A node deep in the tree with an invalid type is found by all tasks.
+        auto nodes = preorder(*loaded);
+        auto& type = *(uint8_t*)nodes[nodes.size()-2];
+        uint8_t original = type;
+        type = (type&0xf0)|(uint8_t)xml::type_t::ATTR;
+        assert(!loaded->verify().has_value() && !loaded->verify(&executor).has_value());
+        type = original;
+        assert(loaded->verify(&executor).has_value());
+
+        //Elements flagged as having a sibling must have one, as visitors step to it. The flag is the bit after the type.
+        for(auto node : {nodes[1],nodes[nodes.size()-2]}){
+            assert(node->type()==xml::type_t::ELEMENT);
+            auto& flags = *(uint8_t*)node;
+            flags^=0x10;
+            assert(!loaded->verify().has_value() && !loaded->verify(&executor).has_value());
+            flags^=0x10;
+        }
+        assert(loaded->verify(&executor).has_value());
+    }
+
+    //Checksums, with and without hardware support giving the same values.
+    {
+        std::string_view check = "123456789";
+        std::span<const uint8_t> check_span((const uint8_t*)check.data(),check.size());
+        assert(xml::crc32c(check_span)==0xE3069283);
+        assert(xml::crc32c(check_span.subspan(4),xml::crc32c(check_span.first(4)))==0xE3069283);
+        assert(xml::crc32c({})==0);
+
+        std::string copy = save(tree,{},true);
+        auto region = as_span(copy);
+        xml::Executor executor(2);
+        assert(xml::verify_checksums(region).has_value() && xml::verify_checksums(region,&executor).has_value());
+        assert(xml::verify_checksum(region,0).has_value() && !xml::verify_checksum(region,1).has_value());
+        assert(xml::TreeRaw::from_binary(region).has_value());
+        assert(xml::verify_checksums(as_span(bytes)).error().code==xml::checksum_error_t::Missing);
+
+        auto& header = *(const xml::binary_header_t*)copy.data();
+        size_t at = header.start_data()+header.sections[0].length/2;
+        copy[at]^=0x40;
+        assert(xml::verify_checksums(region).error().code==xml::checksum_error_t::Document);
+        copy[at]^=0x40;
+        copy[5]^=0x01;
+        assert(xml::verify_checksums(region,&executor).error().code==xml::checksum_error_t::Header);
+    }
+
+    //Trees built in a sparse arena are the same as those built in vectors.
+    {
+        xml::TreeBuilder<{.symbols=xml::builder_config_t::COMPRESS_ALL}> sparse;
+        sparse.reserve({1<<20,0,0,true});
+        fill(sparse);
+        //Content written before discarding is cleared when growing again.
+        sparse.discard_frame();
+        fill(sparse);
+        assert(save(*sparse.close(),extensions)==bytes);
+
+        //Nodes added before switching to the arena are moved into it.
+        xml::DocumentBuilder<{.symbols=xml::builder_config_t::COMPRESS_ALL}> doc, sparse_doc;
+        sparse_doc.reserve({0,0,0,true});
+        for(auto bld : {&doc,&sparse_doc}){
+            bld->xml();
+            fill(*bld);
+        }
+        std::stringstream printed, sparse_printed;
+        assert(doc.close()->print(printed) && sparse_doc.close()->print(sparse_printed));
+        assert(printed.str()==sparse_printed.str());
+
+        xml::SparseArena arena(1<<20);
+        arena.resize(100);
+        auto base = arena.data();
+        arena.resize(arena.capacity());
+        assert(arena.data()==base && arena.committed()==arena.capacity() && arena.data()[arena.size()-1]==0);
+        std::fill(arena.begin(),arena.end(),0xff);
+        arena.resize(10);
+        arena.release();
+        assert(arena.committed()<arena.capacity());
+        arena.resize(5000);
+        assert(arena.data()==base && arena.data()[9]==0xff && arena.data()[10]==0 && arena.data()[4999]==0);
+        auto copy = arena;
+        assert(copy.size()==5000 && copy.data()!=base && copy.data()[9]==0xff);
+        bool thrown = false;
+        try{arena.resize(arena.capacity()+1);}catch(const std::bad_alloc&){thrown = true;}
+        assert(thrown && arena.size()==5000);
+    }
+
+    //Conversion between layouts and byte orders.
+    {
+        xml::TreeBuilder<{.symbols=xml::builder_config_t::COMPRESS_ALL}> mixed;
+        mixed.begin("root");
+        for(size_t i=0;i<20;i++){
+            mixed.x("ns","entry",{{"idx",std::to_string(i)}},[&]{
+                mixed.text("value "+std::to_string(i));
+                if(i%3==0)mixed.comment("note");
+                if(i%5==0)mixed.cdata("<raw>");
+                mixed.x("leaf",{});
+            });
+        }
+        mixed.end();
+        auto source = *mixed.close();
+        std::stringstream stream, printed;
+        assert(source.print(printed));
+        std::string bytes = save(source);
+        auto region = as_span(bytes);
+        assert(xml::binary_layout(region)==xml::binary_layout_t::native());
+
+        auto convert = [](std::span<const uint8_t> region, xml::binary_layout_t target){
+            std::stringstream out;
+            auto written = xml::convert_binary(region,out,target);
+            assert(written.has_value());
+            std::string ret = out.str();
+            assert(ret.size()==*written);
+            return ret;
+        };
+
+        assert(convert(region,xml::binary_layout_t::native())==bytes);
+        for(uint8_t layout : {0,1}){
+            for(auto endianess : {xml::binary_header_t::endianess_t::LITTLE,xml::binary_header_t::endianess_t::BIG}){
+                xml::binary_layout_t target{layout,endianess};
+                auto converted = convert(region,target);
+                assert(xml::binary_layout(as_span(converted))==target);
+                if(target!=xml::binary_layout_t::native())
+                    assert(!xml::TreeRaw::from_binary(as_span(converted)).has_value());
+
+                auto back = convert(as_span(converted),xml::binary_layout_t::native());
+                auto loaded = xml::TreeRaw::from_binary(as_span(back));
+                assert(loaded.has_value() && loaded->verify().has_value());
+                std::stringstream reprinted;
+                assert(loaded->print(reprinted) && reprinted.str()==printed.str());
+                //Byte order alone is lossless, while empty strings might lose their base in smaller layouts.
+                if(layout==VS_XML_LAYOUT)assert(back==bytes);
+            }
+        }
+
+        //Extensions depending on the layout are dropped.
+        {
+            auto index = xml::NameIndex::build(source.downgrade());
+            xml::binary_extension_t extensions[] = {index.extension()};
+            std::string with_index = save(source,extensions);
+            assert(xml::NameIndex::from_binary(as_span(with_index)).has_value());
+            auto converted = convert(as_span(with_index),xml::binary_layout_t::native());
+            assert(converted==bytes && !xml::NameIndex::from_binary(as_span(converted)).has_value());
+        }
+
+        //Values not fitting the smaller layout.
+        {
+            xml::TreeBuilder<{.symbols=xml::builder_config_t::COMPRESS_ALL}> large;
+            large.begin("root");
+            large.text(std::string(70000,'x'));
+            large.end();
+            std::stringstream out;
+            std::string large_bytes = save(*large.close());
+            assert(xml::convert_binary(as_span(large_bytes),out,{1}).error().code==xml::convert_error_t::Overflow);
+        }
+
+        //Subtrees larger than the output window are patched by seeking back.
+        {
+            xml::TreeBuilder<{.symbols=xml::builder_config_t::COMPRESS_ALL}> large;
+            large.begin("root");
+            for(size_t i=0;i<20000;i++)large.x("item",{{"idx",std::to_string(i%100)}});
+            large.end();
+            std::string large_bytes = save(*large.close());
+            assert(large_bytes.size()>(2<<20));
+            auto swapped = convert(as_span(large_bytes),{VS_XML_LAYOUT,xml::binary_header_t::endianess_t::BIG});
+            assert(convert(as_span(swapped),xml::binary_layout_t::native())==large_bytes);
+        }
+
+        assert(xml::convert_binary(region.first(10),stream).error().code==xml::convert_error_t::HeaderTooSmall);
+        assert(xml::convert_binary(region.first(region.size()-16),stream).error().code==xml::convert_error_t::TreeOutOfBounds);
+    }
+
+    return 0;
+}
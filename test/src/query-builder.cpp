@@ -1,9 +1,250 @@
+#include <tuple>
+#include <vector>
+
+#include <vs-xml/node-set.hpp>
 #include <vs-xml/query-builder.hpp>
+#include <vs-xml/query-cache.hpp>
+#include <vs-xml/tree-builder.hpp>
+#include <vs-xml/xpath.hpp>
+
+template<xml::builder_config_t cfg>
+auto mk_tree(){
+    xml::TreeBuilder<cfg> build;
+    build.begin("root");
+        build.x("node-a",{{"attr0","val0"},{"attr1","val1"}});
+        build.x("node-b",{{"attr0","val0"},{"attr1","val1"}});
+        build.x("node-a",{{"attr0","val0"},{"attr1","val1"}},[&]{
+            build.x("node-a",{{"attr0","val0"},{"attr1","val2"}});
+            build.x("node-c",{},[&]{
+                build.text("hello ");
+                build.cdata("world");
+            });
+        });
+    build.end();
+
+    return build.close();
+}
+
+static bool collect(const xml::unknown_t* node, void* ctx){
+    ((std::vector<const xml::unknown_t*>*)ctx)->push_back(node);
+    return true;
+}
 
 int main(){
     using namespace xml::query;
 
-    QueryBuilder bld;
+    auto tree = *mk_tree<{.symbols=xml::builder_config_t::OWNED, .raw_strings=true}>();
+
+    //Children of the root named node-a
+    {
+        QueryBuilder bld;
+        assert(bld.begin_frame("children",QueryBuilder::IS)==QueryBuilder::error_t::OK);
+        bld.match_name({"root"});
+        bld.begin();
+            bld.match_type({.is_element=true});
+            bld.match_name({"node-a"});
+        bld.end();
+        assert(bld.end_frame()==QueryBuilder::error_t::OK);
+        auto query = bld.close();
+        assert(query.has_value());
+        assert(query->frames()==1);
+        assert(query->frame("children").has_value());
+
+        std::vector<const xml::unknown_t*> results;
+        run(*query,tree.downgrade(),nullptr,collect,&results);
+        assert(results.size()==2);
+    }
+
+    //Descendants matching attributes, text and serialization roundtrip
+    {
+        QueryBuilder bld;
+        bld.begin_frame("deep",QueryBuilder::IS);
+        bld.any();
+            bld.match_attr({"attr1","val2"});
+        bld.end();
+        bld.end_frame();
+        bld.begin_frame("text",QueryBuilder::IS);
+        bld.any("text-node");
+            bld.match_all_text({"hello world"});
+        bld.end();
+        bld.end_frame();
+        auto query = *bld.close();
+
+        auto copy = Query::from_binary(query.bytes());
+        assert(copy.has_value());
+        assert(*copy==query);
+        assert(copy->hash()==query.hash());
+
+        std::vector<const xml::unknown_t*> results;
+        for(auto [pattern,mode,count] : {
+            std::tuple{"o w",text_mode_t::CONTAINS,1},
+            std::tuple{"hello wo",text_mode_t::PREFIX,1},
+            std::tuple{"world",text_mode_t::PREFIX,0},
+            std::tuple{"",text_mode_t::CONTAINS,5},
+        }){
+            QueryBuilder text;
+            text.begin_frame("text",QueryBuilder::IS);
+            text.any();
+                text.match_type({.is_element=true});
+                text.match_all_text({pattern},mode);
+            text.end();
+            text.end_frame();
+            auto q = *text.close();
+            run(q,tree.downgrade(),nullptr,collect,&results);
+            assert(results.size()==(size_t)count);
+
+            //Counting, existence and pages stop early but agree with the full evaluation.
+            assert(xml::query::count(q,tree.downgrade())==(size_t)count);
+            assert(exists(q,tree.downgrade())==(count!=0));
+            auto page = first_n(q,tree.downgrade(),2,1);
+            assert(page.size()==(size_t)std::clamp(count-1,0,2));
+            assert(std::equal(page.begin(),page.end(),results.begin()+std::min(count,1)));
+            assert(first_n(q,tree.downgrade(),0).size()==0);
+            results.clear();
+        }
+
+        run(*copy,tree.downgrade(),nullptr,collect,&results,0);
+        assert(results.size()==1);
+        run(*copy,tree.downgrade(),nullptr,collect,&results,1);
+        assert(results.size()==2);
+        assert(results[1]->name().has_value());
+    }
+
+    //Plans and their cache
+    {
+        auto compressed = *mk_tree<{.symbols=xml::builder_config_t::COMPRESS_ALL}>();
+
+        QueryBuilder bld;
+        bld.begin_frame("attrs",QueryBuilder::IS);
+        bld.any();
+            bld.match_name({"node-a"});
+            bld.match_attr({"attr1","val2"});
+        bld.end();
+        bld.end_frame();
+        bld.begin_frame("missing",QueryBuilder::IS);
+        bld.any();
+            bld.match_name({"node-z"});
+        bld.end();
+        bld.end_frame();
+        auto query = *bld.close();
+
+        QueryCache cache;
+        auto& plan = cache.get(query,compressed.downgrade());
+        assert(&cache.get(query,compressed.downgrade())==&plan);
+        assert(cache.stats().hits==1 && cache.stats().misses==1);
+        assert(cache.get(query,tree.downgrade()).valid_for(query,tree.downgrade()));
+        assert(cache.size()==2);
+
+        auto a = *query.frame("attrs");
+        assert(plan.cells[a+2].state[0]==xml::query::plan_t::SV);
+        assert(plan.cells[a+2].hits==3);
+        assert(plan.cells[*query.frame("missing")].dead);
+
+        std::vector<const xml::unknown_t*> results;
+        cache.run(query,compressed.downgrade(),nullptr,collect,&results,0);
+        assert(results.size()==1);
+        cache.run(query,compressed.downgrade(),nullptr,collect,&results,1);
+        assert(results.size()==1);
+
+        std::vector<const xml::unknown_t*> reference;
+        run(query,compressed.downgrade(),nullptr,collect,&reference,0);
+        assert(reference==results);
+    }
+
+    //XPath expressions, evaluated both directly and via their plans
+    {
+        for(auto [expr,expected] : {
+            std::tuple{"/root",1},
+            std::tuple{"/other",0},
+            std::tuple{"/root/node-a",2},
+            std::tuple{"node-a",2},
+            std::tuple{"//node-a",3},
+            std::tuple{"//node-a[@attr1='val2']",1},
+            std::tuple{"//node-a[@attr0 and @attr1=\"val1\"]",2},
+            std::tuple{"//node-a[2]",1},
+            std::tuple{"/root/*[2]",1},
+            std::tuple{"/root/node-a[2]/node-c",1},
+            std::tuple{"/root/descendant::node-c",1},
+            std::tuple{"//node-c[text()='hello world']",1},
+            std::tuple{"//*[contains(., 'o w')]",1},
+            std::tuple{"//*[starts-with(text(),'world')]",0},
+            std::tuple{"//node-c/text()",2},
+        }){
+            auto query = xpath(expr);
+            assert(query.has_value());
+            assert(xml::query::count(*query,tree.downgrade())==(size_t)expected);
+            auto plan = compile(*query,tree.downgrade());
+            assert(xml::query::count(plan,tree.downgrade())==(size_t)expected);
+            auto copy = Query::from_binary(query->bytes());
+            assert(copy.has_value() && *copy==*query);
+        }
+
+        for(auto [expr,code] : {
+            std::tuple{"//node-a[",xpath_error_t::UNEXPECTED_END},
+            std::tuple{"//@attr0",xpath_error_t::UNSUPPORTED},
+            std::tuple{"//node-a[0]",xpath_error_t::BAD_POSITION},
+            std::tuple{"//node-a | //node-b",xpath_error_t::UNSUPPORTED},
+            std::tuple{"//node-a[@attr0='val0]",xpath_error_t::BAD_LITERAL},
+            std::tuple{"/root/ancestor::node-a",xpath_error_t::UNSUPPORTED},
+        }){
+            auto query = xpath(expr);
+            assert(!query.has_value() && query.error().code==code);
+        }
+
+        XPathCache cache;
+        auto a = cache.get("//node-a[2]");
+        auto b = cache.get(std::string("//node-a[2]"));
+        assert(a.has_value() && b.has_value() && *a==*b);
+        assert(!cache.get("//node-a[").has_value());
+        assert(cache.size()==1 && cache.stats().hits==1);
+    }
+
+    //Node sets of runs with nested descendant steps, which reach the same nodes more than once and out of order
+    {
+        xml::TreeBuilder<{.symbols=xml::builder_config_t::OWNED}> build;
+        build.begin("root");
+            build.x("a",{},[&]{
+                build.x("b",{},[&]{
+                    build.x("c",{});
+                });
+                build.x("d",{});
+            });
+        build.end();
+        auto deep = *build.close();
+
+        QueryBuilder bld;
+        bld.begin_frame("nested",QueryBuilder::IS);
+        bld.any();
+            bld.any();
+            bld.end();
+        bld.end();
+        bld.end_frame();
+        auto query = *bld.close();
+
+        std::vector<const xml::unknown_t*> results;
+        run(query,deep.downgrade(),nullptr,collect,&results);
+        node_set32_t raw;
+        for(auto node : results)raw.push_back(deep.downgrade(),node);
+        assert(!raw.sorted());
+        raw.sort();
+
+        auto set = node_set32_t::collect(query,deep.downgrade());
+        auto planned = node_set32_t::collect(compile(query,deep.downgrade()),deep.downgrade());
+        assert(set.size()==3 && set==raw && planned==raw);
+        assert((set|planned)==set && (set&planned)==set && (set-planned).empty());
+    }
+
+    //Misplaced operations and lambdas are rejected
+    {
+        QueryBuilder bld;
+        assert(bld.match_name({"root"})==QueryBuilder::error_t::FRAME_CLOSED);
+        bld.begin_frame("a",QueryBuilder::HAS);
+        bld.begin();
+        bld.end();
+        assert(bld.match_name({"root"})==QueryBuilder::error_t::MISFORMED);
+        assert(bld.match_value({[](std::string_view){return true;}})==QueryBuilder::error_t::NOT_SERIALIZABLE);
+        assert(!bld.close().has_value());
+    }
 
     return 0;
-}
\ No newline at end of file
+}
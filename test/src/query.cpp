@@ -1,7 +1,10 @@
 #include <algorithm>
 #include <vs-xml/query.hpp>
+#include <vs-xml/query-static.hpp>
+#include <vs-xml/query-parallel.hpp>
 #include <vs-xml/tree-builder.hpp>
 #include <vs-xml/filters.hpp>
+#include <vs-xml/node-set.hpp>
 
 #include <cstdlib>
 
@@ -198,6 +201,156 @@ int main() {
         assert(std::ranges::distance(container)==4);
     }
 
+    {
+        auto query0 = query_t<0>{}/"**"*match_attr({"attr1","val1"})*match_attr({"attr0","val0"})*accept();
+        auto container = tree.root() & query0;
+        assert(std::ranges::distance(container)==4);
+    }
+
+    {
+        auto query0 = query_t<0>{}/"**"*match_attr({"N1","N3"})*match_attr({"N1","N2"})*match_attr({"attr0"})*accept();
+        auto container = tree.root() & query0;
+        assert(std::ranges::distance(container)==0);
+    }
+
+    {
+        auto query0 = query_t<0>{}/"**"*match_attr({"N1","N3"})*match_attr({"N1","N2"})*accept();
+        auto container = tree.root() & query0;
+        assert(std::ranges::distance(container)==2);
+    }
+
+    {
+        auto query0 = query_t<0>{}/"**"*match_text_contains({"worldo\" & &>"})*accept();
+        assert(std::ranges::distance(tree.root() & query0)==1);
+        auto query1 = query_t<0>{}/"**"*match_text_prefix({"Banana <"})*accept();
+        assert(std::ranges::distance(tree.root() & query1)==1);
+        auto query2 = query_t<0>{}/"**"*match_all_text({"Banana"})*accept();
+        assert(std::ranges::distance(tree.root() & query2)==0);
+        auto query3 = query_t<0>{}/"**"*match_all_text({[](std::string_view t){return t.ends_with("</world>");}})*accept();
+        assert(std::ranges::distance(tree.root() & query3)==1);
+    }
+
+    //Batch of queries in a single traversal, against their separate evaluation
+    {
+        std::vector<query_t<0>> queries{
+            query_t<0>{}/"node-a"*match_attr({"attr0"})*accept(),
+            query_t<0>{}/"**"*match_attr({"attr0","val0"})*accept(),
+            query_t<0>{}/"**"/"BBB"*accept(),
+            query_t<0>{}/"**"/"*"*type({.is_comment=true})*accept(),
+            //Nested descendant steps, with overlapping states reaching the same node.
+            query_t<0>{}/"**"/"**"/"BBB"*accept(),
+            query_t<0>{}/"missing"*accept(),
+        };
+        std::vector<size_t> counts(queries.size(),0);
+        assert(batch(tree.root(),queries,[&](size_t query, auto){counts[query]++;return true;}));
+        for(size_t i=0;i<queries.size();i++){
+            assert(counts[i]==(size_t)std::ranges::distance(tree.root() & queries[i]));
+        }
+        assert(counts[3]==5 && counts[4]==1 && counts[5]==0);
+
+        size_t seen = 0;
+        assert(!batch(tree.root(),queries,[&](size_t, auto){return ++seen<3;}));
+        assert(seen==3);
+    }
+
+    //Queries specialised at compile time, against their runtime evaluation
+    {
+        auto check = [&]<auto F>(){
+            size_t count = 0;
+            specialize<F>.run(tree.root(),[&](auto){count++;return true;});
+            assert(count==(size_t)std::ranges::distance(tree.root() & F()));
+            return count;
+        };
+        assert((check.template operator()<[]{return query_t<8>{}/"node-a"*match_attr({"attr0"})*accept();}>())==2);
+        assert((check.template operator()<[]{return query_t<8>{}/"**"*match_attr({"N1","N3"})*match_attr({"N1","N2"})*accept();}>())==2);
+        assert((check.template operator()<[]{return query_t<8>{}/"**"/"s:hello5"*accept();}>())==1);
+        assert((check.template operator()<[]{return query_t<4>{}/"**"*match_text_contains({"worldo"})*accept();}>())==1);
+        assert((check.template operator()<[]{return query_t<0>{}*"**"*type({.is_element=true})*match_ns({"s"})*accept();}>())==5);
+    }
+
+    //Parallel evaluation within the tree, splitting at any size, against the sequential one
+    {
+        xml::Executor executor(3);
+        std::vector<query_t<0>> queries{
+            query_t<0>{}/"**"*match_attr({"attr0","val0"})*accept(),
+            query_t<0>{}/"**"/"BBB"*accept(),
+            query_t<0>{}*"**"*type({.is_element=true})*match_ns({"s"})*accept(),
+        };
+        for(auto& q : queries){
+            std::vector<const xml::unknown_t*> expected, results;
+            for(auto node : tree.root() & q)expected.push_back((const xml::unknown_t*)node);
+            assert(is(tree.root(),q,executor,+[](xml::wrp::base_t<xml::unknown_t> node, void* ctx){
+                ((std::vector<const xml::unknown_t*>*)ctx)->push_back((const xml::unknown_t*)node);
+                return true;
+            },&results,1));
+            assert(results==expected);
+        }
+    }
+
+    //Counting, existence and pages, against the generators
+    {
+        std::vector<query_t<0>> queries{
+            query_t<0>{}/"**"*match_attr({"attr0","val0"})*accept(),
+            query_t<0>{}*"**"*type({.is_element=true})*match_ns({"s"})*accept(),
+            query_t<0>{}/"missing"*accept(),
+        };
+        for(auto& q : queries){
+            auto all = xml::query::node_set32_t::collect(tree.root() & q);
+            assert(xml::query::count(tree.root(),q)==all.size());
+            assert(exists(tree.root(),q)==(all.size()!=0));
+            assert(std::ranges::distance(tree.root() | q)==(all.size()!=0));
+            auto page = first_n(tree.root(),q,2,1);
+            assert(page.size()==std::min<size_t>(2,all.size()>1?all.size()-1:0));
+            for(size_t i=0;i<page.size();i++)assert((const xml::unknown_t*)page[i]==all.node(tree.downgrade(),i+1));
+        }
+    }
+
+    //Materialized results and set operations, against the standard algorithms
+    {
+        auto a = xml::query::node_set32_t::collect(tree.root() & (query_t<0>{}/"**"*match_attr({"attr0","val0"})*accept()));
+        auto b = xml::query::node_set32_t::collect(tree.root() & (query_t<0>{}*"**"*type({.is_element=true})*match_ns({"s"})*accept()));
+        assert(a.sorted() && b.sorted() && a.size()==4 && b.size()==5);
+
+        auto reference = [](const auto& x, const auto& y, auto op){
+            std::vector<uint32_t> ret;
+            op(x.begin(),x.end(),y.begin(),y.end(),std::back_inserter(ret));
+            return xml::query::node_set32_t(std::move(ret));
+        };
+        auto check = [&](const xml::query::node_set32_t& x, const xml::query::node_set32_t& y){
+            assert((x|y)==reference(x,y,[](auto... args){return std::set_union(args...);}));
+            assert((x&y)==reference(x,y,[](auto... args){return std::set_intersection(args...);}));
+            assert((x-y)==reference(x,y,[](auto... args){return std::set_difference(args...);}));
+        };
+        check(a,b);
+        check(b,a);
+
+        auto both = a|b;
+        size_t i = 0;
+        for(auto node : both.wrap(tree.downgrade())){
+            assert((const xml::unknown_t*)node==both.node(tree.downgrade(),i));
+            i++;
+        }
+        assert(i==both.size());
+
+        //Large and skewed operands, to cover both block and bisection strategies.
+        std::vector<uint32_t> dense, sparse, few;
+        for(uint32_t v=0;v<5000;v++){
+            if(v%3==0 || v%7==0)dense.push_back(v*8);
+            if(v%5==0)sparse.push_back(v*8);
+            if(v%701==0)few.push_back(v*8);
+        }
+        xml::query::node_set32_t x(std::move(dense)), y(std::move(sparse)), z(std::move(few));
+        check(x,y);
+        check(y,x);
+        check(x,z);
+        check(z,x);
+
+        xml::query::node_set32_t unsorted(std::vector<uint32_t>{24,8,16,8});
+        assert(!unsorted.sorted());
+        unsorted.sort();
+        assert(unsorted==xml::query::node_set32_t(std::vector<uint32_t>{8,16,24}));
+    }
+
     //TODO: Add more tests
 
     //auto q = xml::query::query_t{}/xml::query::match_name({"root"})/xml::query::accept()/xml::query::accept()/xml::query::next();
@@ -0,0 +1,70 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <ostream>
+#include <string_view>
+
+#include <vs-xml/commons.hpp>
+#include <vs-xml/binary-convert.hpp>
+
+#include <mio/mmap.hpp>
+
+static std::string_view describe(VS_XML_NS::binary_layout_t layout){
+    bool big = layout.endianess==VS_XML_NS::binary_header_t::endianess_t::BIG;
+    if(layout.layout==0)return big?"layout 0, big-endian":"layout 0, little-endian";
+    return big?"layout 1, big-endian":"layout 1, little-endian";
+}
+
+int main(int argc, const char* argv[]) {
+    if(argc<2){std::cerr<<"Wrong usage, pass an input file to show its layout, or input and output files optionally followed by `--layout 0|1` and `--endian little|big`.\n";return 1;}
+
+    VS_XML_NS::binary_layout_t target = VS_XML_NS::binary_layout_t::native();
+    for(int i=3;i<argc;i++){
+        std::string_view arg = argv[i];
+        if(arg=="--layout" && i+1<argc){
+            std::string_view value = argv[++i];
+            if(value=="0")target.layout=0;
+            else if(value=="1")target.layout=1;
+            else{std::cerr<<"Unknown layout "<<value<<"\n";return 1;}
+        }
+        else if(arg=="--endian" && i+1<argc){
+            std::string_view value = argv[++i];
+            if(value=="little")target.endianess=VS_XML_NS::binary_header_t::endianess_t::LITTLE;
+            else if(value=="big")target.endianess=VS_XML_NS::binary_header_t::endianess_t::BIG;
+            else{std::cerr<<"Unknown byte order "<<value<<"\n";return 1;}
+        }
+        else{std::cerr<<"Unknown option "<<arg<<"\n";return 1;}
+    }
+
+    try{
+        mio::mmap_source mmap(argv[1]);
+        std::span<const uint8_t> region((const uint8_t*)mmap.data(),mmap.size());
+
+        auto layout = VS_XML_NS::binary_layout(region);
+        if(!layout.has_value()){
+            std::cerr << "Error while reading the binary: " << layout.error().msg() << "\n";
+            return 2;
+        }
+        if(argc==2){
+            std::cout << describe(*layout) << "\n";
+            return 0;
+        }
+
+        std::ofstream file(argv[2],std::ios::binary|std::ios::out);
+        if(!file.is_open()){
+            std::cerr << "Error opening file\n";
+            return 4;
+        }
+        auto written = VS_XML_NS::convert_binary(region,file,target);
+        if(!written.has_value()){
+            std::cerr << "Error while converting the binary: " << written.error().msg() << "\n";
+            return 5;
+        }
+        std::cerr << describe(*layout) << " -> " << describe(target) << ", " << *written << " bytes\n";
+    }catch (const std::exception &ex) {
+        std::cerr << "Error while reading the binary: " << ex.what() << "\n";
+        return 2;
+    }
+
+    return 0;
+}
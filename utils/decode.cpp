@@ -8,15 +8,13 @@
 #include <vs-xml/parser.hpp>
 #include <vs-xml/serializer.hpp>
 #include <vs-xml/document.hpp>
-
-#include <mio/mmap.hpp>
+#include <vs-xml/mapped.hpp>
 
 int decode(std::filesystem::path input, std::filesystem::path output){
     try{
-        mio::mmap_source mmap(input.c_str());
-        std::span<uint8_t> binaryInput((uint8_t*)mmap.data(),mmap.size());
-        auto tree = VS_XML_NS::Document::from_binary(binaryInput);
-        if(!tree.has_value())throw std::runtime_error(std::string(tree.error().msg()));
+        auto mapped = VS_XML_NS::MappedDocument::open(input,VS_XML_NS::access_t::SEQUENTIAL);
+        if(!mapped.has_value())throw std::runtime_error(std::string(mapped.error().msg()));
+        auto tree = &mapped->document();
 
         std::ofstream file(output,std::ios::binary|std::ios::out);
         if(!file.is_open()){
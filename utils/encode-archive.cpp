@@ -1,30 +1,34 @@
 /**
  * @file encode-archive.cpp
  * @author random llm model for now I guess
- * @brief 
+ * @brief Encode all XML files in a directory into a single archive, in parallel.
  * @date 2025-06-21
  * 
  * @copyright Copyright (c) 2025
  * 
  */
 
-//TODO: Adapt it to work with archives
-
 #include <functional>
 #include <print>
+#include <algorithm>
 #include <atomic>
-#include <condition_variable>
 #include <filesystem>
 #include <fstream>
 #include <format>
 #include <iostream>
 #include <mutex>
 #include <optional>
-#include <queue>
+#include <sstream>
 #include <string_view>
 #include <thread>
 #include <vector>
-#include <stop_token>
+
+#include <vs-xml/archive-builder.hpp>
+#include <vs-xml/archive-compressed.hpp>
+#include <vs-xml/executor.hpp>
+#include <vs-xml/parser.hpp>
+
+#include <mio/mmap.hpp>
 
 
 
@@ -79,78 +83,45 @@ struct ProcessResult {
   };
 
 
-ProcessResult::Value process_file(std::filesystem::path const& p) {
-    // stub: hash path to pick a pseudo‐random result
-    auto h = std::hash<std::string>{}(p.string());
-    return static_cast<ProcessResult::Value>(h % static_cast<int>(ProcessResult::_COUNT));
-}
-
-//------------------------------------------------------------------------------
-// Minimal thread‐pool using std::jthread + stop_token
-//------------------------------------------------------------------------------
-class ThreadPool {
-public:
-  explicit ThreadPool(size_t n) {
-    for (size_t i = 0; i < n; ++i) {
-      workers_.emplace_back([this](std::stop_token st) {
-        while (!st.stop_requested()) {
-          std::function<void()> job;
-          {
-            std::unique_lock lock{mtx_};
-            cv_.wait(lock, [&]{ 
-              // wake up either on new task or on our own stop request
-              return st.stop_requested() || !tasks_.empty();
-            });
-            if (st.stop_requested() && tasks_.empty())
-              return;   // clean exit
-            job = std::move(tasks_.front());
-            tasks_.pop();
-          }
-          job();
-        }
-      });
-    }
-  }
+constexpr VS_XML_NS::builder_config_t archive_cfg = {.symbols=VS_XML_NS::builder_config_t::COMPRESS_ALL,.raw_strings=true};
+using Builder = VS_XML_NS::ParallelArchiveBuilder<archive_cfg>;
 
-  ~ThreadPool() {
-    // signal each jthread to stop
-    for (auto &jt : workers_) {
-      jt.request_stop();
+ProcessResult::Value process_file(Builder& bld, size_t part, std::filesystem::path const& p, std::string_view name) {
+    std::optional<mio::mmap_source> mmap;
+    try{
+        mmap.emplace(p.c_str());
+    }catch(...){
+        return ProcessResult::ERROR_READ;
     }
-    cv_.notify_all();
-    // jthreads auto‐join on destruction
-  }
+    std::string_view xmlInput(mmap->data(),mmap->size());
 
-  void submit(std::function<void()> job) {
-    {
-      std::lock_guard lock{mtx_};
-      tasks_.push(std::move(job));
-    }
-    cv_.notify_one();
-  }
-
-private:
-  std::vector<std::jthread>             workers_;
-  std::queue<std::function<void()>>     tasks_;
-  std::mutex                            mtx_;
-  std::condition_variable_any           cv_;
-};
+    auto ret = bld.try_document(part, name, [&](VS_XML_NS::DocumentBuilder<archive_cfg>& doc){
+        VS_XML_NS::Parser parser(xmlInput, doc);
+        return parser.parse().has_value();
+    });
+    if(ret==VS_XML_NS::details::BuilderBase::error_t::OK)return ProcessResult::SUCCESS;
+    return ProcessResult::ERROR_PARSE;
+}
 
 //------------------------------------------------------------------------------
 // Simple CLI parsing
 //------------------------------------------------------------------------------
 struct Config {
     std::filesystem::path  source;
+    std::filesystem::path  output;
     std::optional<std::filesystem::path> log_path;
     unsigned               threads     = std::thread::hardware_concurrency();
     bool                   want_report = false;
+    bool                   compress    = false;
+    bool                   checksums   = false;
 };
 
 std::optional<Config> parse_args(int argc, char* argv[]) {
-    if (argc < 2) return std::nullopt;
+    if (argc < 3) return std::nullopt;
     Config cfg;
     cfg.source = argv[1];
-    for (int i = 2; i < argc; ++i) {
+    cfg.output = argv[2];
+    for (int i = 3; i < argc; ++i) {
         std::string_view a = argv[i];
         if (a == "--log" && i+1 < argc) {
             cfg.log_path = argv[++i];
@@ -162,6 +133,12 @@ std::optional<Config> parse_args(int argc, char* argv[]) {
         else if (a == "--report") {
             cfg.want_report = true;
         }
+        else if (a == "--compress") {
+            cfg.compress = true;
+        }
+        else if (a == "--checksums") {
+            cfg.checksums = true;
+        }
         else {
             std::print(stderr, "Unknown option: '{}'\n", a);
             return std::nullopt;
@@ -170,13 +147,43 @@ std::optional<Config> parse_args(int argc, char* argv[]) {
     return cfg;
 }
 
+//Shared by all tasks, each one encoding a contiguous range of files into its own part.
+struct job_t {
+    Builder&                                    bld;
+    const Config&                               cfg;
+    const std::vector<std::filesystem::path>&   files;
+    ProcessResult::CounterArray&                counters;
+    std::optional<std::ofstream>&               log_stream;
+    std::mutex                                  log_lock;
+};
+
+void encode_parts(void* ctx, size_t begin, size_t end) {
+    auto& job = *(job_t*)ctx;
+    for (size_t part = begin; part < end; ++part) {
+        size_t first = part*job.files.size()/job.bld.parts();
+        size_t last = (part+1)*job.files.size()/job.bld.parts();
+        for (size_t i = first; i < last; ++i) {
+            auto const& path = job.files[i];
+            auto name = std::filesystem::relative(path, job.cfg.source).generic_string();
+            auto res = process_file(job.bld, part, path, name);
+            job.counters[static_cast<size_t>(res)].fetch_add(1, std::memory_order_relaxed);
+
+            // **Extended log**: only record failures (res != SUCCESS)
+            if (job.log_stream && res != ProcessResult::SUCCESS) {
+                std::lock_guard lock{job.log_lock};
+                std::print(*job.log_stream, "{} => {}\n", path.string(), ProcessResult::to_string(res));
+            }
+        }
+    }
+}
+
 //------------------------------------------------------------------------------
 // main
 //------------------------------------------------------------------------------
 int main(int argc, char* argv[]) {
     auto cfg_opt = parse_args(argc, argv);
     if (!cfg_opt) {
-        std::print("Usage: {} <source_dir> [--log <path>] [--threads N] [--report]\n", argv[0]);
+        std::print("Usage: {} <source_dir> <output> [--log <path>] [--threads N] [--report] [--compress] [--checksums]\n", argv[0]);
         return 1;
     }
     auto const& cfg = *cfg_opt;
@@ -197,7 +204,7 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    // 1) Gather files
+    // 1) Gather files, sorted so that the archive does not depend on the scheduling
     std::vector<std::filesystem::path> files;
     try {
         for (auto const& e : std::filesystem::recursive_directory_iterator(cfg.source)) {
@@ -209,30 +216,45 @@ int main(int argc, char* argv[]) {
         std::print(stderr, "Error scanning '{}': {}\n", cfg.source.string(), ex.what());
         return 4;
     }
+    std::sort(files.begin(), files.end());
+    if (files.size() > UINT16_MAX) {
+        std::print(stderr, "Error: archives are limited to {} documents, found {}\n", UINT16_MAX, files.size());
+        return 4;
+    }
 
     // 2) Counters (fixed at compile time by ProcessResult::_COUNT)
     constexpr size_t RCOUNT = static_cast<size_t>(ProcessResult::_COUNT);
     ProcessResult::CounterArray counters;
     for (auto &c : counters)c.store(0, std::memory_order_relaxed);
 
-    // 3) Thread‐pool
-    ThreadPool pool(cfg.threads);
-
-    // 4) Submit tasks
-    for (auto const& path : files) {
-        pool.submit([&, path]() {
-            auto res = process_file(path);
-            counters[static_cast<size_t>(res)]
-              .fetch_add(1, std::memory_order_relaxed);
+    // 3) Parallel encoding. More parts than threads keep workers busy when files have uneven sizes.
+    VS_XML_NS::Executor executor(cfg.threads>1 ? cfg.threads-1 : 1);
+    Builder bld(std::max<size_t>(1, std::min<size_t>(files.size(), 4*executor.concurrency())));
+    job_t job{bld, cfg, files, counters, log_stream, {}};
+    executor.parallel_for(bld.parts(), encode_parts, &job);
 
-            // **Extended log**: only record failures (res != SUCCESS)
-            if (log_stream && res != ProcessResult::SUCCESS) {
-                std::print(*log_stream, "{} => {}\n",
-                           path.string(), ProcessResult::to_string(res));
-            }
-        });
+    // 4) Merge symbols of all parts and write the archive
+    auto archive = bld.close(&executor);
+    if (!archive.has_value()) {
+        std::print(stderr, "Error while merging the archive\n");
+        return 5;
+    }
+    std::ofstream file(cfg.output, std::ios::binary|std::ios::out);
+    bool written = file.is_open();
+    if (written && cfg.compress) {
+        // Compressed in blocks, which are encoded in parallel
+        std::stringstream binary;
+        written = archive->save_binary(binary, {}, cfg.checksums);
+        std::string bytes = std::move(binary).str();
+        written = written && VS_XML_NS::compress_binary({(const uint8_t*)bytes.data(), bytes.size()}, file, 64<<10, &executor);
+    }
+    else if (written) {
+        written = archive->save_binary(file, {}, cfg.checksums);
+    }
+    if (!written) {
+        std::print(stderr, "Error: cannot write '{}'\n", cfg.output.string());
+        return 5;
     }
-    // pool destructor waits for all tasks to finish
 
     // 5) On‐screen short report (counts only), with colors
     if (cfg.want_report) {
@@ -241,12 +263,12 @@ int main(int argc, char* argv[]) {
 
         std::print("=== Processing Report ===\n");
         std::print("Source dir: {}\n", cfg.source.string());
-        std::print("Total files processed: {}\n\n", total);
+        std::print("Total files processed: {}\n", total);
+        std::print("Documents in the archive: {}\n\n", archive->items());
         std::print("Result breakdown:\n");
 
         for (size_t i = 0; i < RCOUNT; ++i) {
             auto r     = static_cast<ProcessResult::Value>(i);
-            //auto cnt   = counters[i].load();
             auto name  = ProcessResult::to_string(r);
             auto color = ProcessResult::color_for(r);
             std::print("{}{:<16}{} : {}\n",
@@ -263,4 +285,4 @@ int main(int argc, char* argv[]) {
     }
 
     return failures==0?0:1;
-}
\ No newline at end of file
+}
@@ -4,20 +4,39 @@
 #include <ostream>
 #include <print>
 
+#include <string>
+#include <vector>
+
+#include <vs-xml/attr-index.hpp>
 #include <vs-xml/commons.hpp>
+#include <vs-xml/name-index.hpp>
 #include <vs-xml/parser.hpp>
+#include <vs-xml/subtree-stats.hpp>
 #include <vs-xml/serializer.hpp>
+#include <vs-xml/topology.hpp>
 #include <vs-xml/document-builder.hpp>
 
 #include <mio/mmap.hpp>
 
+//Indices to be attached to the binary, and how the document is built.
+struct options_t{
+    bool names = false;
+    bool stats = false;
+    bool topology = false;
+    bool attrs = false;
+    bool all_attrs = false;
+    bool sparse = false;
+    std::vector<VS_XML_NS::AttrIndex::selector_t> selected;
+};
+
 template<VS_XML_NS::builder_config_t cfg>
-int encode(std::filesystem::path input, std::filesystem::path output){
+int encode(std::filesystem::path input, std::filesystem::path output, const options_t& options){
     try{
         mio::mmap_source mmap(input.c_str());
         std::string_view xmlInput(mmap.data(),mmap.size());
 
         VS_XML_NS::DocumentBuilder<cfg> bld;
+        if(options.sparse)bld.reserve({0,0,0,true});
         VS_XML_NS::Parser parser(xmlInput, bld);
         if(auto ret = parser.parse(); !ret.has_value())throw std::runtime_error(std::string(ret.error().msg()));
 
@@ -35,7 +54,29 @@ int encode(std::filesystem::path input, std::filesystem::path output){
             return 4;
         }
 
-        if(!tree->save_binary(file)){
+        std::optional<VS_XML_NS::NameIndex> names;
+        std::optional<VS_XML_NS::AttrIndex> attrs;
+        std::optional<VS_XML_NS::SubtreeStats> stats;
+        std::optional<VS_XML_NS::Topology> topology;
+        std::vector<VS_XML_NS::binary_extension_t> extensions;
+        if(options.names){
+            names.emplace(VS_XML_NS::NameIndex::build(tree->downgrade()));
+            extensions.push_back(names->extension());
+        }
+        if(options.attrs){
+            attrs.emplace(VS_XML_NS::AttrIndex::build(tree->downgrade(),options.all_attrs?std::span<const VS_XML_NS::AttrIndex::selector_t>{}:options.selected));
+            extensions.push_back(attrs->extension());
+        }
+        if(options.stats){
+            stats.emplace(VS_XML_NS::SubtreeStats::build(tree->downgrade()));
+            extensions.push_back(stats->extension());
+        }
+        if(options.topology){
+            topology.emplace(VS_XML_NS::Topology::build(tree->downgrade()));
+            extensions.push_back(topology->extension());
+        }
+
+        if(!tree->save_binary(file,extensions)){
             std::cerr << "Error in serialization to XML\n";
             return 5;
         }
@@ -48,6 +89,24 @@ int encode(std::filesystem::path input, std::filesystem::path output){
 }
 
 int main(int argc, const char* argv[]) {
-    if(argc<3){std::cerr<<"Wrong usage, pass input file and output file as args.";return 1;}
-    return encode<{.symbols=VS_XML_NS::builder_config_t::COMPRESS_ALL,.raw_strings=true}>(argv[1],argv[2]);
+    if(argc<3){std::cerr<<"Wrong usage, pass input file and output file as args, optionally followed by `--names`, `--stats`, `--topology`, `--attrs`, `--sparse` or any number of `--attr [ns:]name`.";return 1;}
+
+    options_t options;
+    for(int i=3;i<argc;i++){
+        std::string_view arg = argv[i];
+        if(arg=="--names")options.names=true;
+        else if(arg=="--stats")options.stats=true;
+        else if(arg=="--topology")options.topology=true;
+        else if(arg=="--attrs"){options.attrs=true;options.all_attrs=true;}
+        else if(arg=="--sparse")options.sparse=true;
+        else if(arg=="--attr" && i+1<argc){
+            std::string_view label = argv[++i];
+            options.attrs=true;
+            if(auto colon = label.find(':'); colon!=label.npos)options.selected.push_back({label.substr(0,colon),label.substr(colon+1)});
+            else options.selected.push_back({{},label});
+        }
+        else{std::cerr<<"Unknown option "<<arg<<"\n";return 1;}
+    }
+
+    return encode<{.symbols=VS_XML_NS::builder_config_t::COMPRESS_ALL,.raw_strings=true}>(argv[1],argv[2],options);
 }
\ No newline at end of file